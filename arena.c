@@ -0,0 +1,79 @@
+#include <stdlib.h>
+#include "arena.h"
+
+#define ARENA_BLOCK_SIZE (64 * 1024)
+#define ARENA_ALIGNMENT 8
+
+Arena *arena_new(void) {
+    Arena *arena = malloc(sizeof(Arena));
+    arena->blocks = NULL;
+    arena->next = NULL;
+    arena->end = NULL;
+    arena->allocation_count = 0;
+    return arena;
+}
+
+static void free_blocks(ArenaBlock *block) {
+    while (block != NULL) {
+        ArenaBlock *next = block->next;
+        free(block);
+        block = next;
+    }
+}
+
+void arena_free(Arena *arena) {
+    if (arena == NULL) return;
+    free_blocks(arena->blocks);
+    free(arena);
+}
+
+/* Release everything allocated so far, but keep the most recent block
+ * for reuse.
+ */
+void arena_reset(Arena *arena) {
+    if (arena->blocks == NULL) return;
+    free_blocks(arena->blocks->next);
+    arena->blocks->next = NULL;
+    arena->next = arena->blocks->data;
+    arena->end = arena->blocks->data + arena->blocks->size;
+}
+
+/* Take over the blocks of other, which is freed. Whatever was allocated
+ * from it now lives as long as arena.
+ */
+void arena_adopt(Arena *arena, Arena *other) {
+    if (other->blocks != NULL) {
+        ArenaBlock *last = other->blocks;
+        while (last->next != NULL) {
+            last = last->next;
+        }
+        // Keep arena's current block first, so allocation carries on in it.
+        if (arena->blocks == NULL) {
+            arena->blocks = other->blocks;
+            arena->next = other->next;
+            arena->end = other->end;
+        } else {
+            last->next = arena->blocks->next;
+            arena->blocks->next = other->blocks;
+        }
+    }
+    arena->allocation_count += other->allocation_count;
+    free(other);
+}
+
+void *arena_alloc(Arena *arena, size_t size) {
+    size = (size + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+    if (arena->next == NULL || (size_t)(arena->end - arena->next) < size) {
+        size_t block_size = size > ARENA_BLOCK_SIZE ? size : ARENA_BLOCK_SIZE;
+        ArenaBlock *block = malloc(sizeof(ArenaBlock) + block_size);
+        block->next = arena->blocks;
+        block->size = block_size;
+        arena->blocks = block;
+        arena->next = block->data;
+        arena->end = block->data + block_size;
+    }
+    void *memory = arena->next;
+    arena->next += size;
+    arena->allocation_count++;
+    return memory;
+}
@@ -0,0 +1,28 @@
+#include <stddef.h>
+
+#ifndef ARENA_HEADER
+#define ARENA_HEADER
+
+/* A bump allocator. Memory is taken from large blocks and is never freed
+ * piece by piece: the whole arena is released at once.
+ */
+typedef struct ArenaBlock {
+    struct ArenaBlock *next;
+    size_t size;
+    char data[];
+} ArenaBlock;
+
+typedef struct Arena {
+    ArenaBlock *blocks; // Most recent first
+    char *next;
+    char *end;
+    size_t allocation_count;
+} Arena;
+
+Arena *arena_new(void);
+void arena_free(Arena *arena);
+void arena_reset(Arena *arena);
+void arena_adopt(Arena *arena, Arena *other);
+void *arena_alloc(Arena *arena, size_t size);
+
+#endif
@@ -6,16 +6,23 @@
 #include <stdarg.h>
 #include <err.h>
 #include "syntax.h"
-#include "env.h"
+#include "semantic.h"
 #include "context.h"
+#include "compilation.h"
+#include "range.h"
+#include "ir.h"
+#include "lower.h"
+#include "opt.h"
 
-static int is_M1 = 0;
-static const int WORD_SIZE = 16;
+static const int WORD_SIZE = 8;
 const int MAX_MNEMONIC_LENGTH = 7;
 
-void check_target_architecture() {
+/* Returns 1 if this compiler was built to target Apple silicon. */
+int check_target_architecture() {
 #ifdef TARGET_ARCH_M1
-    is_M1=1;
+    return 1;
+#else
+    return 0;
 #endif
 }
 
@@ -60,8 +67,8 @@ char *fresh_local_label(char *prefix, Context *ctx) {
 
 void emit_label(FILE *out, char *label) { fprintf(out, "%s:\n", label); }
 
-void emit_function_prologue(FILE *out) {
-    if(is_M1){
+void emit_function_prologue(FILE *out, Context *ctx) {
+    if(ctx->is_M1){
         fprintf(out, ".align 4");
     } else {
         fprintf(out, ".align 2");
@@ -69,20 +76,36 @@ void emit_function_prologue(FILE *out) {
     fprintf(out, "\n\n");
 }
 
-void emit_function_declaration(FILE *out, char *name) {
+void emit_function_declaration(FILE *out, Name name, Context *ctx) {
     fprintf(out, ".global _%s\n", name);
-    emit_function_prologue(out);
+    emit_function_prologue(out, ctx);
     fprintf(out, "_%s:\n", name);
 }
 
+/* Restore the caller's frame. */
+static void emit_frame_teardown(FILE *out) {
+    emit_instr(out, "mov", "sp, x29");
+    emit_instr(out, "ldp", "x29, x30, [sp], #16");
+}
+
+/* Restore the caller's frame and return. */
 void emit_return(FILE *out) {
+    emit_frame_teardown(out);
     emit_instr(out, "ret", "");
 }
 
-void emit_print(FILE *out) {
-    emit_instr_format(out, "adrp", "x0, .Lformat@PAGE");
-    emit_instr_format(out, "add", "x0, x0, .Lformat@PAGEOFF");
-    emit_instr(out, "mov", "x1, x0"); // Expression value already in x0
+/* Print the value in x1. Apple's variadic convention passes it on the
+ * stack instead, so it is stored to the outgoing arguments there too.
+ */
+void emit_print(FILE *out, Context *ctx) {
+    if (ctx->is_M1) {
+        emit_instr_format(out, "adrp", "x0, .Lformat@PAGE");
+        emit_instr_format(out, "add", "x0, x0, .Lformat@PAGEOFF");
+        emit_instr(out, "str", "x1, [sp]");
+    } else {
+        emit_instr_format(out, "adrp", "x0, .Lformat");
+        emit_instr_format(out, "add", "x0, x0, :lo12:.Lformat");
+    }
     emit_instr(out, "bl", "_printf");
 }
 
@@ -96,10 +119,10 @@ void write_header(FILE *out) {
     fprintf(out, ".text\n");
 }
 
-void write_footer(FILE *out) {
+void write_footer(FILE *out, Context *ctx) {
     fprintf(out, "\n");
 
-    if (is_M1) {
+    if (ctx->is_M1) {
         emit_instr(out, "mov", "x16, #1");
     } else {
         emit_instr(out, "mov", "x8, #93");
@@ -108,214 +131,645 @@ void write_footer(FILE *out) {
     emit_instr(out, "svc", "#0xFFFF");
 }
 
-void write_syntax(FILE *out, Syntax *syntax, Context *ctx) {
-    if (!syntax) return;
+/* The frame of a function, from sp up: outgoing stack arguments, a word
+ * for each slot holding virtual registers, its arrays, then the saved x29
+ * and x30.
+ */
+typedef struct Frame {
+    int registers; // Offset of slot 0
+    int *slots; // The slot of each register
+    int slot_count;
+    int arrays; // Offset of the first array word
+    int size; // A multiple of 16
+    int x9_holds; // The register whose value x9 is known to hold, or IR_NONE
+    IrInstruction **constants; // When optimizing, the CONST defining each register, or NULL
+    char *parallel_copies; // Of each block, whether one of its phis reads another on the way in
+} Frame;
+
+/* Put any 64-bit constant in reg. */
+static void emit_constant(FILE *out, const char *reg, long value) {
+    if (value >= -65536 && value <= 65535) {
+        emit_instr_format(out, "mov", "%s, #%ld", reg, value);
+        return;
+    }
+    unsigned long bits = (unsigned long)value;
+    emit_instr_format(out, "movz", "%s, #%lu", reg, bits & 0xffff);
+    for (int shift = 16; shift < 64; shift += 16) {
+        unsigned long part = (bits >> shift) & 0xffff;
+        if (part != 0) {
+            emit_instr_format(out, "movk", "%s, #%lu, lsl #%d", reg, part, shift);
+        }
+    }
+}
+
+/* ldr or str of reg at base + offset, through x16 beyond the reach of
+ * an immediate offset.
+ */
+static void emit_access(FILE *out, char *instr, const char *reg, const char *base, long offset) {
+    if (offset >= 0 && offset <= 32760) {
+        emit_instr_format(out, instr, "%s, [%s, #%ld]", reg, base, offset);
+    } else {
+        emit_constant(out, "x16", offset);
+        emit_instr_format(out, instr, "%s, [%s, x16]", reg, base);
+    }
+}
+
+/* dest = sp + offset, or dest = sp - offset. */
+static void emit_sp_offset(FILE *out, char *instr, const char *dest, long offset) {
+    if (offset <= 4095) {
+        emit_instr_format(out, instr, "%s, sp, #%ld", dest, offset);
+    } else {
+        emit_constant(out, "x16", offset);
+        emit_instr_format(out, instr, "%s, sp, x16", dest);
+    }
+}
 
-    if (syntax->type == UNARY_OPERATOR) {
-        UnaryExpression *unary_syntax = syntax->unary_expression;
+static int is_rematerialized(Frame *frame, int value) {
+    return frame->constants != NULL && frame->constants[value] != NULL;
+}
 
-        write_syntax(out, unary_syntax->expression, ctx);
+/* Most values are stored from x9 and read straight back, so a load into
+ * x9 of the value it already holds is left out. Constants, when
+ * optimizing, are put in place where they are used and take no slot.
+ */
+static void emit_load(FILE *out, Frame *frame, const char *reg, int value) {
+    int x9 = strcmp(reg, "x9") == 0;
+    if (x9 && frame->x9_holds == value) {
+        return;
+    }
+    if (is_rematerialized(frame, value)) {
+        emit_constant(out, reg, frame->constants[value]->immediate);
+    } else {
+        emit_access(out, "ldr", reg, "sp", frame->registers + (long)frame->slots[value] * WORD_SIZE);
+    }
+    if (x9) {
+        frame->x9_holds = value;
+    }
+}
+
+static void emit_store(FILE *out, Frame *frame, const char *reg, int value) {
+    emit_access(out, "str", reg, "sp", frame->registers + (long)frame->slots[value] * WORD_SIZE);
+    frame->x9_holds = strcmp(reg, "x9") == 0 ? value : frame->x9_holds;
+}
 
-        if (unary_syntax->unary_type == NEGATION) {
-            emit_instr(out, "neg", "x0, x0");
-        } else if (unary_syntax->unary_type == BITWISE_NEGATION) {
-            emit_instr(out, "mvn", "x0, x0");
-        } else if (unary_syntax->unary_type == LOGICAL_NEGATION) {
-            emit_instr(out, "cmp", "x0, #0");
-            emit_instr(out, "cset", "x0, eq");
+static int has_phis(IrBlock *block) {
+    return block->count > 0 && block->instructions[0].opcode == IR_PHI;
+}
+
+/* Each block's edges and their phi copies, as emit_edge() emits them. */
+static int edge_index(IrBlock *target, int from) {
+    int edge = 0;
+    while (edge < target->predecessor_count && target->predecessors[edge] != from) {
+        edge++;
+    }
+    return edge;
+}
+
+typedef struct SlotAllocator {
+    int *slots;
+    int *last_use; // Position of each register's last use, or -1
+    int *free_slots; // A stack
+    int free_count;
+    int slot_count;
+} SlotAllocator;
+
+static void allocate_slot(SlotAllocator *allocator, int reg) {
+    allocator->slots[reg] = allocator->free_count > 0
+        ? allocator->free_slots[--allocator->free_count] : allocator->slot_count++;
+}
+
+/* Release reg's slot if position is its last use. */
+static void release_slot(SlotAllocator *allocator, int reg, int position) {
+    if (allocator->last_use[reg] == position && allocator->slots[reg] >= 0) {
+        allocator->last_use[reg] = -1; // Released once, however often it is read here
+        allocator->free_slots[allocator->free_count++] = allocator->slots[reg];
+    }
+}
+
+static void note_use(SlotAllocator *allocator, int reg, int position) {
+    if (position > allocator->last_use[reg]) {
+        allocator->last_use[reg] = position;
+    }
+}
+
+/* The successors of a block with phis whose operands it supplies. */
+static int phi_successors(IrBlock *block, IrFunction *function, int targets[2]) {
+    IrInstruction *terminator = &block->instructions[block->count - 1];
+    int count = 0;
+    int successor_count = terminator->opcode == IR_BRANCH ? 2 : terminator->opcode == IR_JUMP ? 1 : 0;
+    for (int i = 0; i < successor_count; i++) {
+        if (has_phis(&function->blocks[terminator->targets[i]])) {
+            targets[count++] = terminator->targets[i];
         }
-    } else if (syntax->type == IMMEDIATE) {
-        emit_instr_format(out, "mov", "x0, #%d", syntax->immediate->value);
-    } else if (syntax->type == VARIABLE) {
-        int offset = environment_get_offset(ctx->env, syntax->variable->var_name);
-        emit_instr_format(out, "ldr", "x0, [sp, #%d]", offset);
-    } else if (syntax->type == ASSIGNMENT) {
-        write_syntax(out, syntax->assignment->expression, ctx);
-        int offset = environment_get_offset(ctx->env, syntax->assignment->var_name);
-        emit_instr_format(out, "str", "x0, [sp, #%d]", offset);
-    } else if (syntax->type == BINARY_OPERATOR) {
-        BinaryExpression *binary_syntax = syntax->binary_expression;
-        int stack_offset = ctx->stack_offset;
-        ctx->stack_offset -= WORD_SIZE;
-
-        write_syntax(out, binary_syntax->left, ctx);
-        emit_instr_format(out, "str", "x0, [sp, #%d]", stack_offset);
-
-        write_syntax(out, binary_syntax->right, ctx);
-
-        if (binary_syntax->binary_type == MULTIPLICATION) {
-            emit_instr_format(out, "ldr", "x1, [sp, #%d]", stack_offset);
-            emit_instr(out, "mul", "x0, x0, x1");
-        } else if (binary_syntax->binary_type == ADDITION) {
-            emit_instr_format(out, "ldr", "x1, [sp, #%d]", stack_offset);
-            emit_instr(out, "add", "x0, x0, x1");
-        } else if (binary_syntax->binary_type == SUBTRACTION) {
-            emit_instr_format(out, "ldr", "x1, [sp, #%d]", stack_offset);
-            emit_instr(out, "sub", "x0, x1, x0");
-        } else if (binary_syntax->binary_type == GREATER) {
-            emit_instr_format(out, "ldr", "x1, [sp, #%d]", stack_offset);
-            emit_instr(out, "cmp", "x1, x0");
-            emit_instr(out, "cset", "x0, gt");
-        } else if (binary_syntax->binary_type == LESS) {
-            emit_instr_format(out, "ldr", "x1, [sp, #%d]", stack_offset);
-            emit_instr(out, "cmp", "x1, x0");
-            emit_instr(out, "cset", "x0, lt");
-        } else if (binary_syntax->binary_type == AND) {
-            emit_instr_format(out, "ldr", "x1, [sp, #%d]", stack_offset);
-            emit_instr(out, "and", "x0, x0, x1");
-        } else if (binary_syntax->binary_type == OR) {
-            emit_instr_format(out, "ldr", "x1, [sp, #%d]", stack_offset);
-            emit_instr(out, "orr", "x0, x0, x1");
-        } else if (binary_syntax->binary_type == EQUALS) {
-            emit_instr_format(out, "ldr", "x1, [sp, #%d]", stack_offset);
-            emit_instr(out, "cmp", "x0, x1");
-            emit_instr(out, "cset", "x0, eq");
-        } else if (binary_syntax->binary_type == GREATER_EQUALS) {
-            emit_instr_format(out, "ldr", "x1, [sp, #%d]", stack_offset);
-            emit_instr(out, "cmp", "x1, x0");
-            emit_instr(out, "cset", "x0, ge");
-        } else if (binary_syntax->binary_type == LESS_EQUALS) {
-            emit_instr_format(out, "ldr", "x1, [sp, #%d]", stack_offset);
-            emit_instr(out, "cmp", "x1, x0");
-            emit_instr(out, "cset", "x0, le");
+    }
+    return count;
+}
+
+/* Share frame slots between registers whose lives do not overlap. When
+ * every block follows its predecessors, as lowering leaves them, a
+ * register lives from its definition to its last use in the order the
+ * code is emitted, so slots can be handed out in one pass in that order.
+ * Phis are written on the edges into their block, at the end of each
+ * predecessor; their slots are taken there before any operand's is freed,
+ * so the copies on an edge never overwrite each other. Otherwise each
+ * register keeps a slot of its own.
+ */
+static void assign_slots(IrFunction *function, Frame *frame) {
+    int registers = function->register_count > 0 ? function->register_count : 1;
+    frame->slots = malloc(registers * sizeof(int));
+    for (int b = 0; b < function->block_count; b++) {
+        IrBlock *block = &function->blocks[b];
+        for (int i = 0; i < block->predecessor_count; i++) {
+            if (block->predecessors[i] >= b) {
+                for (int r = 0; r < function->register_count; r++) frame->slots[r] = r;
+                frame->slot_count = function->register_count;
+                return;
+            }
         }
-        ctx->stack_offset += WORD_SIZE;
-    } else if (syntax->type == RETURN_STATEMENT) {
-        write_syntax(out, syntax->return_statement->expression, ctx);
-        emit_return(out);
-    } else if (syntax->type == PRINT_STATEMENT) {
-        write_syntax(out, syntax->print_statement->expression, ctx);
-        emit_print(out);
-    } else if (syntax->type == IF_STATEMENT) {
-        IfStatement *if_statement = syntax->if_statement;
-        write_syntax(out, if_statement->condition, ctx);
-
-        char *label_end = fresh_local_label("if_end", ctx);
-        char *label_else = fresh_local_label("if_else", ctx);
-
-        emit_instr(out, "cmp", "x0, #0");
-        emit_instr_format(out, "beq", "%s", label_else);
-
-        write_syntax(out, if_statement->then_stmts, ctx);
-        emit_instr_format(out, "b", "%s", label_end);
-
-        emit_label(out, label_else);
-        if (if_statement->else_stmts != NULL) {
-            write_syntax(out, if_statement->else_stmts, ctx);
+    }
+
+    SlotAllocator allocator;
+    allocator.slots = frame->slots;
+    allocator.last_use = malloc(registers * sizeof(int));
+    allocator.free_slots = malloc(registers * sizeof(int));
+    allocator.free_count = 0;
+    allocator.slot_count = 0;
+    for (int r = 0; r < function->register_count; r++) {
+        allocator.slots[r] = -1;
+        allocator.last_use[r] = -1;
+    }
+
+    // Positions count instructions in the order they are emitted.
+    int position = 0;
+    for (int b = 0; b < function->block_count; b++) {
+        IrBlock *block = &function->blocks[b];
+        for (int i = 0; i < block->count; i++, position++) {
+            IrInstruction *instruction = &block->instructions[i];
+            for (int j = 0; j < ir_operand_count(instruction->opcode); j++) {
+                if (instruction->operands[j] != IR_NONE) note_use(&allocator, instruction->operands[j], position);
+            }
+            if (ir_is_call(instruction->opcode)) {
+                for (int j = 0; j < instruction->call->argument_count; j++) {
+                    note_use(&allocator, instruction->call->arguments[j], position);
+                }
+            }
+            if (instruction->opcode == IR_PHI) {
+                // Kept from the first edge in until its block is reached
+                note_use(&allocator, instruction->dest, position);
+            }
         }
-        emit_label(out, label_end);
-
-        free(label_end);
-        free(label_else);
-    } else if (syntax->type == FUNCTION_CALL) {
-        emit_instr_format(out, "bl", "_%s", syntax->function_call->function_name);
-    } else if (syntax->type == DEFINE_VAR) {
-        DefineVarStatement *define_var_statement = syntax->define_var_statement;
-        int stack_offset = ctx->stack_offset;
-
-        if (define_var_statement->init_value->type == ARRAY_TYPE && define_var_statement->init_value->immediate) {
-            // Array declaration: var arr[10]
-            int array_size = define_var_statement->init_value->immediate->value;
-            ctx->stack_offset -= WORD_SIZE * array_size;
-            environment_set_offset(ctx->env, define_var_statement->var_name, ctx->stack_offset);
-            // Zero-initialize array
-            for (int i = 0; i < array_size; i++) {
-                emit_instr_format(out, "mov", "x0, #0");
-                emit_instr_format(out, "str", "x0, [sp, #%d]", ctx->stack_offset + i * WORD_SIZE);
+        int targets[2];
+        for (int t = phi_successors(block, function, targets) - 1; t >= 0; t--) {
+            IrBlock *target = &function->blocks[targets[t]];
+            int edge = edge_index(target, b);
+            for (int i = 0; i < target->count && target->instructions[i].opcode == IR_PHI; i++) {
+                note_use(&allocator, target->instructions[i].incoming[edge], position - 1);
+            }
+        }
+    }
+
+    position = 0;
+    for (int b = 0; b < function->block_count; b++) {
+        IrBlock *block = &function->blocks[b];
+        for (int i = 0; i < block->count; i++, position++) {
+            IrInstruction *instruction = &block->instructions[i];
+            if (ir_is_terminator(instruction->opcode)) {
+                int targets[2];
+                int count = phi_successors(block, function, targets);
+                for (int t = 0; t < count; t++) {
+                    IrBlock *target = &function->blocks[targets[t]];
+                    for (int k = 0; k < target->count && target->instructions[k].opcode == IR_PHI; k++) {
+                        if (allocator.slots[target->instructions[k].dest] < 0) {
+                            allocate_slot(&allocator, target->instructions[k].dest);
+                        }
+                    }
+                }
+                for (int t = 0; t < count; t++) {
+                    IrBlock *target = &function->blocks[targets[t]];
+                    int edge = edge_index(target, b);
+                    for (int k = 0; k < target->count && target->instructions[k].opcode == IR_PHI; k++) {
+                        release_slot(&allocator, target->instructions[k].incoming[edge], position);
+                    }
+                }
+            }
+            for (int j = 0; j < ir_operand_count(instruction->opcode); j++) {
+                if (instruction->operands[j] != IR_NONE) release_slot(&allocator, instruction->operands[j], position);
+            }
+            if (ir_is_call(instruction->opcode)) {
+                for (int j = 0; j < instruction->call->argument_count; j++) {
+                    release_slot(&allocator, instruction->call->arguments[j], position);
+                }
+            }
+            if (instruction->opcode == IR_PHI) {
+                release_slot(&allocator, instruction->dest, position);
+            } else if (instruction->dest != IR_NONE && !is_rematerialized(frame, instruction->dest)) {
+                allocate_slot(&allocator, instruction->dest);
+                if (allocator.last_use[instruction->dest] < position) {
+                    // Never read, so free again at once
+                    allocator.last_use[instruction->dest] = position;
+                    release_slot(&allocator, instruction->dest, position);
+                }
+            }
+        }
+    }
+    frame->slot_count = allocator.slot_count;
+    free(allocator.last_use);
+    free(allocator.free_slots);
+}
+
+static Frame lay_out_frame(IrFunction *function, Context *ctx) {
+    int outgoing = 0;
+    for (int b = 0; b < function->block_count; b++) {
+        IrBlock *block = &function->blocks[b];
+        for (int i = 0; i < block->count; i++) {
+            IrInstruction *instruction = &block->instructions[i];
+            int words = 0;
+            if (instruction->opcode == IR_CALL && instruction->call->argument_count > 8) {
+                words = instruction->call->argument_count - 8;
+            } else if (instruction->opcode == IR_PRINT && ctx->is_M1) {
+                words = 1;
+            }
+            if (words * WORD_SIZE > outgoing) {
+                outgoing = words * WORD_SIZE;
             }
-        } else {
-            // Regular variable
-            ctx->stack_offset -= WORD_SIZE;
-            environment_set_offset(ctx->env, define_var_statement->var_name, stack_offset);
-            write_syntax(out, define_var_statement->init_value, ctx);
-            emit_instr_format(out, "str", "x0, [sp, #%d]", stack_offset);
         }
-    } else if (syntax->type == ARRAY_TYPE && syntax->array_access) { // Fixed: array_expression -> array_access
-        // Array indexing: arr[5]
-        ArrayAccess *array_access = syntax->array_access;
-        int stack_offset = ctx->stack_offset;
-        ctx->stack_offset -= WORD_SIZE;
-
-        // Compute index
-        write_syntax(out, array_access->index, ctx);
-        emit_instr_format(out, "mov", "x1, #%d", WORD_SIZE);
-        emit_instr(out, "mul", "x0, x0, x1"); // index * WORD_SIZE
-        // Get base address
-        int base_offset = environment_get_offset(ctx->env, array_access->array_name);
-        emit_instr_format(out, "add", "x0, x0, %d", base_offset); // offset + base
-        emit_instr(out, "add", "x0, sp, x0"); // sp + offset
-        emit_instr(out, "ldr", "x0, [x0]");   // Load value at address
-
-        ctx->stack_offset += WORD_SIZE;
-    } else if (syntax->type == ARRAY_ASSIGNMENT) {
-        ArrayAssignment *array_assign = syntax->array_assignment;
-        int stack_offset = ctx->stack_offset;
-        ctx->stack_offset -= WORD_SIZE;
-
-        // Compute value
-        write_syntax(out, array_assign->value, ctx);
-        emit_instr_format(out, "str", "x0, [sp, #%d]", stack_offset);
-
-        // Compute index
-        write_syntax(out, array_assign->index, ctx);
-        emit_instr_format(out, "mov", "x1, #%d", WORD_SIZE);
-        emit_instr(out, "mul", "x0, x0, x1"); // index * WORD_SIZE
-        // Get base address
-        int base_offset = environment_get_offset(ctx->env, array_assign->array_name);
-        emit_instr_format(out, "add", "x0, x0, %d", base_offset); // offset + base
-        emit_instr(out, "add", "x0, sp, x0"); // sp + offset
-        // Store value
-        emit_instr_format(out, "ldr", "x1, [sp, #%d]", stack_offset);
-        emit_instr(out, "str", "x1, [x0]"); // Store value at address
-
-        ctx->stack_offset += WORD_SIZE;
-    } else if (syntax->type == BLOCK) {
-        List *statements = syntax->block->statements;
-        for (int i = 0; i < list_length(statements); i++) {
-            write_syntax(out, list_get(statements, i), ctx);
+    }
+    Frame frame;
+    frame.parallel_copies = calloc(function->block_count > 0 ? function->block_count : 1, 1);
+    int *phi_block = malloc((function->register_count > 0 ? function->register_count : 1) * sizeof(int));
+    for (int r = 0; r < function->register_count; r++) phi_block[r] = IR_NONE;
+    for (int b = 0; b < function->block_count; b++) {
+        IrBlock *block = &function->blocks[b];
+        for (int i = 0; i < block->count && block->instructions[i].opcode == IR_PHI; i++) {
+            phi_block[block->instructions[i].dest] = b;
         }
-    } else if (syntax->type == FUNCTION) {
-        new_scope(ctx);
-        emit_function_declaration(out, syntax->function->name);
-        // Process parameters
-        if (syntax->function->parameters && syntax->function->parameters->type == FUNCTION_ARGUMENTS) { // Fixed: FUNCTION_LIST -> FUNCTION_ARGUMENTS
-            List *params = syntax->function->parameters->function_arguments->arguments;
-            for (int i = 0; i < list_length(params); i++) {
-                Syntax *param = list_get(params, i);
-                if (param->type == DEFINE_VAR) {
-                    int offset = ctx->stack_offset;
-                    ctx->stack_offset -= WORD_SIZE;
-                    environment_set_offset(ctx->env, param->define_var_statement->var_name, offset);
-                    emit_instr_format(out, "str", "x%d, [sp, #%d]", i, offset);
+    }
+    for (int b = 0; b < function->block_count; b++) {
+        IrBlock *block = &function->blocks[b];
+        for (int i = 0; i < block->count && block->instructions[i].opcode == IR_PHI; i++) {
+            for (int j = 0; j < block->predecessor_count; j++) {
+                if (phi_block[block->instructions[i].incoming[j]] == b) {
+                    frame.parallel_copies[b] = 1;
                 }
             }
         }
-        write_syntax(out, syntax->function->root_block, ctx);
-        emit_function_epilogue(out);
-        end_scope(ctx);
-    } else if (syntax->type == TOP_LEVEL) {
-        List *declarations = syntax->top_level->declarations;
-        for (int i = 0; i < list_length(declarations); i++) {
-            write_syntax(out, list_get(declarations, i), ctx);
+    }
+    free(phi_block);
+    frame.constants = NULL;
+    if (ctx->optimize > 0) {
+        frame.constants = calloc(function->register_count > 0 ? function->register_count : 1, sizeof(IrInstruction *));
+        for (int b = 0; b < function->block_count; b++) {
+            IrBlock *block = &function->blocks[b];
+            for (int i = 0; i < block->count; i++) {
+                if (block->instructions[i].opcode == IR_CONST) {
+                    frame.constants[block->instructions[i].dest] = &block->instructions[i];
+                }
+            }
+        }
+    }
+    assign_slots(function, &frame);
+    frame.registers = outgoing;
+    frame.arrays = outgoing + frame.slot_count * WORD_SIZE;
+    frame.size = (frame.arrays + function->array_words * WORD_SIZE + 15) & ~15;
+    return frame;
+}
+
+static void emit_prologue(FILE *out, IrFunction *function, Frame *frame, Context *ctx) {
+    emit_function_declaration(out, function->name, ctx);
+    emit_instr(out, "stp", "x29, x30, [sp, #-16]!");
+    emit_instr(out, "mov", "x29, sp");
+    if (frame->size > 0) {
+        emit_sp_offset(out, "sub", "sp", frame->size);
+    }
+
+    // Arrays start zeroed.
+    if (function->array_words > 0 && function->array_words <= 8) {
+        for (int i = 0; i < function->array_words; i++) {
+            emit_access(out, "str", "xzr", "sp", frame->arrays + (long)i * WORD_SIZE);
+        }
+    } else if (function->array_words > 0) {
+        char loop[32];
+        snprintf(loop, sizeof(loop), ".zero_%d", ctx->label_count++);
+        emit_sp_offset(out, "add", "x16", frame->arrays);
+        emit_constant(out, "x17", function->array_words);
+        emit_label(out, loop);
+        emit_instr(out, "str", "xzr, [x16], #8");
+        emit_instr(out, "subs", "x17, x17, #1");
+        emit_instr_format(out, "b.ne", "%s", loop);
+    }
+}
+
+/* The copies into a block's phis on one edge, where one phi may read
+ * another: they must act as if at once.
+ */
+typedef struct ParallelCopy {
+    int *sources; // Registers, or HELD for the value kept in x10
+    int *dests;
+    char *state;
+    int count;
+} ParallelCopy;
+
+enum { TO_MOVE, BEING_MOVED, MOVED };
+static const int HELD = -2;
+
+/* Make copy i, after the copies that read its destination. A cycle of
+ * copies is broken by keeping one source in x10; one register suffices
+ * (Leroy, Rideau and Serpette, "Tilting at windmills with Coq").
+ */
+static void emit_move(FILE *out, Frame *frame, ParallelCopy *copy, int i) {
+    if (copy->sources[i] == copy->dests[i]) {
+        copy->state[i] = MOVED;
+        return;
+    }
+    copy->state[i] = BEING_MOVED;
+    for (int j = 0; j < copy->count; j++) {
+        if (copy->sources[j] != copy->dests[i]) continue;
+        if (copy->state[j] == TO_MOVE) {
+            emit_move(out, frame, copy, j);
+        } else if (copy->state[j] == BEING_MOVED) {
+            emit_load(out, frame, "x10", copy->sources[j]);
+            copy->sources[j] = HELD;
+        }
+    }
+    if (copy->sources[i] == HELD) {
+        emit_instr(out, "mov", "x9, x10");
+        frame->x9_holds = IR_NONE;
+    } else {
+        emit_load(out, frame, "x9", copy->sources[i]);
+    }
+    emit_store(out, frame, "x9", copy->dests[i]);
+    copy->state[i] = MOVED;
+}
+
+/* Move along the edge from block from to block to, first giving the phis
+ * there their operands for this edge.
+ */
+static void emit_edge(FILE *out, IrFunction *function, Frame *frame, int labels, int from, int to) {
+    IrBlock *target = &function->blocks[to];
+    int edge = edge_index(target, from);
+    if (frame->parallel_copies[to]) {
+        ParallelCopy copy;
+        copy.count = 0;
+        while (copy.count < target->count && target->instructions[copy.count].opcode == IR_PHI) copy.count++;
+        copy.sources = malloc(copy.count * sizeof(int));
+        copy.dests = malloc(copy.count * sizeof(int));
+        copy.state = calloc(copy.count, 1);
+        for (int i = 0; i < copy.count; i++) {
+            copy.sources[i] = target->instructions[i].incoming[edge];
+            copy.dests[i] = target->instructions[i].dest;
         }
+        for (int i = 0; i < copy.count; i++) {
+            if (copy.state[i] == TO_MOVE) emit_move(out, frame, &copy, i);
+        }
+        free(copy.sources);
+        free(copy.dests);
+        free(copy.state);
     } else {
-        warnx("Unknown syntax type in codegen: %s", syntax_type_name(syntax));
+        for (int i = 0; i < target->count && target->instructions[i].opcode == IR_PHI; i++) {
+            emit_load(out, frame, "x9", target->instructions[i].incoming[edge]);
+            emit_store(out, frame, "x9", target->instructions[i].dest);
+        }
+    }
+    if (to != from + 1) {
+        emit_instr_format(out, "b", ".block_%d", labels + to);
     }
 }
 
-void write_assembly(Syntax *syntax, char *file_name) {
+static void emit_binary(FILE *out, IrOpcode opcode) {
+    switch (opcode) {
+        case IR_ADD: emit_instr(out, "add", "x9, x9, x10"); return;
+        case IR_SUB: emit_instr(out, "sub", "x9, x9, x10"); return;
+        case IR_MUL: emit_instr(out, "mul", "x9, x9, x10"); return;
+        case IR_AND: emit_instr(out, "and", "x9, x9, x10"); return;
+        case IR_OR: emit_instr(out, "orr", "x9, x9, x10"); return;
+        default: break;
+    }
+    emit_instr(out, "cmp", "x9, x10");
+    switch (opcode) {
+        case IR_EQ: emit_instr(out, "cset", "x9, eq"); break;
+        case IR_GT: emit_instr(out, "cset", "x9, gt"); break;
+        case IR_LT: emit_instr(out, "cset", "x9, lt"); break;
+        case IR_GE: emit_instr(out, "cset", "x9, ge"); break;
+        case IR_LE: emit_instr(out, "cset", "x9, le"); break;
+        default: break;
+    }
+}
+
+static void emit_instruction(FILE *out, IrFunction *function, Frame *frame, int labels, int b,
+                             IrInstruction *instruction, Context *ctx) {
+    switch (instruction->opcode) {
+        case IR_CONST:
+            if (is_rematerialized(frame, instruction->dest)) {
+                break;
+            }
+            emit_constant(out, "x9", instruction->immediate);
+            emit_store(out, frame, "x9", instruction->dest);
+            break;
+        case IR_PARAM: {
+            char reg[16];
+            if (instruction->immediate < 8) {
+                snprintf(reg, sizeof(reg), "x%ld", instruction->immediate);
+            } else {
+                // Passed on the stack, just above the saved x29 and x30
+                strcpy(reg, "x9");
+                emit_access(out, "ldr", reg, "x29", 16 + (instruction->immediate - 8) * WORD_SIZE);
+            }
+            emit_store(out, frame, reg, instruction->dest);
+            break;
+        }
+        case IR_NEG:
+        case IR_NOT:
+        case IR_LOGICAL_NOT:
+            emit_load(out, frame, "x9", instruction->operands[0]);
+            if (instruction->opcode == IR_NEG) {
+                emit_instr(out, "neg", "x9, x9");
+            } else if (instruction->opcode == IR_NOT) {
+                emit_instr(out, "mvn", "x9, x9");
+            } else {
+                emit_instr(out, "cmp", "x9, #0");
+                emit_instr(out, "cset", "x9, eq");
+            }
+            emit_store(out, frame, "x9", instruction->dest);
+            break;
+        case IR_LOAD:
+            emit_load(out, frame, "x9", instruction->operands[0]);
+            emit_sp_offset(out, "add", "x16", frame->arrays + (long)function->arrays[instruction->array].offset * WORD_SIZE);
+            emit_instr(out, "ldr", "x9, [x16, x9, lsl #3]");
+            emit_store(out, frame, "x9", instruction->dest);
+            break;
+        case IR_STORE:
+            emit_load(out, frame, "x9", instruction->operands[0]);
+            emit_load(out, frame, "x10", instruction->operands[1]);
+            emit_sp_offset(out, "add", "x16", frame->arrays + (long)function->arrays[instruction->array].offset * WORD_SIZE);
+            emit_instr(out, "str", "x10, [x16, x9, lsl #3]");
+            break;
+        case IR_CHECK: {
+            // Taken as unsigned, one compare also catches negative indices.
+            char ok[32];
+            snprintf(ok, sizeof(ok), ".bounds_ok_%d", ctx->label_count++);
+            emit_load(out, frame, "x9", instruction->operands[0]);
+            emit_constant(out, "x10", instruction->immediate);
+            emit_instr(out, "cmp", "x9, x10");
+            emit_instr_format(out, "b.lo", "%s", ok);
+            emit_instr(out, "brk", "#1");
+            emit_label(out, ok);
+            break;
+        }
+        case IR_CALL: {
+            IrCall *call = instruction->call;
+            for (int i = 0; i < call->argument_count; i++) {
+                if (i < 8) {
+                    char reg[16];
+                    snprintf(reg, sizeof(reg), "x%d", i);
+                    emit_load(out, frame, reg, call->arguments[i]);
+                } else {
+                    emit_load(out, frame, "x9", call->arguments[i]);
+                    emit_access(out, "str", "x9", "sp", (long)(i - 8) * WORD_SIZE);
+                }
+            }
+            emit_instr_format(out, "bl", "_%s", call->callee);
+            frame->x9_holds = IR_NONE;
+            emit_store(out, frame, "x0", instruction->dest);
+            break;
+        }
+        case IR_PRINT:
+            emit_load(out, frame, "x1", instruction->operands[0]);
+            emit_print(out, ctx);
+            frame->x9_holds = IR_NONE;
+            break;
+        case IR_PHI:
+            // Given its value on the way in, by emit_edge()
+            break;
+        case IR_BRANCH: {
+            int then_block = instruction->targets[0], else_block = instruction->targets[1];
+            emit_load(out, frame, "x9", instruction->operands[0]);
+            if (has_phis(&function->blocks[then_block]) || has_phis(&function->blocks[else_block])) {
+                char edge[32];
+                snprintf(edge, sizeof(edge), ".edge_%d", ctx->label_count++);
+                emit_instr_format(out, "cbz", "x9, %s", edge);
+                emit_edge(out, function, frame, labels, b, then_block);
+                if (then_block == b + 1) {
+                    emit_instr_format(out, "b", ".block_%d", labels + then_block);
+                }
+                emit_label(out, edge);
+                frame->x9_holds = IR_NONE;
+                emit_edge(out, function, frame, labels, b, else_block);
+            } else {
+                emit_instr_format(out, "cbz", "x9, .block_%d", labels + else_block);
+                if (then_block != b + 1) {
+                    emit_instr_format(out, "b", ".block_%d", labels + then_block);
+                }
+            }
+            break;
+        }
+        case IR_JUMP:
+            emit_edge(out, function, frame, labels, b, instruction->targets[0]);
+            break;
+        case IR_RETURN:
+            if (instruction->operands[0] != IR_NONE) {
+                emit_load(out, frame, "x0", instruction->operands[0]);
+            }
+            emit_return(out);
+            break;
+        case IR_TAIL_CALL: {
+            // Its arguments all fit in registers, so the frame can go first.
+            IrCall *call = instruction->call;
+            for (int i = 0; i < call->argument_count; i++) {
+                char reg[16];
+                snprintf(reg, sizeof(reg), "x%d", i);
+                emit_load(out, frame, reg, call->arguments[i]);
+            }
+            emit_frame_teardown(out);
+            emit_instr_format(out, "b", "_%s", call->callee);
+            break;
+        }
+        default:
+            emit_load(out, frame, "x9", instruction->operands[0]);
+            emit_load(out, frame, "x10", instruction->operands[1]);
+            emit_binary(out, instruction->opcode);
+            emit_store(out, frame, "x9", instruction->dest);
+            break;
+    }
+}
+
+/* Emit a function's blocks in order, letting each fall through to the
+ * next where it can. Registers live in frame slots, which registers whose
+ * live ranges do not overlap share (see assign_slots()).
+ */
+static void write_function(FILE *out, IrFunction *function, Context *ctx) {
+    Frame frame = lay_out_frame(function, ctx);
+    int labels = ctx->label_count;
+    ctx->label_count += function->block_count;
+
+    emit_prologue(out, function, &frame, ctx);
+    for (int b = 0; b < function->block_count; b++) {
+        IrBlock *block = &function->blocks[b];
+        if (b > 0) {
+            char label[32];
+            snprintf(label, sizeof(label), ".block_%d", labels + b);
+            emit_label(out, label);
+        }
+        frame.x9_holds = IR_NONE;
+        for (int i = 0; i < block->count; i++) {
+            emit_instruction(out, function, &frame, labels, b, &block->instructions[i], ctx);
+        }
+    }
+    emit_function_epilogue(out);
+    free(frame.slots);
+    free(frame.constants);
+    free(frame.parallel_copies);
+}
+
+/* The backend: emit the functions of program. */
+void write_ir(FILE *out, IrProgram *program, Context *ctx) {
+    for (int i = 0; i < program->function_count; i++) {
+        write_function(out, program->functions[i], ctx);
+    }
+}
+
+/* Emit an analyzed tree, such as a TOP_LEVEL, by way of the IR,
+ * optimized as ctx asks.
+ */
+void write_syntax(FILE *out, Syntax *syntax, Context *ctx) {
+    IrProgram *program = lower_syntax(syntax, ctx);
+    optimize_program(program, ctx->optimize, ctx->inline_limit, &ctx->opt_stats);
+    write_ir(out, program, ctx);
+    ir_program_free(program);
+}
+
+/* A context for generating the code of compilation. */
+Context *codegen_context_new(Compilation *compilation) {
+    Context *ctx = new_context();
+    ctx->is_M1 = compilation->is_M1;
+    ctx->optimize = compilation->optimize;
+    ctx->inline_limit = compilation->inline_limit;
+    if (compilation->bounds_check) {
+        ctx->bounds_checks = bounds_checks_new();
+    }
+    return ctx;
+}
+
+/* Free ctx, adding up its bounds checks and pass statistics in compilation. */
+void codegen_context_free(Compilation *compilation, Context *ctx) {
+    compilation->checks_emitted += ctx->checks_emitted;
+    compilation->checks_elided += ctx->checks_elided;
+    opt_stats_add(&compilation->opt_stats, &ctx->opt_stats);
+    context_free(ctx);
+}
+
+void write_assembly(Compilation *compilation, char *file_name) {
     FILE *out = fopen(file_name, "w");
     if (!out) {
         err(1, "Could not open output file %s", file_name);
     }
 
-    check_target_architecture();
-    Context *ctx = new_context();
+    Context *ctx = codegen_context_new(compilation);
+    ctx->whole_program = 1;
 
     write_header(out);
-    write_syntax(out, syntax, ctx);
-    write_footer(out);
+    write_syntax(out, compilation->syntax, ctx);
+    write_footer(out, ctx);
 
-    context_free(ctx);
+    codegen_context_free(compilation, ctx);
     fclose(out);
 }
\ No newline at end of file
@@ -1,17 +1,22 @@
 #include <stdio.h>
 #include "syntax.h"
 #include "context.h" // Added to define Context type
+#include "compilation.h"
+#include "ir.h"
 
 #ifndef ASSEMBLY_HEADER
 #define ASSEMBLY_HEADER
 
-void check_target_architecture();
+int check_target_architecture();
 void emit_header(FILE *out, char *name);
 void emit_insn(FILE *out, char *insn);
-void emit_print(FILE *out); // Removed unused Context *ctx parameter
+void emit_print(FILE *out, Context *ctx);
 void write_header(FILE *out);
-void write_footer(FILE *out);
-void write_syntax(FILE *out, Syntax *syntax);
-void write_assembly(Syntax *syntax, char *file_name);
+void write_footer(FILE *out, Context *ctx);
+void write_ir(FILE *out, IrProgram *program, Context *ctx);
+void write_syntax(FILE *out, Syntax *syntax, Context *ctx);
+void write_assembly(Compilation *compilation, char *file_name);
+Context *codegen_context_new(Compilation *compilation);
+void codegen_context_free(Compilation *compilation, Context *ctx);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,45 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+/* Counts the calls a program makes to the allocator, and prints them to
+ * stderr when it exits. Loaded with LD_PRELOAD, so it needs glibc, whose
+ * __libc_ functions it forwards to:
+ *
+ *   LD_PRELOAD=build/alloc_count.so build/dd --dump-ast foo.dd
+ *
+ * The counts are not atomic; they are exact for a single thread.
+ */
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *pointer, size_t size);
+extern void __libc_free(void *pointer);
+
+static unsigned long mallocs, reallocs, frees;
+
+void *malloc(size_t size) {
+    mallocs++;
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) {
+    mallocs++;
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *pointer, size_t size) {
+    reallocs++;
+    return __libc_realloc(pointer, size);
+}
+
+void free(void *pointer) {
+    if (pointer != NULL) {
+        frees++;
+    }
+    __libc_free(pointer);
+}
+
+__attribute__((destructor))
+static void print_counts(void) {
+    fprintf(stderr, "%lu malloc, %lu realloc, %lu free\n", mallocs, reallocs, frees);
+}
@@ -0,0 +1,100 @@
+#!/bin/bash
+# Benchmarks of the compiler, mostly on programs from bench/generate.
+# Run through the makefile, which builds what each one needs:
+#
+#   make bench-lexer       --dump-tokens, against the old flex scanner
+#   make bench-scan        the structural pre-scan, with each classifier
+#   make bench-parse       parse time against function length
+#   make bench-pipeline    a whole compile, serial against --pipeline
+#   make bench-containers  List operations, on its own input
+#   make bench-allocs      allocator calls while parsing, with LD_PRELOAD
+#
+# Numbers are for build/dd and build/*.o as built; for representative
+# ones, build with optimization, e.g. make clean && make CFLAGS="-O2 -std=gnu99".
+
+BUILD=build
+INPUT=$BUILD/bench.dd
+RUNS=3
+
+# The best wall time of RUNS runs of a command, in seconds.
+best_time() {
+    local best=""
+    for run in $(seq $RUNS); do
+        local start=$(date +%s.%N)
+        "$@" > /dev/null
+        local end=$(date +%s.%N)
+        best=$(echo "$start $end $best" | awk '{ t = $2 - $1; print ($3 == "" || t < $3) ? t : $3 }')
+    done
+    echo $best
+}
+
+bench_lexer() {
+    $BUILD/generate functions ${1:-20000} > $INPUT
+    local bytes=$(wc -c < $INPUT)
+    local tokens=$($BUILD/dd --dump-tokens $INPUT | awk '/Total tokens/ { print $3 }')
+    echo "$INPUT: $bytes bytes, $tokens tokens"
+
+    local seconds=$(best_time $BUILD/dd --dump-tokens $INPUT)
+    echo "$seconds $tokens $bytes" | awk '{ printf "lexer.c: %.3fs, %.1f Mtok/s, %.0f MB/s\n", $1, $2 / $1 / 1e6, $3 / $1 / 1e6 }'
+    if [ -x $BUILD/flex_tokens ]; then
+        seconds=$(best_time $BUILD/flex_tokens $INPUT)
+        echo "$seconds $tokens $bytes" | awk '{ printf "dd.l:    %.3fs, %.1f Mtok/s, %.0f MB/s\n", $1, $2 / $1 / 1e6, $3 / $1 / 1e6 }'
+    else
+        echo "dd.l:    not timed, flex is not installed"
+    fi
+}
+
+# The pre-scan alone, on code with a line comment on every line.
+bench_scan() {
+    $BUILD/generate functions ${1:-20000} > $INPUT
+    echo "$INPUT: $(wc -c < $INPUT) bytes"
+    for classifier in avx2 sse2 scalar; do
+        $BUILD/scan_bench_$classifier $classifier $INPUT
+    done
+}
+
+# One function of N statements, for N doubling: the time per statement
+# stays flat while parsing is linear.
+bench_parse() {
+    for statements in 50000 100000 200000 400000; do
+        $BUILD/generate statements $statements > $INPUT
+        local seconds=$(best_time $BUILD/dd --dump-ast $INPUT)
+        echo "$statements $seconds" | awk '{ printf "%7d statements: %.3fs, %.2f us a statement\n", $1, $2, $2 / $1 * 1e6 }'
+    done
+}
+
+# A whole compile of many functions, serially, a function at a time and
+# with each stage on a thread of its own.
+bench_pipeline() {
+    $BUILD/generate functions ${1:-20000} > $INPUT
+    echo "$INPUT: $(wc -c < $INPUT) bytes"
+    for mode in "" --stream --pipeline; do
+        local seconds=$(best_time $BUILD/dd $mode $INPUT)
+        echo "${mode:-serial} $seconds" | awk '{ printf "%-10s %.3fs\n", $1, $2 }'
+    done
+}
+
+bench_containers() {
+    $BUILD/containers
+}
+
+# Allocator calls for parsing and freeing the tree, counted by
+# bench/alloc_count. Needs glibc.
+bench_allocs() {
+    $BUILD/generate functions ${1:-20000} > $INPUT
+    echo "$INPUT: $(wc -c < $INPUT) bytes"
+    LD_PRELOAD=$BUILD/alloc_count.so $BUILD/dd --dump-ast $INPUT > /dev/null
+}
+
+case "$1" in
+    lexer) bench_lexer $2 ;;
+    scan) bench_scan $2 ;;
+    parse) bench_parse ;;
+    pipeline) bench_pipeline $2 ;;
+    containers) bench_containers ;;
+    allocs) bench_allocs $2 ;;
+    *)
+        echo "usage: bench.sh lexer|scan|allocs|pipeline [N] | bench.sh parse|containers"
+        exit 1
+        ;;
+esac
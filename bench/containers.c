@@ -0,0 +1,85 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+#include "../list.h"
+
+/* Times the operations the compiler makes most of on its containers,
+ * linked against the objects the makefile builds, so at the level it
+ * ships them.
+ */
+
+static double now(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+static void report(const char *name, double start, long checksum) {
+    printf("%-30s %.3fs  (%ld)\n", name, now() - start, checksum);
+}
+
+/* Most lists in a syntax tree are short: arguments, parameters, blocks. */
+static void short_lists(void) {
+    double start = now();
+    long checksum = 0;
+    for (int i = 0; i < 250000; i++) {
+        List *list = list_new();
+        for (intptr_t j = 0; j < 4; j++) {
+            list_append(list, (void *)j);
+        }
+        checksum += list_length(list);
+        list_free(list);
+    }
+    report("250k lists of 4 appends", start, checksum);
+}
+
+static void append_get_pop(void) {
+    double start = now();
+    long checksum = 0;
+    List *list = list_new();
+    for (intptr_t i = 0; i < 1000000; i++) {
+        list_append(list, (void *)i);
+    }
+    for (int i = 0; i < 1000000; i++) {
+        checksum += (intptr_t)list_get(list, i);
+    }
+    while (list_length(list) > 0) {
+        checksum -= (intptr_t)list_pop(list);
+    }
+    list_free(list);
+    report("1M list append + get + pop", start, checksum);
+}
+
+static void push_front(void) {
+    double start = now();
+    List *list = list_new();
+    for (intptr_t i = 0; i < 100000; i++) {
+        list_push(list, (void *)i);
+    }
+    long checksum = (intptr_t)list_get(list, 0);
+    list_free(list);
+    report("100k list_push (front)", start, checksum);
+}
+
+static void arena_lists(void) {
+    double start = now();
+    long checksum = 0;
+    Arena *arena = arena_new();
+    for (int i = 0; i < 250000; i++) {
+        List *list = list_new_in(arena);
+        for (intptr_t j = 0; j < 16; j++) {
+            list_append(list, (void *)j);
+        }
+        checksum += (intptr_t)list_get(list, 15);
+    }
+    arena_free(arena);
+    report("250k arena lists of 16", start, checksum);
+}
+
+int main(void) {
+    short_lists();
+    append_get_pop();
+    push_front();
+    arena_lists();
+    return 0;
+}
@@ -0,0 +1,68 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Writes the generated programs the benchmarks in bench.sh run on, to
+ * stdout, so that they can be reproduced without checking in megabytes
+ * of source:
+ *
+ *   generate functions N    N functions of 20 commented statements each
+ *   generate statements N   one function of N statements
+ */
+
+static void print_usage(void) {
+    fprintf(stderr, "usage: generate functions N | generate statements N\n");
+}
+
+/* A pseudo-random constant, the same on every run and platform. */
+static unsigned next_constant(unsigned *state) {
+    *state = *state * 1103515245 + 12345;
+    return (*state >> 16) % 100000;
+}
+
+/* Code of the kind that is machine-generated: short statements, each
+ * with a line comment, and a block comment in every function.
+ */
+static void generate_functions(long count) {
+    unsigned state = 1;
+    for (long f = 0; f < count; f++) {
+        printf("fun helper%ld(var a, var b) {\n", f);
+        printf("    var x0 = a * %u + b; // comment 0\n", next_constant(&state));
+        for (int i = 1; i < 20; i++) {
+            printf("    var x%d = a * %u + (b - x%d); // comment %d\n", i, next_constant(&state), i - 1, i);
+        }
+        printf("    /* block\n comment */\n");
+        printf("    if (a > b) { print a; } else { return helper%ld(a, b); }\n", f);
+        printf("    return x19;\n");
+        printf("}\n");
+    }
+    printf("fun main() {\n    return helper0(1, 2);\n}\n");
+}
+
+static void generate_statements(long count) {
+    printf("fun main() {\n");
+    printf("    var x0 = 1;\n");
+    printf("    var x1 = 2;\n");
+    for (long i = 0; i < count; i++) {
+        printf("    print %ld + x%ld;\n", i, i % 2);
+    }
+    printf("    return 0;\n");
+    printf("}\n");
+}
+
+int main(int argc, char *argv[]) {
+    if (argc != 3 || atol(argv[2]) <= 0) {
+        print_usage();
+        return 1;
+    }
+    long count = atol(argv[2]);
+    if (strcmp(argv[1], "functions") == 0) {
+        generate_functions(count);
+    } else if (strcmp(argv[1], "statements") == 0) {
+        generate_statements(count);
+    } else {
+        print_usage();
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,42 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "../scan.h"
+
+#define RUNS 10
+
+/* Times building the structural index of a file, best of RUNS, in GB/s.
+ * The makefile links it with scan.c built for each classifier in turn.
+ */
+int main(int argc, char *argv[]) {
+    FILE *file = argc == 3 ? fopen(argv[2], "rb") : NULL;
+    if (file == NULL) {
+        fprintf(stderr, "usage: scan_bench NAME foo.dd\n");
+        return 1;
+    }
+    fseek(file, 0, SEEK_END);
+    size_t length = ftell(file);
+    rewind(file);
+    char *text = malloc(length > 0 ? length : 1);
+    if (fread(text, 1, length, file) != length) {
+        fprintf(stderr, "Could not read %s\n", argv[2]);
+        return 1;
+    }
+    fclose(file);
+
+    double best = 0;
+    for (int run = 0; run < RUNS; run++) {
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        StructuralIndex *index = structural_index_build(text, length);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        structural_index_free(index);
+        double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+        if (run == 0 || seconds < best) {
+            best = seconds;
+        }
+    }
+    printf("%-7s %.2f GB/s\n", argv[1], length / best / 1e9);
+    free(text);
+    return 0;
+}
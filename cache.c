@@ -0,0 +1,263 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "cache.h"
+
+#define AST_CACHE_MAGIC 0x54534444 // "DDST" read as a little-endian word
+#define AST_CACHE_VERSION 1
+
+/* The file starts with this header, followed by the arrays in the order
+ * below: the 32-bit ones first so that every array is aligned, then the
+ * bytes, then the strings.
+ *
+ *   operands, first_child, child_count   node_count each
+ *   children                             edge_count
+ *   name_offsets                         name_count, into strings
+ *   kinds, operators                     node_count each
+ *   strings                              string_bytes
+ */
+typedef struct AstCacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t source_size;
+    int64_t source_mtime;
+    int64_t source_mtime_nsec;
+    uint32_t node_count;
+    uint32_t edge_count;
+    uint32_t name_count;
+    uint32_t string_bytes;
+} AstCacheHeader;
+
+static void source_stamp(const struct stat *st, AstCacheHeader *header) {
+    header->source_size = st->st_size;
+    header->source_mtime = st->st_mtime;
+#ifdef __APPLE__
+    header->source_mtime_nsec = st->st_mtimespec.tv_nsec;
+#else
+    header->source_mtime_nsec = st->st_mtim.tv_nsec;
+#endif
+}
+
+static uint64_t cache_size(const AstCacheHeader *header) {
+    return sizeof(AstCacheHeader)
+        + (uint64_t)header->node_count * 3 * sizeof(uint32_t)
+        + (uint64_t)header->edge_count * sizeof(NodeIndex)
+        + (uint64_t)header->name_count * sizeof(uint32_t)
+        + (uint64_t)header->node_count * 2 * sizeof(uint8_t)
+        + header->string_bytes;
+}
+
+/* Save flat, stamped with the size and modification time of
+ * source_file. The file is written under a temporary name and renamed
+ * into place, so a reader never sees it half-written. Returns 0 on
+ * success.
+ */
+int ast_cache_write(const FlatSyntax *flat, const char *cache_file, const char *source_file) {
+    struct stat st;
+    if (stat(source_file, &st) != 0) {
+        return 1;
+    }
+
+    AstCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = AST_CACHE_MAGIC;
+    header.version = AST_CACHE_VERSION;
+    source_stamp(&st, &header);
+    header.node_count = flat->node_count;
+    header.edge_count = flat->edge_count;
+    header.name_count = flat->name_count;
+
+    uint32_t *name_offsets = malloc((flat->name_count + 1) * sizeof(uint32_t));
+    for (uint32_t i = 0; i < flat->name_count; i++) {
+        name_offsets[i] = header.string_bytes;
+        header.string_bytes += strlen(flat->names[i]) + 1;
+    }
+
+    char temporary_file[4096];
+    snprintf(temporary_file, sizeof(temporary_file), "%s.%d.tmp", cache_file, (int)getpid());
+    FILE *out = fopen(temporary_file, "wb");
+    if (out == NULL) {
+        free(name_offsets);
+        return 1;
+    }
+
+    fwrite(&header, sizeof(header), 1, out);
+    fwrite(flat->operands, sizeof(int32_t), flat->node_count, out);
+    fwrite(flat->first_child, sizeof(uint32_t), flat->node_count, out);
+    fwrite(flat->child_count, sizeof(uint32_t), flat->node_count, out);
+    fwrite(flat->children, sizeof(NodeIndex), flat->edge_count, out);
+    fwrite(name_offsets, sizeof(uint32_t), flat->name_count, out);
+    fwrite(flat->kinds, sizeof(uint8_t), flat->node_count, out);
+    fwrite(flat->operators, sizeof(uint8_t), flat->node_count, out);
+    for (uint32_t i = 0; i < flat->name_count; i++) {
+        fwrite(flat->names[i], 1, strlen(flat->names[i]) + 1, out);
+    }
+    free(name_offsets);
+
+    int failed = ferror(out);
+    if (fclose(out) != 0 || failed || rename(temporary_file, cache_file) != 0) {
+        unlink(temporary_file);
+        return 1;
+    }
+    return 0;
+}
+
+/* The number of children a node of this kind has, or -1 for a list. */
+static int fixed_child_count(SyntaxType kind) {
+    switch (kind) {
+        case IMMEDIATE:
+        case ARRAY_TYPE:
+        case VARIABLE:
+            return 0;
+        case UNARY_OPERATOR:
+        case FUNCTION_CALL:
+        case RETURN_STATEMENT:
+        case PRINT_STATEMENT:
+        case DEFINE_VAR:
+        case ASSIGNMENT:
+        case ARRAY_ACCESS:
+            return 1;
+        case BINARY_OPERATOR:
+        case FUNCTION:
+        case ARRAY_ASSIGNMENT:
+            return 2;
+        case IF_STATEMENT:
+            return 3;
+        default:
+            return -1;
+    }
+}
+
+/* Whether child i of a node of this kind may be absent. */
+static int optional_child(SyntaxType kind, uint32_t i) {
+    return (kind == IF_STATEMENT && i == 2) || kind == RETURN_STATEMENT
+        || kind == FUNCTION || kind == FUNCTION_CALL;
+}
+
+static int names_node(SyntaxType kind) {
+    return kind == VARIABLE || kind == FUNCTION_CALL || kind == DEFINE_VAR || kind == FUNCTION
+        || kind == ASSIGNMENT || kind == ARRAY_ACCESS || kind == ARRAY_ASSIGNMENT;
+}
+
+/* Check that the arrays describe a tree the rest of the compiler can
+ * use: known kinds and operators, names and children in range, and
+ * every child numbered after its parent.
+ */
+static int flat_valid(const FlatSyntax *flat) {
+    if (flat->node_count == 0 || flat_kind(flat, 0) != TOP_LEVEL) return 0;
+
+    for (NodeIndex node = 0; node < flat->node_count; node++) {
+        SyntaxType kind = flat_kind(flat, node);
+        if (kind > ARRAY_ASSIGNMENT) return 0;
+        if (kind == UNARY_OPERATOR && flat_operator(flat, node) > LOGICAL_NEGATION) return 0;
+        if (kind == BINARY_OPERATOR && flat_operator(flat, node) > LESS_EQUALS) return 0;
+        if (names_node(kind) && (uint32_t)flat_value(flat, node) >= flat->name_count) return 0;
+
+        uint32_t count = flat_child_count(flat, node);
+        int fixed = fixed_child_count(kind);
+        if (fixed >= 0 && count != (uint32_t)fixed) return 0;
+        if ((uint64_t)flat->first_child[node] + count > flat->edge_count) return 0;
+
+        for (uint32_t i = 0; i < count; i++) {
+            NodeIndex child = flat_child(flat, node, i);
+            if (child == FLAT_NONE) {
+                if (fixed < 0 || !optional_child(kind, i)) return 0;
+            } else if (child <= node || child >= flat->node_count) {
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+/* Map cache_file if it was written for source_file as it is now, or
+ * return NULL if it is missing, stale or damaged.
+ */
+AstCache *ast_cache_open(const char *cache_file, const char *source_file) {
+    struct stat source_st;
+    if (stat(source_file, &source_st) != 0) {
+        return NULL;
+    }
+
+    int fd = open(cache_file, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(AstCacheHeader)) {
+        close(fd);
+        return NULL;
+    }
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return NULL;
+    }
+
+    AstCacheHeader *header = map;
+    AstCacheHeader expected;
+    source_stamp(&source_st, &expected);
+    if (header->magic != AST_CACHE_MAGIC || header->version != AST_CACHE_VERSION
+        || header->source_size != expected.source_size
+        || header->source_mtime != expected.source_mtime
+        || header->source_mtime_nsec != expected.source_mtime_nsec
+        || cache_size(header) != (uint64_t)st.st_size) {
+        munmap(map, st.st_size);
+        return NULL;
+    }
+
+    AstCache *cache = malloc(sizeof(AstCache));
+    cache->map = map;
+    cache->length = st.st_size;
+
+    FlatSyntax *flat = &cache->flat;
+    char *cursor = (char *)map + sizeof(AstCacheHeader);
+    flat->node_count = header->node_count;
+    flat->edge_count = header->edge_count;
+    flat->name_count = header->name_count;
+    flat->operands = (int32_t *)cursor;
+    cursor += header->node_count * sizeof(int32_t);
+    flat->first_child = (uint32_t *)cursor;
+    cursor += header->node_count * sizeof(uint32_t);
+    flat->child_count = (uint32_t *)cursor;
+    cursor += header->node_count * sizeof(uint32_t);
+    flat->children = (NodeIndex *)cursor;
+    cursor += header->edge_count * sizeof(NodeIndex);
+    uint32_t *name_offsets = (uint32_t *)cursor;
+    cursor += header->name_count * sizeof(uint32_t);
+    flat->kinds = (uint8_t *)cursor;
+    cursor += header->node_count;
+    flat->operators = (uint8_t *)cursor;
+    cursor += header->node_count;
+    const char *strings = cursor;
+
+    // Names are interned afresh, so they compare equal to any the parser
+    // or analyzer creates.
+    flat->names = malloc(header->name_count * sizeof(Name));
+    int valid = header->name_count == 0 || strings[header->string_bytes - 1] == '\0';
+    for (uint32_t i = 0; valid && i < header->name_count; i++) {
+        if (name_offsets[i] >= header->string_bytes) {
+            valid = 0;
+        } else {
+            flat->names[i] = intern_string(strings + name_offsets[i]);
+        }
+    }
+
+    if (!valid || !flat_valid(flat)) {
+        ast_cache_close(cache);
+        return NULL;
+    }
+    return cache;
+}
+
+void ast_cache_close(AstCache *cache) {
+    if (cache == NULL) return;
+    free(cache->flat.names);
+    munmap(cache->map, cache->length);
+    free(cache);
+}
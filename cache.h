@@ -0,0 +1,24 @@
+#include <stddef.h>
+#include "flat.h"
+
+#ifndef CACHE_HEADER
+#define CACHE_HEADER
+
+/* A flat syntax tree saved to disk, so that a later run over the same,
+ * unchanged source can skip lexing and parsing. The file holds the flat
+ * arrays as they are in memory, with children and names referred to by
+ * index rather than by pointer, so it is read by mapping it and pointing
+ * the arrays into the mapping. Names are stored once each, as a table of
+ * NUL-terminated strings.
+ */
+typedef struct AstCache {
+    void *map;
+    size_t length;
+    FlatSyntax flat; // Arrays point into map, except names
+} AstCache;
+
+int ast_cache_write(const FlatSyntax *flat, const char *cache_file, const char *source_file);
+AstCache *ast_cache_open(const char *cache_file, const char *source_file);
+void ast_cache_close(AstCache *cache);
+
+#endif
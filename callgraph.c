@@ -0,0 +1,168 @@
+#include <stdlib.h>
+#include <string.h>
+#include "callgraph.h"
+
+static unsigned long name_hash(Name name) {
+    return ((unsigned long)name >> 3) * 0x9e3779b97f4a7c15UL >> 20;
+}
+
+/* The number of the function called name, or IR_NONE if the program
+ * does not define it.
+ */
+int call_graph_find(CallGraph *graph, Name name) {
+    unsigned long h = name_hash(name) & graph->mask;
+    while (graph->buckets[h] != IR_NONE) {
+        if (graph->program->functions[graph->buckets[h]]->name == name) {
+            return graph->buckets[h];
+        }
+        h = (h + 1) & graph->mask;
+    }
+    return IR_NONE;
+}
+
+/* Tarjan's algorithm, without recursion. A component is finished only
+ * after every component it calls, so numbering them as they finish puts
+ * callees first.
+ */
+static void find_components(CallGraph *graph) {
+    int n = graph->program->function_count;
+    int *index = malloc(n * sizeof(int));
+    int *lowlink = malloc(n * sizeof(int));
+    int *next_edge = malloc(n * sizeof(int));
+    char *on_stack = calloc(n, 1);
+    int *stack = malloc(n * sizeof(int)); // Of functions not yet in a component
+    int *calls = malloc(n * sizeof(int)); // Of functions being visited
+    int stack_depth = 0, call_depth = 0, counter = 0, components = 0, ordered = 0;
+    for (int f = 0; f < n; f++) index[f] = IR_NONE;
+
+    for (int root = 0; root < n; root++) {
+        if (index[root] != IR_NONE) continue;
+        calls[call_depth++] = root;
+        index[root] = lowlink[root] = counter++;
+        next_edge[root] = graph->first_callee[root];
+        stack[stack_depth++] = root;
+        on_stack[root] = 1;
+        while (call_depth > 0) {
+            int f = calls[call_depth - 1];
+            if (next_edge[f] < graph->first_callee[f + 1]) {
+                int g = graph->callees[next_edge[f]++];
+                if (index[g] == IR_NONE) {
+                    calls[call_depth++] = g;
+                    index[g] = lowlink[g] = counter++;
+                    next_edge[g] = graph->first_callee[g];
+                    stack[stack_depth++] = g;
+                    on_stack[g] = 1;
+                } else if (on_stack[g] && index[g] < lowlink[f]) {
+                    lowlink[f] = index[g];
+                }
+                continue;
+            }
+            if (lowlink[f] == index[f]) {
+                int g;
+                do {
+                    g = stack[--stack_depth];
+                    on_stack[g] = 0;
+                    graph->component[g] = components;
+                    graph->order[ordered++] = g;
+                } while (g != f);
+                components++;
+            }
+            call_depth--;
+            if (call_depth > 0) {
+                int caller = calls[call_depth - 1];
+                if (lowlink[f] < lowlink[caller]) lowlink[caller] = lowlink[f];
+            }
+        }
+    }
+    free(index);
+    free(lowlink);
+    free(next_edge);
+    free(on_stack);
+    free(stack);
+    free(calls);
+}
+
+CallGraph *call_graph_new(IrProgram *program) {
+    int n = program->function_count;
+    CallGraph *graph = malloc(sizeof(CallGraph));
+    graph->program = program;
+    unsigned long size = 16;
+    while (size < (unsigned long)n * 2) size *= 2;
+    graph->buckets = malloc(size * sizeof(int));
+    memset(graph->buckets, -1, size * sizeof(int));
+    graph->mask = size - 1;
+    for (int f = 0; f < n; f++) {
+        Name name = program->functions[f]->name;
+        unsigned long h = name_hash(name) & graph->mask;
+        while (graph->buckets[h] != IR_NONE && program->functions[graph->buckets[h]]->name != name) {
+            h = (h + 1) & graph->mask;
+        }
+        if (graph->buckets[h] == IR_NONE) {
+            graph->buckets[h] = f;
+        }
+    }
+
+    // Count the calls of each function, then fill them in.
+    graph->first_callee = calloc(n + 1, sizeof(int));
+    for (int pass = 0; pass < 2; pass++) {
+        int edges = 0;
+        for (int f = 0; f < n; f++) {
+            IrFunction *function = program->functions[f];
+            if (pass == 1) edges = graph->first_callee[f];
+            for (int b = 0; b < function->block_count; b++) {
+                IrBlock *block = &function->blocks[b];
+                for (int i = 0; i < block->count; i++) {
+                    if (!ir_is_call(block->instructions[i].opcode)) continue;
+                    int callee = call_graph_find(graph, block->instructions[i].call->callee);
+                    if (callee == IR_NONE) continue;
+                    if (pass == 0) {
+                        graph->first_callee[f + 1]++;
+                    } else {
+                        graph->callees[edges++] = callee;
+                    }
+                }
+            }
+        }
+        if (pass == 0) {
+            for (int f = 0; f < n; f++) graph->first_callee[f + 1] += graph->first_callee[f];
+            graph->callees = malloc((graph->first_callee[n] > 0 ? graph->first_callee[n] : 1) * sizeof(int));
+        }
+    }
+
+    graph->component = malloc((n > 0 ? n : 1) * sizeof(int));
+    graph->order = malloc((n > 0 ? n : 1) * sizeof(int));
+    find_components(graph);
+    return graph;
+}
+
+/* Of each function, whether root calls it, directly or not, or is it. */
+char *call_graph_reachable(CallGraph *graph, int root) {
+    int n = graph->program->function_count;
+    char *reachable = calloc(n > 0 ? n : 1, 1);
+    int *stack = malloc((n > 0 ? n : 1) * sizeof(int));
+    int depth = 0;
+    reachable[root] = 1;
+    stack[depth++] = root;
+    while (depth > 0) {
+        int f = stack[--depth];
+        for (int e = graph->first_callee[f]; e < graph->first_callee[f + 1]; e++) {
+            int g = graph->callees[e];
+            if (!reachable[g]) {
+                reachable[g] = 1;
+                stack[depth++] = g;
+            }
+        }
+    }
+    free(stack);
+    return reachable;
+}
+
+void call_graph_free(CallGraph *graph) {
+    if (graph == NULL) return;
+    free(graph->buckets);
+    free(graph->first_callee);
+    free(graph->callees);
+    free(graph->component);
+    free(graph->order);
+    free(graph);
+}
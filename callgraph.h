@@ -0,0 +1,22 @@
+#include "ir.h"
+
+#ifndef CALLGRAPH_HEADER
+#define CALLGRAPH_HEADER
+
+/* Which functions of a program call which, numbered as in the program. */
+typedef struct CallGraph {
+    IrProgram *program;
+    int *buckets; // Functions by name, open addressed
+    unsigned long mask;
+    int *first_callee; // The callees of function f are callees[first_callee[f]] up to first_callee[f + 1]
+    int *callees; // Once per call, of functions the program defines
+    int *component; // Of each function, its strongly connected component, numbered callees first
+    int *order; // The functions by component, so callees come before their callers outside recursion
+} CallGraph;
+
+CallGraph *call_graph_new(IrProgram *program);
+void call_graph_free(CallGraph *graph);
+int call_graph_find(CallGraph *graph, Name name);
+char *call_graph_reachable(CallGraph *graph, int root);
+
+#endif
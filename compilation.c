@@ -0,0 +1,446 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <err.h>
+#include "compilation.h"
+#include "queue.h"
+#include "assembly.h"
+#include "inline.h"
+#include "build/y.tab.h"
+
+/* Returns NULL if the source file could not be opened. */
+Compilation *compilation_new(char *file_name) {
+    Source *source = source_open(file_name);
+    if (source == NULL) {
+        return NULL;
+    }
+
+    Compilation *compilation = malloc(sizeof(Compilation));
+    compilation->file_name = file_name;
+    compilation->source = source;
+    lexer_init(&compilation->lexer, source);
+    compilation->arena = arena_new();
+    compilation->syntax = NULL;
+    compilation->is_M1 = check_target_architecture();
+    compilation->bounds_check = 0;
+    compilation->checks_emitted = 0;
+    compilation->checks_elided = 0;
+    compilation->optimize = 0;
+    compilation->inline_limit = DEFAULT_INLINE_LIMIT;
+    opt_stats_clear(&compilation->opt_stats);
+    return compilation;
+}
+
+/* A compilation whose tree comes from a flat tree, such as one loaded
+ * from an AST cache, rather than from parsing. It has no source.
+ */
+Compilation *compilation_new_from_flat(char *file_name, const FlatSyntax *flat) {
+    Compilation *compilation = malloc(sizeof(Compilation));
+    memset(compilation, 0, sizeof(Compilation));
+    compilation->file_name = file_name;
+    compilation->source = NULL;
+    compilation->arena = arena_new();
+    compilation->syntax = flat_syntax_expand(flat, compilation->arena);
+    compilation->is_M1 = check_target_architecture();
+    compilation->inline_limit = DEFAULT_INLINE_LIMIT;
+    return compilation;
+}
+
+void compilation_free(Compilation *compilation) {
+    if (compilation == NULL) return;
+    arena_free(compilation->arena);
+    source_close(compilation->source);
+    free(compilation);
+}
+
+/* Parse the whole source into compilation->syntax. Returns 0 on success. */
+int compilation_parse(Compilation *compilation) {
+    int result = yyparse(compilation);
+    if (result != 0 || compilation->lexer.error_count > 0) {
+        return 1;
+    }
+    return 0;
+}
+
+typedef struct ParseJob {
+    Compilation compilation; // Shares the parent's source, lexes only its range
+    pthread_t thread;
+    int started;
+    int result;
+} ParseJob;
+
+static void *run_parse_job(void *data) {
+    ParseJob *job = data;
+    job->result = yyparse(&job->compilation);
+    if (job->compilation.lexer.error_count > 0) {
+        job->result = 1;
+    }
+    return NULL;
+}
+
+/* Parse with up to `jobs` threads. A program is a flat sequence of
+ * functions, so the source is cut after top-level closing braces into
+ * pieces of roughly equal size, each piece is parsed on its own thread,
+ * and the functions are appended to one TOP_LEVEL in source order. The
+ * tree is identical to the one compilation_parse() builds. If any piece
+ * fails, the whole file is parsed again serially so that errors are
+ * reported exactly as in a serial run.
+ */
+int compilation_parse_parallel(Compilation *compilation, int jobs) {
+    Source *source = compilation->source;
+    size_t *ends;
+    size_t count = structural_top_level_ends(source->index, source->text, &ends);
+
+    size_t *cuts = malloc((jobs + 1) * sizeof(size_t));
+    int parts = 0;
+    cuts[0] = 0;
+    for (size_t i = 0; i < count && parts + 1 < jobs; i++) {
+        if (ends[i] < source->length && ends[i] >= (parts + 1) * (source->length / jobs)) {
+            cuts[++parts] = ends[i];
+        }
+    }
+    cuts[++parts] = source->length;
+    free(ends);
+
+    if (parts < 2) {
+        free(cuts);
+        return compilation_parse(compilation);
+    }
+
+    ParseJob *job = calloc(parts, sizeof(ParseJob));
+    for (int i = 0; i < parts; i++) {
+        job[i].compilation = *compilation;
+        job[i].compilation.arena = arena_new();
+        job[i].compilation.syntax = NULL;
+        lexer_init_range(&job[i].compilation.lexer, source, cuts[i], cuts[i + 1]);
+        job[i].compilation.lexer.silent = 1;
+    }
+    free(cuts);
+
+    // The calling thread takes the first piece itself.
+    for (int i = 1; i < parts; i++) {
+        job[i].started = pthread_create(&job[i].thread, NULL, run_parse_job, &job[i]) == 0;
+    }
+    run_parse_job(&job[0]);
+    for (int i = 1; i < parts; i++) {
+        if (job[i].started) {
+            pthread_join(job[i].thread, NULL);
+        } else {
+            run_parse_job(&job[i]);
+        }
+    }
+
+    int failed = 0;
+    for (int i = 0; i < parts; i++) {
+        failed |= job[i].result != 0;
+    }
+
+    if (!failed) {
+        compilation->syntax = top_level_new(compilation->arena);
+        List *declarations = compilation->syntax->top_level.declarations;
+        for (int i = 0; i < parts; i++) {
+            List *piece = job[i].compilation.syntax->top_level.declarations;
+            for (int j = 0; j < list_length(piece); j++) {
+                list_append(declarations, list_get(piece, j));
+            }
+        }
+    }
+
+    // The stitched tree points into every piece's arena.
+    for (int i = 0; i < parts; i++) {
+        if (failed) {
+            arena_free(job[i].compilation.arena);
+        } else {
+            arena_adopt(compilation->arena, job[i].compilation.arena);
+        }
+    }
+    free(job);
+
+    return failed ? compilation_parse(compilation) : 0;
+}
+
+/* Parse source[begin, end) into arena on its own, without printing
+ * errors. Returns a TOP_LEVEL, or NULL if the range does not parse.
+ */
+static Syntax *parse_range(Compilation *compilation, size_t begin, size_t end, Arena *arena) {
+    Compilation piece = *compilation;
+    piece.arena = arena;
+    piece.syntax = NULL;
+    lexer_init_range(&piece.lexer, compilation->source, begin, end);
+    piece.lexer.silent = 1;
+    if (yyparse(&piece) != 0 || piece.lexer.error_count > 0) {
+        return NULL;
+    }
+    return piece.syntax;
+}
+
+/* The fallback when a file cannot be split into functions: parse it as
+ * one, which also reports any syntax error, then analyze and emit it.
+ */
+static int compile_whole(Compilation *compilation, SemanticAnalyzer *analyzer, char *output_file) {
+    if (compilation_parse(compilation) != 0) {
+        return 1;
+    }
+    analyze_semantics(analyzer, compilation->syntax);
+    if (list_length(get_semantic_errors(analyzer)) == 0) {
+        write_assembly(compilation, output_file);
+    }
+    return 0;
+}
+
+/* Compile one function at a time, so that only a single function's tree
+ * is alive at once. A first pass parses each function just long enough
+ * to register its signature; a second pass parses it again, analyzes it,
+ * emits it and frees it before reading the next one. Calls to pure
+ * functions are not folded, as their bodies are gone by then, so the
+ * output matches a serial compilation only where there is nothing to
+ * fold. Semantic errors are left in the analyzer, and no output file is
+ * left behind if there are any. Returns nonzero on a parse error, which
+ * is reported by parsing the whole file serially.
+ */
+int compilation_stream(Compilation *compilation, SemanticAnalyzer *analyzer, char *output_file) {
+    Source *source = compilation->source;
+    size_t *ends;
+    size_t count = structural_top_level_ends(source->index, source->text, &ends);
+
+    // One arena is reused for every function in turn.
+    Arena *arena = arena_new();
+
+    // The text after the last function, usually empty, is a range of its own.
+    size_t begin = 0;
+    for (size_t i = 0; i <= count; i++) {
+        size_t end = i < count ? ends[i] : source->length;
+        Syntax *piece = parse_range(compilation, begin, end, arena);
+        if (piece == NULL) {
+            arena_free(arena);
+            free(ends);
+            return compile_whole(compilation, analyzer, output_file);
+        }
+        analyze_signatures(analyzer, piece);
+        arena_reset(arena);
+        begin = end;
+    }
+
+    FILE *out = fopen(output_file, "w");
+    if (!out) {
+        err(1, "Could not open output file %s", output_file);
+    }
+
+    Context *ctx = codegen_context_new(compilation);
+    write_header(out);
+
+    begin = 0;
+    for (size_t i = 0; i <= count; i++) {
+        size_t end = i < count ? ends[i] : source->length;
+        Syntax *piece = parse_range(compilation, begin, end, arena);
+        analyze_declarations(analyzer, piece);
+        if (list_length(get_semantic_errors(analyzer)) == 0) {
+            write_syntax(out, piece, ctx);
+        }
+        arena_reset(arena);
+        begin = end;
+    }
+    arena_free(arena);
+    free(ends);
+
+    write_footer(out, ctx);
+    codegen_context_free(compilation, ctx);
+    fclose(out);
+
+    if (list_length(get_semantic_errors(analyzer)) > 0) {
+        unlink(output_file);
+    }
+    return 0;
+}
+
+/* Lex just the signature at the start of source[begin, end), enough to
+ * register it, and append it to signatures as a FUNCTION without a body.
+ * A range without tokens adds nothing. Returns nonzero if the range does
+ * not start like a function.
+ */
+static int parse_signature(Compilation *compilation, Syntax *signatures, size_t begin, size_t end) {
+    Arena *arena = signatures->top_level.arena;
+    Lexer lexer;
+    lexer_init_range(&lexer, compilation->source, begin, end);
+    lexer.silent = 1;
+
+    YYSTYPE value;
+    int token = lexer_next(&lexer, &value);
+    if (token == 0) {
+        return 0;
+    }
+    if (token != FUN || lexer_next(&lexer, &value) != IDENTIFIER) {
+        return 1;
+    }
+    Name name = value.name;
+    if (lexer_next(&lexer, &value) != LB) {
+        return 1;
+    }
+
+    Syntax *parameters = function_arguments_new(arena);
+    while ((token = lexer_next(&lexer, &value)) != RB) {
+        if (token == TYPE) {
+            if (lexer_next(&lexer, &value) != IDENTIFIER) {
+                return 1;
+            }
+            list_append(parameters->function_arguments.arguments, define_var_new(arena, value.name, immediate_new(arena, 0)));
+        } else if (token != COMMA && token != LSB && token != NUMBER && token != RSB) {
+            return 1;
+        }
+    }
+    list_append(signatures->top_level.declarations, function_new(arena, name, parameters, NULL));
+    return 0;
+}
+
+#define PIPELINE_QUEUE_SIZE 64
+
+static char pipeline_end; // Queued after the last item of each stage
+
+typedef struct Pipeline {
+    Compilation *compilation;
+    SemanticAnalyzer *analyzer;
+    size_t *ends;
+    size_t count;
+    Queue *parsed; // TOP_LEVELs of one function each, parse -> analysis
+    Queue *analyzed; // The same TOP_LEVELs, analysis -> code generation
+    Queue *emitted; // Assembly text, code generation -> output
+    int failed; // Set by the parse stage on a syntax error
+} Pipeline;
+
+static void *run_parse_stage(void *data) {
+    Pipeline *pipeline = data;
+    size_t begin = 0;
+    for (size_t i = 0; i <= pipeline->count; i++) {
+        size_t end = i < pipeline->count ? pipeline->ends[i] : pipeline->compilation->source->length;
+        Arena *arena = arena_new();
+        Syntax *piece = parse_range(pipeline->compilation, begin, end, arena);
+        if (piece == NULL) {
+            arena_free(arena);
+            pipeline->failed = 1;
+            break;
+        }
+        queue_push(pipeline->parsed, piece);
+        begin = end;
+    }
+    queue_push(pipeline->parsed, &pipeline_end);
+    return NULL;
+}
+
+/* Only this thread touches the analyzer's errors until it is joined.
+ * Every function is analyzed, so that all errors are reported, but once
+ * there are any nothing more is passed on to be emitted, since code
+ * generation relies on every name being resolved.
+ */
+static void *run_analysis_stage(void *data) {
+    Pipeline *pipeline = data;
+    void *item;
+    while ((item = queue_pop(pipeline->parsed)) != &pipeline_end) {
+        analyze_declarations(pipeline->analyzer, item);
+        if (list_length(get_semantic_errors(pipeline->analyzer)) > 0) {
+            arena_free(((Syntax *)item)->top_level.arena);
+        } else {
+            queue_push(pipeline->analyzed, item);
+        }
+    }
+    queue_push(pipeline->analyzed, &pipeline_end);
+    return NULL;
+}
+
+static void *run_codegen_stage(void *data) {
+    Pipeline *pipeline = data;
+    Context *ctx = codegen_context_new(pipeline->compilation);
+
+    char *text;
+    size_t length;
+    FILE *out = open_memstream(&text, &length);
+    write_header(out);
+
+    void *item;
+    while ((item = queue_pop(pipeline->analyzed)) != &pipeline_end) {
+        write_syntax(out, item, ctx);
+        arena_free(((Syntax *)item)->top_level.arena);
+        fclose(out);
+        queue_push(pipeline->emitted, text);
+        out = open_memstream(&text, &length);
+    }
+
+    write_footer(out, ctx);
+    fclose(out);
+    queue_push(pipeline->emitted, text);
+    queue_push(pipeline->emitted, &pipeline_end);
+    codegen_context_free(pipeline->compilation, ctx);
+    return NULL;
+}
+
+/* Compile with parsing, semantic analysis and code generation each on a
+ * thread of its own, passing one function at a time between them, while
+ * the calling thread writes the output. Function signatures are lexed
+ * up front so that analysis may check calls to functions not yet
+ * parsed. The output is identical to compilation_stream()'s, which
+ * folds no calls, and semantic errors are left in the analyzer the same
+ * way.
+ */
+int compilation_pipeline(Compilation *compilation, SemanticAnalyzer *analyzer, char *output_file) {
+    Source *source = compilation->source;
+    Pipeline pipeline = { compilation, analyzer, NULL, 0, NULL, NULL, NULL, 0 };
+    pipeline.count = structural_top_level_ends(source->index, source->text, &pipeline.ends);
+
+    Syntax *signatures = top_level_new(arena_new());
+    size_t begin = 0;
+    for (size_t i = 0; i <= pipeline.count; i++) {
+        size_t end = i < pipeline.count ? pipeline.ends[i] : source->length;
+        if (parse_signature(compilation, signatures, begin, end) != 0) {
+            arena_free(signatures->top_level.arena);
+            free(pipeline.ends);
+            return compile_whole(compilation, analyzer, output_file);
+        }
+        begin = end;
+    }
+    analyze_signatures(analyzer, signatures);
+    arena_free(signatures->top_level.arena);
+
+    FILE *out = fopen(output_file, "w");
+    if (!out) {
+        err(1, "Could not open output file %s", output_file);
+    }
+
+    pipeline.parsed = queue_new(PIPELINE_QUEUE_SIZE);
+    pipeline.analyzed = queue_new(PIPELINE_QUEUE_SIZE);
+    pipeline.emitted = queue_new(PIPELINE_QUEUE_SIZE);
+
+    pthread_t parse_thread, analysis_thread, codegen_thread;
+    if (pthread_create(&parse_thread, NULL, run_parse_stage, &pipeline) != 0 ||
+        pthread_create(&analysis_thread, NULL, run_analysis_stage, &pipeline) != 0 ||
+        pthread_create(&codegen_thread, NULL, run_codegen_stage, &pipeline) != 0) {
+        err(1, "Could not start compilation threads");
+    }
+
+    void *item;
+    while ((item = queue_pop(pipeline.emitted)) != &pipeline_end) {
+        fputs(item, out);
+        free(item);
+    }
+
+    pthread_join(parse_thread, NULL);
+    pthread_join(analysis_thread, NULL);
+    pthread_join(codegen_thread, NULL);
+    fclose(out);
+
+    queue_free(pipeline.parsed);
+    queue_free(pipeline.analyzed);
+    queue_free(pipeline.emitted);
+    free(pipeline.ends);
+
+    if (pipeline.failed) {
+        // The whole-file parse prints the syntax error.
+        unlink(output_file);
+        compilation_parse(compilation);
+        return 1;
+    }
+    if (list_length(get_semantic_errors(analyzer)) > 0) {
+        unlink(output_file);
+    }
+    return 0;
+}
@@ -0,0 +1,37 @@
+#include "lexer.h"
+#include "syntax.h"
+#include "flat.h"
+#include "semantic.h"
+#include "opt.h"
+
+#ifndef COMPILATION_HEADER
+#define COMPILATION_HEADER
+
+/* Everything one run of the compiler over one source file needs. Nothing
+ * in the front end or code generator keeps state outside this object, so
+ * separate compilations can run on separate threads.
+ */
+typedef struct Compilation {
+    char *file_name;
+    Source *source; // NULL if the tree was not parsed from source
+    Lexer lexer;
+    Arena *arena; // Holds the syntax tree
+    Syntax *syntax; // The TOP_LEVEL tree, once parsed
+    int is_M1; // Emit for Apple silicon rather than Linux
+    int bounds_check; // Trap on array indices out of range
+    int checks_emitted; // Bounds checks, once code has been generated
+    int checks_elided;
+    int optimize; // The -O level
+    int inline_limit; // How far inlining may grow a caller per call, at -O2
+    OptStats opt_stats; // Once code has been generated
+} Compilation;
+
+Compilation *compilation_new(char *file_name);
+Compilation *compilation_new_from_flat(char *file_name, const FlatSyntax *flat);
+void compilation_free(Compilation *compilation);
+int compilation_parse(Compilation *compilation);
+int compilation_parse_parallel(Compilation *compilation, int jobs);
+int compilation_stream(Compilation *compilation, SemanticAnalyzer *analyzer, char *output_file);
+int compilation_pipeline(Compilation *compilation, SemanticAnalyzer *analyzer, char *output_file);
+
+#endif
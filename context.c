@@ -1,30 +1,22 @@
-#include "env.h"
 #include "context.h"
-
-// TODO: this is duplicated with assembly.c.
-static const int WORD_SIZE = 16;
-
-void new_scope(Context *ctx) {
-    environment_free(ctx->env);
-    ctx->env = environment_new();
-    ctx->stack_offset = -1 * WORD_SIZE;
-}
-
-void end_scope(Context *ctx) {
-    environment_free(ctx->env);
-    ctx->env = NULL;
-    ctx->stack_offset = 0;
-}
+#include "range.h"
+#include "inline.h"
 
 Context *new_context() {
     Context *ctx = malloc(sizeof(Context));
-    ctx->stack_offset = 0;
-    ctx->env = NULL;
     ctx->label_count = 0;
+    ctx->is_M1 = 0;
+    ctx->bounds_checks = NULL;
+    ctx->checks_emitted = 0;
+    ctx->checks_elided = 0;
+    ctx->optimize = 0;
+    ctx->inline_limit = DEFAULT_INLINE_LIMIT;
+    ctx->whole_program = 0;
+    opt_stats_clear(&ctx->opt_stats);
     return ctx;
 }
 
 void context_free(Context *ctx) {
-    environment_free(ctx->env);
+    bounds_checks_free(ctx->bounds_checks);
     free(ctx);
 }
\ No newline at end of file
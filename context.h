@@ -1,18 +1,22 @@
 #include <stdlib.h>
-#include "env.h" // Added to define Environment type
+#include "opt.h"
 
 #ifndef CONTEXT_HEADER
 #define CONTEXT_HEADER
 
 typedef struct Context
 {
-    int stack_offset;
-    Environment *env;
     int label_count;
+    int is_M1;
+    struct BoundsChecks *bounds_checks; // Set to check array indices at run time
+    int checks_emitted;
+    int checks_elided; // Proven unnecessary by range analysis
+    int optimize; // The -O level
+    int inline_limit;
+    int whole_program; // Whether write_syntax sees every function, not a piece of the source
+    OptStats opt_stats;
 } Context;
 
-void new_scope(Context *ctx);
-void end_scope(Context *ctx);
 Context *new_context();
 void context_free(Context *ctx);
 
@@ -3,25 +3,23 @@
 #include <stdlib.h>
 #include <assert.h>
 #include "../syntax.h"
-#include "../stack.h"
-
-int yyparse(void);
-int yylex();
-void yyerror(const char *str);
-int yywrap();
-
-extern FILE *yyin;
-
-Stack *syntax_stack;
+#include "../intern.h"
+#include "../compilation.h"
 %}
 
+%define api.pure full
+%parse-param { Compilation *compilation }
+%lex-param { Compilation *compilation }
+
 %union {
-    char *string;
+    Name name;
+    int number;
     struct Syntax *syntax;
 }
 
-%token <string> IDENTIFIER NUMBER TYPE
-%token FUN PRINT RETURN
+%token <name> IDENTIFIER
+%token <number> NUMBER
+%token TYPE FUN PRINT RETURN
 %token LB RB LSB RSB OPEN_BRACE CLOSE_BRACE
 %token IF ELSE
 %token EQ GT_EQ LT_EQ
@@ -37,108 +35,91 @@ Stack *syntax_stack;
 %nonassoc ELSE
 
 %type <syntax> program function_stmt block_stmt statement expression
-%type <syntax> parameter_list nonempty_parameter_list argument_list nonempty_argument_list
+%type <syntax> parameter_list nonempty_parameter_list parameter argument_list nonempty_argument_list
 %type <syntax> array_assignment array_access
 
+%{
+static int yylex(YYSTYPE *value, Compilation *compilation);
+static void yyerror(Compilation *compilation, const char *str);
+%}
+
 %%
 
+/* Lists are left-recursive and append to the list built so far, so a
+ * sequence of N items is parsed in O(N) time with constant parser stack.
+ */
+
+source_file:
+        program
+        {
+            compilation->syntax = $1;
+        }
+        ;
+
 program:
-        function_stmt program
-        {
-            Syntax *top_level_syntax;
-            if (stack_empty(syntax_stack)) {
-                top_level_syntax = top_level_new();
-            } else if (((Syntax *)stack_peek(syntax_stack))->type != TOP_LEVEL) {
-                top_level_syntax = top_level_new();
-            } else {
-                top_level_syntax = stack_pop(syntax_stack);
-            }
-            list_push(top_level_syntax->top_level->declarations, stack_pop(syntax_stack));
-            stack_push(syntax_stack, top_level_syntax);
+        program function_stmt
+        {
+            list_append($1->top_level.declarations, $2);
+            $$ = $1;
         }
         | /* empty */
         {
-            stack_push(syntax_stack, top_level_new());
+            $$ = top_level_new(compilation->arena);
         }
         ;
 
 function_stmt:
         FUN IDENTIFIER LB parameter_list RB OPEN_BRACE block_stmt CLOSE_BRACE
         {
-            Syntax *block = stack_pop(syntax_stack);
-            Syntax *params = stack_pop(syntax_stack);
-            stack_push(syntax_stack, function_new($2, params, block));
-            free($2);
+            $$ = function_new(compilation->arena, $2, $4, $7);
         }
         ;
 
 parameter_list:
         nonempty_parameter_list
         |
+        nonempty_parameter_list COMMA
+        |
         {
-            stack_push(syntax_stack, function_arguments_new());
+            $$ = function_arguments_new(compilation->arena);
         }
         ;
 
 nonempty_parameter_list:
-        TYPE IDENTIFIER LSB NUMBER RSB COMMA parameter_list
+        nonempty_parameter_list COMMA parameter
         {
-            Syntax *array_syntax = array_type_new(atoi($4));
-            Syntax *param = define_var_new($2, array_syntax);
-            Syntax *param_list = stack_pop(syntax_stack);
-            list_push(param_list->function_arguments->arguments, param);
-            stack_push(syntax_stack, param_list);
-            free($2);
-            free($4);
+            list_append($1->function_arguments.arguments, $3);
+            $$ = $1;
         }
         |
-        TYPE IDENTIFIER COMMA parameter_list
+        parameter
         {
-            Syntax *param = define_var_new($2, immediate_new(0));
-            Syntax *param_list = stack_pop(syntax_stack);
-            list_push(param_list->function_arguments->arguments, param);
-            stack_push(syntax_stack, param_list);
-            free($2);
+            $$ = function_arguments_new(compilation->arena);
+            list_append($$->function_arguments.arguments, $1);
         }
-        |
+        ;
+
+parameter:
         TYPE IDENTIFIER LSB NUMBER RSB
         {
-            Syntax *array_syntax = array_type_new(atoi($4));
-            Syntax *param = define_var_new($2, array_syntax);
-            Syntax *param_list = function_arguments_new();
-            list_push(param_list->function_arguments->arguments, param);
-            stack_push(syntax_stack, param_list);
-            free($2);
-            free($4);
+            $$ = define_var_new(compilation->arena, $2, array_type_new(compilation->arena, $4));
         }
         |
         TYPE IDENTIFIER
         {
-            Syntax *param = define_var_new($2, immediate_new(0));
-            Syntax *param_list = function_arguments_new();
-            list_push(param_list->function_arguments->arguments, param);
-            stack_push(syntax_stack, param_list);
-            free($2);
+            $$ = define_var_new(compilation->arena, $2, immediate_new(compilation->arena, 0));
         }
         ;
 
 block_stmt:
-        statement block_stmt
-        {
-            Syntax *block_syntax;
-            if (stack_empty(syntax_stack)) {
-                block_syntax = block_new(list_new());
-            } else if (((Syntax *)stack_peek(syntax_stack))->type != BLOCK) {
-                block_syntax = block_new(list_new());
-            } else {
-                block_syntax = stack_pop(syntax_stack);
-            }
-            list_push(block_syntax->block->statements, stack_pop(syntax_stack));
-            stack_push(syntax_stack, block_syntax);
+        block_stmt statement
+        {
+            list_append($1->block.statements, $2);
+            $$ = $1;
         }
         | /* empty */
         {
-            stack_push(syntax_stack, block_new(list_new()));
+            $$ = block_new(compilation->arena);
         }
         ;
 
@@ -146,234 +127,188 @@ argument_list:
         nonempty_argument_list
         |
         {
-            stack_push(syntax_stack, function_arguments_new());
+            $$ = function_arguments_new(compilation->arena);
         }
         ;
 
 nonempty_argument_list:
-        expression COMMA nonempty_argument_list
+        nonempty_argument_list COMMA expression
         {
-            Syntax *args;
-            if (((Syntax *)stack_peek(syntax_stack))->type != FUNCTION_ARGUMENTS) {
-                args = function_arguments_new();
-            } else {
-                args = stack_pop(syntax_stack);
-            }
-            list_push(args->function_arguments->arguments, stack_pop(syntax_stack));
-            stack_push(syntax_stack, args);
+            list_append($1->function_arguments.arguments, $3);
+            $$ = $1;
         }
         |
         expression
         {
-            Syntax *args = function_arguments_new();
-            list_push(args->function_arguments->arguments, stack_pop(syntax_stack));
-            stack_push(syntax_stack, args);
+            $$ = function_arguments_new(compilation->arena);
+            list_append($$->function_arguments.arguments, $1);
         }
         ;
 
 statement:
         RETURN expression SEMICOLON
         {
-            Syntax *expr = stack_pop(syntax_stack);
-            stack_push(syntax_stack, return_statement_new(expr));
+            $$ = return_statement_new(compilation->arena, $2);
         }
         |
         PRINT expression SEMICOLON
         {
-            Syntax *expr = stack_pop(syntax_stack);
-            stack_push(syntax_stack, print_statement_new(expr));
+            $$ = print_statement_new(compilation->arena, $2);
         }
         |
         IF LB expression RB OPEN_BRACE block_stmt CLOSE_BRACE
         {
-            Syntax *then_block = stack_pop(syntax_stack);
-            Syntax *condition = stack_pop(syntax_stack);
-            stack_push(syntax_stack, if_new(condition, then_block, NULL));
+            $$ = if_new(compilation->arena, $3, $6, NULL);
         }
         |
         IF LB expression RB OPEN_BRACE block_stmt CLOSE_BRACE ELSE OPEN_BRACE block_stmt CLOSE_BRACE
         {
-            Syntax *else_block = stack_pop(syntax_stack);
-            Syntax *then_block = stack_pop(syntax_stack);
-            Syntax *condition = stack_pop(syntax_stack);
-            stack_push(syntax_stack, if_new(condition, then_block, else_block));
+            $$ = if_new(compilation->arena, $3, $6, $10);
         }
         |
         TYPE IDENTIFIER ASN expression SEMICOLON
         {
-            Syntax *init_value = stack_pop(syntax_stack);
-            stack_push(syntax_stack, define_var_new($2, init_value));
-            free($2);
+            $$ = define_var_new(compilation->arena, $2, $4);
         }
         |
         TYPE IDENTIFIER LSB NUMBER RSB SEMICOLON
         {
-            Syntax *array_syntax = array_type_new(atoi($4));
-            stack_push(syntax_stack, define_var_new($2, array_syntax));
-            free($2);
-            free($4);
+            $$ = define_var_new(compilation->arena, $2, array_type_new(compilation->arena, $4));
         }
         |
         TYPE IDENTIFIER SEMICOLON
         {
-            stack_push(syntax_stack, define_var_new($2, immediate_new(0)));
-            free($2);
+            $$ = define_var_new(compilation->arena, $2, immediate_new(compilation->arena, 0));
         }
         |
         array_assignment SEMICOLON
         {
-            // Array assignment statement
+            $$ = $1;
         }
         |
         expression SEMICOLON
         {
-            // Expression statement
+            $$ = $1;
         }
         ;
 
 array_assignment:
         IDENTIFIER LSB expression RSB ASN expression
         {
-            Syntax *value = stack_pop(syntax_stack);
-            Syntax *index = stack_pop(syntax_stack);
-            stack_push(syntax_stack, array_assignment_new($1, index, value));
-            free($1);
+            $$ = array_assignment_new(compilation->arena, $1, $3, $6);
         }
         ;
 
 expression:
         NUMBER
         {
-            stack_push(syntax_stack, immediate_new(atoi($1)));
-            free($1);
+            $$ = immediate_new(compilation->arena, $1);
         }
         |
         IDENTIFIER
         {
-            stack_push(syntax_stack, variable_new($1));
-            free($1);
+            $$ = variable_new(compilation->arena, $1);
         }
         |
         IDENTIFIER ASN expression
         {
-            Syntax *expr = stack_pop(syntax_stack);
-            stack_push(syntax_stack, assignment_new($1, expr));
-            free($1);
+            $$ = assignment_new(compilation->arena, $1, $3);
         }
         |
         array_access
         {
-            // Array access expression
+            $$ = $1;
         }
         |
         LB expression RB
         {
-            // Parenthesized expression
+            $$ = $2;
         }
         |
         MINUS expression %prec LN
         {
-            Syntax *expr = stack_pop(syntax_stack);
-            stack_push(syntax_stack, negation_new(expr));
+            $$ = negation_new(compilation->arena, $2);
         }
         |
         NT expression %prec LN
         {
-            Syntax *expr = stack_pop(syntax_stack);
-            stack_push(syntax_stack, bitwise_negation_new(expr));
+            $$ = bitwise_negation_new(compilation->arena, $2);
         }
         |
         LN expression %prec LN
         {
-            Syntax *expr = stack_pop(syntax_stack);
-            stack_push(syntax_stack, logical_negation_new(expr));
+            $$ = logical_negation_new(compilation->arena, $2);
         }
         |
         expression PLUS expression
         {
-            Syntax *right = stack_pop(syntax_stack);
-            Syntax *left = stack_pop(syntax_stack);
-            stack_push(syntax_stack, addition_new(left, right));
+            $$ = addition_new(compilation->arena, $1, $3);
         }
         |
         expression MINUS expression
         {
-            Syntax *right = stack_pop(syntax_stack);
-            Syntax *left = stack_pop(syntax_stack);
-            stack_push(syntax_stack, subtraction_new(left, right));
+            $$ = subtraction_new(compilation->arena, $1, $3);
         }
         |
         expression MULT expression
         {
-            Syntax *right = stack_pop(syntax_stack);
-            Syntax *left = stack_pop(syntax_stack);
-            stack_push(syntax_stack, multiplication_new(left, right));
+            $$ = multiplication_new(compilation->arena, $1, $3);
         }
         |
         expression GRT expression
         {
-            Syntax *right = stack_pop(syntax_stack);
-            Syntax *left = stack_pop(syntax_stack);
-            stack_push(syntax_stack, greater_new(left, right));
+            $$ = greater_new(compilation->arena, $1, $3);
         }
         |
         expression LST expression
         {
-            Syntax *right = stack_pop(syntax_stack);
-            Syntax *left = stack_pop(syntax_stack);
-            stack_push(syntax_stack, less_new(left, right));
+            $$ = less_new(compilation->arena, $1, $3);
         }
         |
         expression AD expression
         {
-            Syntax *right = stack_pop(syntax_stack);
-            Syntax *left = stack_pop(syntax_stack);
-            stack_push(syntax_stack, and_new(left, right));
+            $$ = and_new(compilation->arena, $1, $3);
         }
         |
         expression ORR expression
         {
-            Syntax *right = stack_pop(syntax_stack);
-            Syntax *left = stack_pop(syntax_stack);
-            stack_push(syntax_stack, or_new(left, right));
+            $$ = or_new(compilation->arena, $1, $3);
         }
         |
         expression EQ expression
         {
-            Syntax *right = stack_pop(syntax_stack);
-            Syntax *left = stack_pop(syntax_stack);
-            stack_push(syntax_stack, equals_new(left, right));
+            $$ = equals_new(compilation->arena, $1, $3);
         }
         |
         expression GT_EQ expression
         {
-            Syntax *right = stack_pop(syntax_stack);
-            Syntax *left = stack_pop(syntax_stack);
-            stack_push(syntax_stack, greater_equals_new(left, right));
+            $$ = greater_equals_new(compilation->arena, $1, $3);
         }
         |
         expression LT_EQ expression
         {
-            Syntax *right = stack_pop(syntax_stack);
-            Syntax *left = stack_pop(syntax_stack);
-            stack_push(syntax_stack, less_equals_new(left, right));
+            $$ = less_equals_new(compilation->arena, $1, $3);
         }
         |
         IDENTIFIER LB argument_list RB
         {
-            Syntax *args = stack_pop(syntax_stack);
-            stack_push(syntax_stack, function_call_new($1, args));
-            free($1);
+            $$ = function_call_new(compilation->arena, $1, $3);
         }
         ;
 
 array_access:
         IDENTIFIER LSB expression RSB
         {
-            Syntax *index = stack_pop(syntax_stack);
-            stack_push(syntax_stack, array_expression_new($1, index));
-            free($1);
+            $$ = array_expression_new(compilation->arena, $1, $3);
         }
         ;
 
-%%
\ No newline at end of file
+%%
+
+static int yylex(YYSTYPE *value, Compilation *compilation) {
+    return lexer_next(&compilation->lexer, value);
+}
+
+static void yyerror(Compilation *compilation, const char *str) {
+    lexer_report(&compilation->lexer, str);
+}
@@ -0,0 +1,327 @@
+#include <stdlib.h>
+#include <limits.h>
+#include "eval.h"
+#include "vector.h"
+#include "walk.h"
+
+#define EVAL_FUEL 10000 // Nodes one call may evaluate before it is left for run time
+#define EVAL_DEPTH 256 // Calls that may be nested
+#define EVAL_ARRAY_LIMIT 4096 // Elements in the largest array it may create
+
+/* A variable of a call being evaluated. Values are 64 bits wide, as in
+ * the generated code.
+ */
+typedef struct Binding {
+    Symbol *symbol;
+    long value;
+    long *elements; // For an array, else NULL
+    int length;
+    int owned; // The elements belong to this binding, not to a caller's
+} Binding;
+
+typedef struct Evaluator {
+    SymbolTable *functions;
+    Vector bindings; // Of Binding, the innermost call's last
+    size_t frame; // Where the innermost call's bindings begin
+    long fuel;
+    int depth;
+} Evaluator;
+
+typedef enum {
+    EVAL_NEXT,
+    EVAL_RETURNED,
+    EVAL_FAILED
+} EvalStatus;
+
+/* Arithmetic wraps around, as it does in the generated code. */
+static long wrap(unsigned long value) {
+    return (long)value;
+}
+
+/* The binding of a variable in the innermost call. Each declaration runs
+ * at most once per call, and a name cannot be redeclared while it is
+ * visible, so the latest binding with a name is the one in scope.
+ */
+static Binding *find_binding(Evaluator *evaluator, Symbol *symbol, Name name) {
+    for (size_t i = vector_length(&evaluator->bindings); i > evaluator->frame; i--) {
+        Binding *binding = vector_at(&evaluator->bindings, i - 1);
+        if (symbol ? binding->symbol == symbol : binding->symbol->name == name) {
+            return binding;
+        }
+    }
+    return NULL;
+}
+
+static void pop_bindings(Evaluator *evaluator, size_t length) {
+    while (vector_length(&evaluator->bindings) > length) {
+        Binding binding;
+        vector_pop_back(&evaluator->bindings, &binding);
+        if (binding.owned) {
+            free(binding.elements);
+        }
+    }
+}
+
+static int eval_expression(Evaluator *evaluator, Syntax *syntax, long *value);
+static EvalStatus eval_statement(Evaluator *evaluator, Syntax *syntax, long *result);
+
+static int eval_call(Evaluator *evaluator, Syntax *call, long *value) {
+    Symbol *function = symbol_table_lookup(evaluator->functions, call->function_call.function_name, 0);
+    if (!function || !function->is_function || !function->pure || !function->definition
+        || evaluator->depth >= EVAL_DEPTH) {
+        return 0;
+    }
+    Syntax *definition = function->definition;
+    Syntax *arguments = call->function_call.function_arguments;
+    int count = arguments ? list_length(arguments->function_arguments.arguments) : 0;
+    int parameter_count = definition->function.parameters
+        ? list_length(definition->function.parameters->function_arguments.arguments) : 0;
+    if (count != parameter_count) {
+        return 0;
+    }
+
+    // Evaluate every argument in the caller before binding any parameter,
+    // as a recursive call binds the same symbols again.
+    Binding *bound = malloc((count > 0 ? count : 1) * sizeof(Binding));
+    int ok = 1;
+    for (int i = 0; ok && i < count; i++) {
+        Syntax *argument = list_get(arguments->function_arguments.arguments, i);
+        Syntax *parameter = list_get(definition->function.parameters->function_arguments.arguments, i);
+        bound[i].symbol = parameter->define_var_statement.symbol;
+        bound[i].elements = NULL;
+        bound[i].length = 0;
+        bound[i].owned = 0;
+        if (bound[i].symbol == NULL) {
+            ok = 0;
+        } else if (bound[i].symbol->type == TYPE_ARRAY) {
+            // A pure function only reads the arrays it is passed, so it
+            // may share the caller's.
+            Binding *array = argument->type == VARIABLE
+                ? find_binding(evaluator, argument->variable.symbol, NULL) : NULL;
+            if (array == NULL || array->elements == NULL) {
+                ok = 0;
+            } else {
+                bound[i].elements = array->elements;
+                bound[i].length = array->length;
+            }
+        } else {
+            ok = eval_expression(evaluator, argument, &bound[i].value);
+        }
+    }
+
+    EvalStatus status = EVAL_FAILED;
+    if (ok) {
+        size_t base = vector_length(&evaluator->bindings);
+        for (int i = 0; i < count; i++) {
+            vector_push_back(&evaluator->bindings, &bound[i]);
+        }
+        size_t frame = evaluator->frame;
+        evaluator->frame = base;
+        evaluator->depth++;
+        status = eval_statement(evaluator, definition->function.root_block, value);
+        evaluator->depth--;
+        evaluator->frame = frame;
+        pop_bindings(evaluator, base);
+    }
+    free(bound);
+    return status == EVAL_RETURNED;
+}
+
+static int eval_expression(Evaluator *evaluator, Syntax *syntax, long *value) {
+    if (syntax == NULL || --evaluator->fuel < 0) {
+        return 0;
+    }
+
+    switch (syntax->type) {
+        case IMMEDIATE:
+            *value = syntax->immediate.value;
+            return 1;
+        case VARIABLE: {
+            Binding *binding = find_binding(evaluator, syntax->variable.symbol, NULL);
+            if (binding == NULL || binding->elements != NULL) {
+                return 0;
+            }
+            *value = binding->value;
+            return 1;
+        }
+        case ARRAY_ACCESS: {
+            // A call in the index may grow the bindings, so look up the
+            // array only once it is evaluated.
+            long index;
+            if (!eval_expression(evaluator, syntax->array_access.index, &index)) {
+                return 0;
+            }
+            Binding *binding = find_binding(evaluator, syntax->array_access.symbol, NULL);
+            if (binding == NULL || binding->elements == NULL || index < 0 || index >= binding->length) {
+                return 0;
+            }
+            *value = binding->elements[index];
+            return 1;
+        }
+        case UNARY_OPERATOR: {
+            long operand;
+            if (!eval_expression(evaluator, syntax->unary_expression.expression, &operand)) {
+                return 0;
+            }
+            switch (syntax->unary_expression.unary_type) {
+                case NEGATION: *value = wrap(-(unsigned long)operand); break;
+                case BITWISE_NEGATION: *value = ~operand; break;
+                case LOGICAL_NEGATION: *value = operand == 0; break;
+            }
+            return 1;
+        }
+        case BINARY_OPERATOR: {
+            long left, right;
+            if (!eval_expression(evaluator, syntax->binary_expression.left, &left)
+                || !eval_expression(evaluator, syntax->binary_expression.right, &right)) {
+                return 0;
+            }
+            switch (syntax->binary_expression.binary_type) {
+                case ADDITION: *value = wrap((unsigned long)left + (unsigned long)right); break;
+                case SUBTRACTION: *value = wrap((unsigned long)left - (unsigned long)right); break;
+                case MULTIPLICATION: *value = wrap((unsigned long)left * (unsigned long)right); break;
+                case GREATER: *value = left > right; break;
+                case LESS: *value = left < right; break;
+                case AND: *value = left & right; break;
+                case OR: *value = left | right; break;
+                case EQUALS: *value = left == right; break;
+                case GREATER_EQUALS: *value = left >= right; break;
+                case LESS_EQUALS: *value = left <= right; break;
+            }
+            return 1;
+        }
+        case FUNCTION_CALL:
+            return eval_call(evaluator, syntax, value);
+        default:
+            return 0;
+    }
+}
+
+static EvalStatus eval_define_var(Evaluator *evaluator, DefineVarStatement *define_var_statement) {
+    Binding binding = { define_var_statement->symbol, 0, NULL, 0, 0 };
+    if (binding.symbol == NULL) {
+        return EVAL_FAILED;
+    }
+    Syntax *init_value = define_var_statement->init_value;
+    if (init_value->type == ARRAY_TYPE) {
+        int length = init_value->immediate.value;
+        evaluator->fuel -= length;
+        if (length <= 0 || length > EVAL_ARRAY_LIMIT || evaluator->fuel < 0) {
+            return EVAL_FAILED;
+        }
+        binding.elements = calloc(length, sizeof(long));
+        binding.length = length;
+        binding.owned = 1;
+    } else if (!eval_expression(evaluator, init_value, &binding.value)) {
+        return EVAL_FAILED;
+    }
+    vector_push_back(&evaluator->bindings, &binding);
+    return EVAL_NEXT;
+}
+
+static EvalStatus eval_statement(Evaluator *evaluator, Syntax *syntax, long *result) {
+    if (syntax == NULL || --evaluator->fuel < 0) {
+        return EVAL_FAILED;
+    }
+
+    switch (syntax->type) {
+        case BLOCK: {
+            List *statements = syntax->block.statements;
+            for (int i = 0; i < list_length(statements); i++) {
+                EvalStatus status = eval_statement(evaluator, list_get(statements, i), result);
+                if (status != EVAL_NEXT) {
+                    return status;
+                }
+            }
+            return EVAL_NEXT;
+        }
+        case IF_STATEMENT: {
+            long condition;
+            if (!eval_expression(evaluator, syntax->if_statement.condition, &condition)) {
+                return EVAL_FAILED;
+            }
+            if (condition != 0) {
+                return eval_statement(evaluator, syntax->if_statement.then_stmts, result);
+            }
+            if (syntax->if_statement.else_stmts == NULL) {
+                return EVAL_NEXT;
+            }
+            return eval_statement(evaluator, syntax->if_statement.else_stmts, result);
+        }
+        case RETURN_STATEMENT:
+            if (!eval_expression(evaluator, syntax->return_statement.expression, result)) {
+                return EVAL_FAILED;
+            }
+            return EVAL_RETURNED;
+        case DEFINE_VAR:
+            return eval_define_var(evaluator, &syntax->define_var_statement);
+        case ASSIGNMENT: {
+            // As with array accesses, a call on the right may grow the
+            // bindings, so the binding is found after it.
+            long value;
+            if (!eval_expression(evaluator, syntax->assignment.expression, &value)) {
+                return EVAL_FAILED;
+            }
+            Binding *binding = find_binding(evaluator, syntax->assignment.symbol, NULL);
+            if (binding == NULL || binding->elements != NULL) {
+                return EVAL_FAILED;
+            }
+            binding->value = value;
+            return EVAL_NEXT;
+        }
+        case ARRAY_ASSIGNMENT: {
+            long index, value;
+            if (!eval_expression(evaluator, syntax->array_assignment.index, &index)
+                || !eval_expression(evaluator, syntax->array_assignment.value, &value)) {
+                return EVAL_FAILED;
+            }
+            Binding *binding = find_binding(evaluator, NULL, syntax->array_assignment.array_name);
+            if (binding == NULL || !binding->owned || index < 0 || index >= binding->length) {
+                return EVAL_FAILED;
+            }
+            binding->elements[index] = value;
+            return EVAL_NEXT;
+        }
+        case PRINT_STATEMENT:
+            return EVAL_FAILED;
+        default: {
+            // An expression statement, evaluated for nothing but its checks
+            long value;
+            return eval_expression(evaluator, syntax, &value) ? EVAL_NEXT : EVAL_FAILED;
+        }
+    }
+}
+
+/* Calls are folded from the innermost out, so a call whose arguments
+ * were themselves calls sees them as constants.
+ */
+static void fold_leave(Walker *walker, WalkFrame *frame) {
+    Evaluator *evaluator = walker->data;
+    Syntax *syntax = frame->node;
+    if (syntax->type != FUNCTION_CALL) {
+        return;
+    }
+
+    evaluator->fuel = EVAL_FUEL;
+    long value;
+    if (eval_call(evaluator, syntax, &value) && value >= INT_MIN && value <= INT_MAX) {
+        syntax->type = IMMEDIATE;
+        syntax->data_type = TYPE_INT;
+        syntax->immediate.value = (int)value;
+    }
+}
+
+void fold_pure_calls(SemanticAnalyzer *analyzer, Syntax *top_level) {
+    classify_functions(analyzer, top_level);
+
+    Evaluator evaluator;
+    evaluator.functions = analyzer->table;
+    vector_init(&evaluator.bindings, sizeof(Binding), NULL);
+    evaluator.frame = 0;
+    evaluator.fuel = 0;
+    evaluator.depth = 0;
+
+    Walker walker = { NULL, NULL, fold_leave, &evaluator };
+    walk_syntax(&walker, top_level);
+    vector_release(&evaluator.bindings);
+}
@@ -0,0 +1,13 @@
+#include "syntax.h"
+#include "semantic.h"
+
+#ifndef EVAL_HEADER
+#define EVAL_HEADER
+
+/* Evaluate calls to pure functions with constant arguments while
+ * compiling, replacing each such FUNCTION_CALL with the IMMEDIATE it
+ * returns. The tree must have been analyzed without errors.
+ */
+void fold_pure_calls(SemanticAnalyzer *analyzer, Syntax *top_level);
+
+#endif
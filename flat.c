@@ -0,0 +1,423 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include "flat.h"
+#include "walk.h"
+
+/* State used only while flattening: array capacities, and a map from
+ * each Name to its index in the names table.
+ */
+typedef struct FlatBuilder {
+    FlatSyntax *flat;
+    uint32_t node_capacity;
+    uint32_t edge_capacity;
+    uint32_t name_capacity;
+    Name *table;
+    uint32_t *table_index;
+    uint32_t table_size;
+} FlatBuilder;
+
+static void *grow(void *array, uint32_t *capacity, uint32_t needed, size_t item_size) {
+    if (needed <= *capacity) return array;
+    while (*capacity < needed) {
+        *capacity = *capacity ? *capacity * 2 : 64;
+    }
+    return realloc(array, *capacity * item_size);
+}
+
+static NodeIndex add_node(FlatBuilder *builder, SyntaxType kind, int operator_type, int32_t operand) {
+    FlatSyntax *flat = builder->flat;
+    NodeIndex node = flat->node_count++;
+    if (flat->node_count > builder->node_capacity) {
+        builder->node_capacity = builder->node_capacity ? builder->node_capacity * 2 : 64;
+        flat->kinds = realloc(flat->kinds, builder->node_capacity * sizeof(uint8_t));
+        flat->operators = realloc(flat->operators, builder->node_capacity * sizeof(uint8_t));
+        flat->operands = realloc(flat->operands, builder->node_capacity * sizeof(int32_t));
+        flat->first_child = realloc(flat->first_child, builder->node_capacity * sizeof(uint32_t));
+        flat->child_count = realloc(flat->child_count, builder->node_capacity * sizeof(uint32_t));
+    }
+    flat->kinds[node] = kind;
+    flat->operators[node] = operator_type;
+    flat->operands[node] = operand;
+    flat->first_child[node] = flat->edge_count;
+    flat->child_count[node] = 0;
+    return node;
+}
+
+/* Reserve a range of the children array for node's count children. */
+static void reserve_children(FlatBuilder *builder, NodeIndex node, uint32_t count) {
+    FlatSyntax *flat = builder->flat;
+    flat->first_child[node] = flat->edge_count;
+    flat->child_count[node] = count;
+    flat->edge_count += count;
+    flat->children = grow(flat->children, &builder->edge_capacity, flat->edge_count, sizeof(NodeIndex));
+}
+
+static int32_t name_index(FlatBuilder *builder, Name name) {
+    FlatSyntax *flat = builder->flat;
+    if ((flat->name_count + 1) * 2 > builder->table_size) {
+        uint32_t old_size = builder->table_size;
+        Name *old_table = builder->table;
+        uint32_t *old_index = builder->table_index;
+        builder->table_size = old_size ? old_size * 2 : 256;
+        builder->table = calloc(builder->table_size, sizeof(Name));
+        builder->table_index = malloc(builder->table_size * sizeof(uint32_t));
+        for (uint32_t i = 0; i < old_size; i++) {
+            if (old_table[i] == NULL) continue;
+            uint32_t slot = ((uintptr_t)old_table[i] * 0x9E3779B97F4A7C15ull >> 32) & (builder->table_size - 1);
+            while (builder->table[slot] != NULL) {
+                slot = (slot + 1) & (builder->table_size - 1);
+            }
+            builder->table[slot] = old_table[i];
+            builder->table_index[slot] = old_index[i];
+        }
+        free(old_table);
+        free(old_index);
+    }
+
+    // Names are interned, so the pointer itself is the key.
+    uint32_t slot = ((uintptr_t)name * 0x9E3779B97F4A7C15ull >> 32) & (builder->table_size - 1);
+    while (builder->table[slot] != NULL) {
+        if (builder->table[slot] == name) {
+            return builder->table_index[slot];
+        }
+        slot = (slot + 1) & (builder->table_size - 1);
+    }
+
+    flat->names = grow(flat->names, &builder->name_capacity, flat->name_count + 1, sizeof(Name));
+    flat->names[flat->name_count] = name;
+    builder->table[slot] = name;
+    builder->table_index[slot] = flat->name_count;
+    return flat->name_count++;
+}
+
+/* Adds each node as it is entered, so nodes are numbered in pre-order,
+ * and links it into the slot its parent reserved for it.
+ */
+static int flatten_enter(Walker *walker, WalkFrame *frame, WalkFrame *parent) {
+    FlatBuilder *builder = walker->data;
+    Syntax *syntax = frame->node;
+    int operator_type = 0;
+    int32_t operand = 0;
+
+    switch (syntax->type) {
+        case IMMEDIATE:
+        case ARRAY_TYPE:
+            operand = syntax->immediate.value;
+            break;
+        case VARIABLE:
+            operand = name_index(builder, syntax->variable.var_name);
+            break;
+        case UNARY_OPERATOR:
+            operator_type = syntax->unary_expression.unary_type;
+            break;
+        case BINARY_OPERATOR:
+            operator_type = syntax->binary_expression.binary_type;
+            break;
+        case FUNCTION_CALL:
+            operand = name_index(builder, syntax->function_call.function_name);
+            break;
+        case DEFINE_VAR:
+            operand = name_index(builder, syntax->define_var_statement.var_name);
+            break;
+        case FUNCTION:
+            operand = name_index(builder, syntax->function.name);
+            break;
+        case ASSIGNMENT:
+            operand = name_index(builder, syntax->assignment.var_name);
+            break;
+        case ARRAY_ACCESS:
+            operand = name_index(builder, syntax->array_access.array_name);
+            break;
+        case ARRAY_ASSIGNMENT:
+            operand = name_index(builder, syntax->array_assignment.array_name);
+            break;
+        default:
+            break;
+    }
+
+    FlatSyntax *flat = builder->flat;
+    NodeIndex node = add_node(builder, syntax->type, operator_type, operand);
+    uint32_t count = syntax_child_count(syntax);
+    reserve_children(builder, node, count);
+    // Empty slots stay FLAT_NONE; the others are filled in as they are entered.
+    for (uint32_t i = 0; i < count; i++) {
+        flat->children[flat->first_child[node] + i] = FLAT_NONE;
+    }
+    if (parent != NULL) {
+        flat->children[flat->first_child[parent->value] + parent->child] = node;
+    }
+    frame->value = node;
+    return 1;
+}
+
+/* Copy a tree into flat form. The tree is not modified and may be freed
+ * afterwards; the names it refers to are interned and stay valid.
+ */
+FlatSyntax *flat_syntax_build(Syntax *root) {
+    FlatSyntax *flat = calloc(1, sizeof(FlatSyntax));
+    FlatBuilder builder = { flat, 0, 0, 0, NULL, NULL, 0 };
+    Walker walker = { flatten_enter, NULL, NULL, &builder };
+    walk_syntax(&walker, root);
+    free(builder.table);
+    free(builder.table_index);
+    return flat;
+}
+
+static Syntax *expand_unary(Arena *arena, UnaryExpressionType type, Syntax *expression) {
+    switch (type) {
+        case NEGATION: return negation_new(arena, expression);
+        case BITWISE_NEGATION: return bitwise_negation_new(arena, expression);
+        case LOGICAL_NEGATION: return logical_negation_new(arena, expression);
+    }
+    return NULL;
+}
+
+static Syntax *expand_binary(Arena *arena, BinaryExpressionType type, Syntax *left, Syntax *right) {
+    switch (type) {
+        case ADDITION: return addition_new(arena, left, right);
+        case SUBTRACTION: return subtraction_new(arena, left, right);
+        case MULTIPLICATION: return multiplication_new(arena, left, right);
+        case GREATER: return greater_new(arena, left, right);
+        case LESS: return less_new(arena, left, right);
+        case AND: return and_new(arena, left, right);
+        case OR: return or_new(arena, left, right);
+        case EQUALS: return equals_new(arena, left, right);
+        case GREATER_EQUALS: return greater_equals_new(arena, left, right);
+        case LESS_EQUALS: return less_equals_new(arena, left, right);
+    }
+    return NULL;
+}
+
+/* Build a pointer tree in arena from a flat one; the inverse of
+ * flat_syntax_build(). Every child is numbered after its parent, so
+ * building the nodes from last to first finds each node's children
+ * already built.
+ */
+Syntax *flat_syntax_expand(const FlatSyntax *flat, Arena *arena) {
+    if (flat->node_count == 0) return NULL;
+
+    Syntax **built = malloc(flat->node_count * sizeof(Syntax *));
+    for (NodeIndex node = flat->node_count; node-- > 0;) {
+        uint32_t count = flat_child_count(flat, node);
+        Syntax *children[3] = { NULL, NULL, NULL };
+        for (uint32_t i = 0; i < count && i < 3; i++) {
+            NodeIndex child = flat_child(flat, node, i);
+            children[i] = child == FLAT_NONE ? NULL : built[child];
+        }
+
+        Syntax *syntax = NULL;
+        List *list = NULL;
+        switch (flat_kind(flat, node)) {
+            case IMMEDIATE:
+                syntax = immediate_new(arena, flat_value(flat, node));
+                break;
+            case ARRAY_TYPE:
+                syntax = array_type_new(arena, flat_value(flat, node));
+                break;
+            case VARIABLE:
+                syntax = variable_new(arena, flat_name(flat, node));
+                break;
+            case UNARY_OPERATOR:
+                syntax = expand_unary(arena, flat_operator(flat, node), children[0]);
+                break;
+            case BINARY_OPERATOR:
+                syntax = expand_binary(arena, flat_operator(flat, node), children[0], children[1]);
+                break;
+            case FUNCTION_CALL:
+                syntax = function_call_new(arena, flat_name(flat, node), children[0]);
+                break;
+            case FUNCTION_ARGUMENTS:
+                syntax = function_arguments_new(arena);
+                list = syntax->function_arguments.arguments;
+                break;
+            case IF_STATEMENT:
+                syntax = if_new(arena, children[0], children[1], children[2]);
+                break;
+            case RETURN_STATEMENT:
+                syntax = return_statement_new(arena, children[0]);
+                break;
+            case PRINT_STATEMENT:
+                syntax = print_statement_new(arena, children[0]);
+                break;
+            case DEFINE_VAR:
+                syntax = define_var_new(arena, flat_name(flat, node), children[0]);
+                break;
+            case BLOCK:
+                syntax = block_new(arena);
+                list = syntax->block.statements;
+                break;
+            case FUNCTION:
+                syntax = function_new(arena, flat_name(flat, node), children[0], children[1]);
+                break;
+            case ASSIGNMENT:
+                syntax = assignment_new(arena, flat_name(flat, node), children[0]);
+                break;
+            case TOP_LEVEL:
+                syntax = top_level_new(arena);
+                list = syntax->top_level.declarations;
+                break;
+            case ARRAY_ACCESS:
+                syntax = array_expression_new(arena, flat_name(flat, node), children[0]);
+                break;
+            case ARRAY_ASSIGNMENT:
+                syntax = array_assignment_new(arena, flat_name(flat, node), children[0], children[1]);
+                break;
+        }
+
+        if (list != NULL) {
+            FlatCursor cursor = flat_children(flat, node);
+            NodeIndex child;
+            while (flat_cursor_next(&cursor, &child)) {
+                list_append(list, built[child]);
+            }
+        }
+        built[node] = syntax;
+    }
+
+    Syntax *root = built[0];
+    free(built);
+    return root;
+}
+
+void flat_syntax_free(FlatSyntax *flat) {
+    if (flat == NULL) return;
+    free(flat->kinds);
+    free(flat->operators);
+    free(flat->operands);
+    free(flat->first_child);
+    free(flat->child_count);
+    free(flat->children);
+    free(flat->names);
+    free(flat);
+}
+
+/* Bytes used by the arrays, not counting spare capacity. */
+size_t flat_syntax_size(const FlatSyntax *flat) {
+    return flat->node_count * (2 * sizeof(uint8_t) + sizeof(int32_t) + 2 * sizeof(uint32_t))
+        + flat->edge_count * sizeof(NodeIndex)
+        + flat->name_count * sizeof(Name);
+}
+
+static void print_indent(int indent) {
+    for (int i = 0; i < indent; i++) {
+        printf(" ");
+    }
+}
+
+/* A node being printed, and the next of its children to print. */
+typedef struct PrintFrame {
+    NodeIndex node;
+    int indent;
+    uint32_t child;
+} PrintFrame;
+
+static void print_flat_header(const FlatSyntax *flat, NodeIndex node, int indent) {
+    print_indent(indent);
+
+    SyntaxType kind = flat_kind(flat, node);
+    char *syntax_type_string = syntax_kind_name(kind, flat_operator(flat, node));
+
+    switch (kind) {
+        case IMMEDIATE:
+            printf("%s %d\n", syntax_type_string, flat_value(flat, node));
+            break;
+        case VARIABLE:
+        case FUNCTION_CALL:
+        case FUNCTION:
+        case ASSIGNMENT:
+        case ARRAY_ACCESS:
+        case ARRAY_ASSIGNMENT:
+            printf("%s '%s'\n", syntax_type_string, flat_name(flat, node));
+            break;
+        case UNARY_OPERATOR:
+        case FUNCTION_ARGUMENTS:
+        case BLOCK:
+        case TOP_LEVEL:
+        case RETURN_STATEMENT:
+        case PRINT_STATEMENT:
+            printf("%s\n", syntax_type_string);
+            break;
+        case BINARY_OPERATOR:
+            printf("%s LEFT\n", syntax_type_string);
+            break;
+        case IF_STATEMENT:
+            printf("%s CONDITION\n", syntax_type_string);
+            break;
+        case DEFINE_VAR:
+            printf("%s '%s'\n", syntax_type_string, flat_name(flat, node));
+            print_indent(indent);
+            printf("'%s' INITIAL VALUE\n", flat_name(flat, node));
+            break;
+        case ARRAY_TYPE:
+            printf("%s SIZE %d\n", syntax_type_string, flat_value(flat, node));
+            break;
+        default:
+            printf("??? UNKNOWN SYNTAX TYPE\n");
+            break;
+    }
+}
+
+/* Prints the label, if any, that comes before child i of node. */
+static void print_flat_label(const FlatSyntax *flat, NodeIndex node, int indent, uint32_t i) {
+    SyntaxType kind = flat_kind(flat, node);
+    char *syntax_type_string = syntax_kind_name(kind, flat_operator(flat, node));
+    NodeIndex child = flat_child(flat, node, i);
+
+    if (kind == BINARY_OPERATOR && i == 1) {
+        print_indent(indent);
+        printf("%s RIGHT\n", syntax_type_string);
+    } else if (kind == IF_STATEMENT && i == 1) {
+        print_indent(indent);
+        printf("%s THEN\n", syntax_type_string);
+    } else if (kind == IF_STATEMENT && i == 2 && child != FLAT_NONE) {
+        print_indent(indent);
+        printf("%s ELSE\n", syntax_type_string);
+    } else if (kind == FUNCTION && i == 0 && child != FLAT_NONE) {
+        print_indent(indent);
+        printf("PARAMETERS\n");
+    } else if (kind == ARRAY_ASSIGNMENT) {
+        print_indent(indent);
+        printf(i == 0 ? "INDEX\n" : "VALUE\n");
+    }
+}
+
+static void print_flat_indented(const FlatSyntax *flat, NodeIndex root, int indent) {
+    uint32_t capacity = 64;
+    PrintFrame *frames = malloc(capacity * sizeof(PrintFrame));
+    uint32_t depth = 0;
+
+    frames[depth++] = (PrintFrame){ root, indent, 0 };
+    print_flat_header(flat, root, indent);
+
+    while (depth > 0) {
+        PrintFrame *top = &frames[depth - 1];
+        if (top->child == flat_child_count(flat, top->node)) {
+            depth--;
+            continue;
+        }
+
+        uint32_t i = top->child++;
+        print_flat_label(flat, top->node, top->indent, i);
+        NodeIndex child = flat_child(flat, top->node, i);
+        if (child == FLAT_NONE) continue;
+
+        // Call arguments are printed at the level of the call.
+        int child_indent = flat_kind(flat, top->node) == FUNCTION_CALL ? top->indent : top->indent + 4;
+        if (depth == capacity) {
+            capacity *= 2;
+            frames = realloc(frames, capacity * sizeof(PrintFrame));
+        }
+        frames[depth++] = (PrintFrame){ child, child_indent, 0 };
+        print_flat_header(flat, child, child_indent);
+    }
+
+    free(frames);
+}
+
+/* Prints the same text as print_syntax() on the tree it was built from. */
+void print_flat_syntax(const FlatSyntax *flat) {
+    if (flat->node_count > 0) {
+        print_flat_indented(flat, 0, 0);
+    }
+}
@@ -0,0 +1,100 @@
+#include <stdint.h>
+#include "syntax.h"
+
+#ifndef FLAT_HEADER
+#define FLAT_HEADER
+
+/* A syntax tree stored as parallel arrays indexed by node number, rather
+ * than as nodes linked by pointers. A node's children are a contiguous
+ * range of the shared children array, in the order listed below, so a
+ * traversal walks a few dense arrays instead of chasing pointers.
+ *
+ *   IMMEDIATE, ARRAY_TYPE   no children, value in operands
+ *   VARIABLE                no children, name in operands
+ *   UNARY_OPERATOR          expression
+ *   BINARY_OPERATOR         left, right
+ *   FUNCTION_CALL           arguments; name
+ *   FUNCTION_ARGUMENTS      each argument
+ *   IF_STATEMENT            condition, then, else (or FLAT_NONE)
+ *   RETURN_STATEMENT        expression (or FLAT_NONE)
+ *   PRINT_STATEMENT         expression
+ *   DEFINE_VAR              initial value; name
+ *   BLOCK                   each statement
+ *   FUNCTION                parameters, body (either may be FLAT_NONE); name
+ *   ASSIGNMENT              expression; name
+ *   TOP_LEVEL               each declaration
+ *   ARRAY_ACCESS            index; name
+ *   ARRAY_ASSIGNMENT        index, value; name
+ *
+ * The root is node 0. Names are stored once each in the names table.
+ */
+
+typedef uint32_t NodeIndex;
+
+#define FLAT_NONE UINT32_MAX
+
+typedef struct FlatSyntax {
+    uint32_t node_count;
+    uint8_t *kinds; // SyntaxType
+    uint8_t *operators; // UnaryExpressionType or BinaryExpressionType
+    int32_t *operands; // A value, or an index into names
+    uint32_t *first_child; // Index into children
+    uint32_t *child_count;
+
+    uint32_t edge_count;
+    NodeIndex *children;
+
+    uint32_t name_count;
+    Name *names;
+} FlatSyntax;
+
+/* Iterates over the children of one node. */
+typedef struct FlatCursor {
+    const NodeIndex *next;
+    const NodeIndex *end;
+} FlatCursor;
+
+FlatSyntax *flat_syntax_build(Syntax *root);
+Syntax *flat_syntax_expand(const FlatSyntax *flat, Arena *arena);
+void flat_syntax_free(FlatSyntax *flat);
+size_t flat_syntax_size(const FlatSyntax *flat);
+void print_flat_syntax(const FlatSyntax *flat);
+
+static inline SyntaxType flat_kind(const FlatSyntax *flat, NodeIndex node) {
+    return (SyntaxType)flat->kinds[node];
+}
+
+static inline int flat_operator(const FlatSyntax *flat, NodeIndex node) {
+    return flat->operators[node];
+}
+
+static inline int flat_value(const FlatSyntax *flat, NodeIndex node) {
+    return flat->operands[node];
+}
+
+static inline Name flat_name(const FlatSyntax *flat, NodeIndex node) {
+    return flat->names[flat->operands[node]];
+}
+
+static inline uint32_t flat_child_count(const FlatSyntax *flat, NodeIndex node) {
+    return flat->child_count[node];
+}
+
+static inline NodeIndex flat_child(const FlatSyntax *flat, NodeIndex node, uint32_t i) {
+    return flat->children[flat->first_child[node] + i];
+}
+
+static inline FlatCursor flat_children(const FlatSyntax *flat, NodeIndex node) {
+    const NodeIndex *first = flat->children + flat->first_child[node];
+    FlatCursor cursor = { first, first + flat->child_count[node] };
+    return cursor;
+}
+
+/* Stores the next child in *child and returns 1, or returns 0 at the end. */
+static inline int flat_cursor_next(FlatCursor *cursor, NodeIndex *child) {
+    if (cursor->next == cursor->end) return 0;
+    *child = *cursor->next++;
+    return 1;
+}
+
+#endif
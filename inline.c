@@ -0,0 +1,299 @@
+#include <stdlib.h>
+#include <string.h>
+#include "inline.h"
+
+/* What a call costs beyond the callee's body: moving the arguments, the
+ * branch and return, and the frame set up and torn down.
+ */
+static const int CALL_COST = 6;
+
+/* A constant argument is likely to fold away much of what uses it. */
+static const int CONSTANT_ARGUMENT_BONUS = 4;
+
+/* The instructions a copy of function would add; its parameters become
+ * the arguments and take none.
+ */
+static int body_size(IrFunction *function) {
+    int size = 0;
+    for (int b = 0; b < function->block_count; b++) {
+        IrBlock *block = &function->blocks[b];
+        for (int i = 0; i < block->count; i++) {
+            size += block->instructions[i].opcode != IR_PARAM;
+        }
+    }
+    return size;
+}
+
+typedef struct Inliner {
+    CallGraph *graph;
+    int caller;
+    IrFunction *function; // The caller
+    int limit;
+    int *sizes; // Of each function, its body_size(), or -1 until needed
+    char *is_constant; // Of each of the caller's registers, as they were
+    int registers; // The caller's, before inlining
+    int *map; // Registers replaced by others
+    int map_capacity;
+} Inliner;
+
+/* The function a call should be replaced with a copy of, or IR_NONE.
+ * Recursion is left alone: a function calling back into its own
+ * component is never inlined there, so no body is copied into itself.
+ */
+static int callee_to_inline(Inliner *inliner, IrCall *call) {
+    CallGraph *graph = inliner->graph;
+    int callee = call_graph_find(graph, call->callee);
+    if (callee == IR_NONE || graph->component[callee] == graph->component[inliner->caller]) {
+        return IR_NONE;
+    }
+    IrFunction *function = graph->program->functions[callee];
+    if (function->parameter_count != call->argument_count) {
+        return IR_NONE;
+    }
+    if (inliner->sizes[callee] < 0) {
+        inliner->sizes[callee] = body_size(function);
+    }
+    int benefit = CALL_COST + call->argument_count;
+    for (int i = 0; i < call->argument_count; i++) {
+        int argument = call->arguments[i];
+        if (argument < inliner->registers && inliner->is_constant[argument]) {
+            benefit += CONSTANT_ARGUMENT_BONUS;
+        }
+    }
+    return inliner->sizes[callee] - benefit <= inliner->limit ? callee : IR_NONE;
+}
+
+/* Extend the map over the caller's next count registers. */
+static void map_registers(Inliner *inliner, int count) {
+    IrFunction *function = inliner->function;
+    if (function->register_count + count > inliner->map_capacity) {
+        while (function->register_count + count > inliner->map_capacity) inliner->map_capacity *= 2;
+        inliner->map = realloc(inliner->map, inliner->map_capacity * sizeof(int));
+    }
+    for (int r = function->register_count; r < function->register_count + count; r++) {
+        inliner->map[r] = r;
+    }
+}
+
+/* A copy of call whose arguments are renumbered by base. */
+static IrCall *copy_call(Arena *arena, IrCall *call, int base) {
+    IrCall *copy = arena_alloc(arena, sizeof(IrCall) + call->argument_count * sizeof(int));
+    copy->callee = call->callee;
+    copy->argument_count = call->argument_count;
+    for (int i = 0; i < copy->argument_count; i++) {
+        copy->arguments[i] = call->arguments[i] + base;
+    }
+    return copy;
+}
+
+/* Replace the call ending block with a copy of callee's blocks, whose
+ * registers, blocks and arrays are renumbered after the caller's own.
+ * Parameters become the arguments; each return jumps to a new block,
+ * where a phi picks the result if there are several. Returns that block,
+ * for the rest of the caller's block to follow.
+ */
+static int inline_call(Inliner *inliner, int block, IrInstruction *call_instruction, IrFunction *callee) {
+    IrFunction *function = inliner->function;
+    Arena *arena = inliner->graph->program->arena;
+    IrCall *call = call_instruction->call;
+
+    map_registers(inliner, callee->register_count);
+    int base = function->register_count;
+    function->register_count += callee->register_count;
+    int arrays = function->array_count;
+    for (int a = 0; a < callee->array_count; a++) {
+        ir_array_new(function, callee->arrays[a].name, callee->arrays[a].length);
+    }
+
+    int entry = function->block_count;
+    ir_append(function, block, IR_JUMP)->targets[0] = entry;
+    for (int b = 0; b < callee->block_count; b++) {
+        ir_block_new(function);
+    }
+    int after = ir_block_new(function);
+    ir_add_predecessor(function, entry, block);
+
+    int returns = 0, return_capacity = 0;
+    int *returned = NULL; // The result of each return, in the order of after's predecessors
+    for (int b = 0; b < callee->block_count; b++) {
+        IrBlock *from = &callee->blocks[b];
+        int to = entry + b;
+        for (int i = 0; i < from->predecessor_count; i++) {
+            ir_add_predecessor(function, to, entry + from->predecessors[i]);
+        }
+        for (int i = 0; i < from->count; i++) {
+            IrInstruction *source = &from->instructions[i];
+            if (source->opcode == IR_PARAM) {
+                inliner->map[base + source->dest] = call->arguments[source->immediate];
+                continue;
+            }
+            if (source->opcode == IR_RETURN || source->opcode == IR_TAIL_CALL) {
+                int value = source->operands[0];
+                if (source->opcode == IR_TAIL_CALL) {
+                    // Inside the caller it is an ordinary call, whose result is returned.
+                    map_registers(inliner, 1);
+                    value = ir_emit(function, to, IR_CALL, IR_NONE, IR_NONE);
+                    IrInstruction *inner = &function->blocks[to].instructions[function->blocks[to].count - 1];
+                    inner->call = copy_call(arena, source->call, base);
+                } else if (value == IR_NONE) {
+                    // Falling off the end leaves the result undefined.
+                    map_registers(inliner, 1);
+                    value = ir_emit(function, to, IR_CONST, IR_NONE, IR_NONE);
+                } else {
+                    value += base;
+                }
+                ir_append(function, to, IR_JUMP)->targets[0] = after;
+                ir_add_predecessor(function, after, to);
+                if (returns == return_capacity) {
+                    return_capacity = return_capacity > 0 ? return_capacity * 2 : 4;
+                    returned = realloc(returned, return_capacity * sizeof(int));
+                }
+                returned[returns++] = value;
+                continue;
+            }
+
+            IrInstruction *copy = ir_append(function, to, source->opcode);
+            *copy = *source;
+            if (copy->dest != IR_NONE) copy->dest += base;
+            for (int j = 0; j < ir_operand_count(copy->opcode); j++) {
+                if (copy->operands[j] != IR_NONE) copy->operands[j] += base;
+            }
+            switch (copy->opcode) {
+                case IR_LOAD:
+                case IR_STORE:
+                    copy->array += arrays;
+                    break;
+                case IR_BRANCH:
+                    copy->targets[1] += entry;
+                    // Fall through
+                case IR_JUMP:
+                    copy->targets[0] += entry;
+                    break;
+                case IR_CALL:
+                    copy->call = copy_call(arena, source->call, base);
+                    break;
+                case IR_PHI: {
+                    int *incoming = arena_alloc(arena, from->predecessor_count * sizeof(int));
+                    for (int j = 0; j < from->predecessor_count; j++) {
+                        incoming[j] = source->incoming[j] + base;
+                    }
+                    copy->incoming = incoming;
+                    break;
+                }
+                default:
+                    break;
+            }
+        }
+        ir_block_trim(function, to);
+    }
+
+    if (returns == 1) {
+        inliner->map[call_instruction->dest] = returned[0];
+    } else {
+        int *incoming = arena_alloc(arena, returns * sizeof(int));
+        memcpy(incoming, returned, returns * sizeof(int));
+        IrInstruction *phi = ir_append(function, after, IR_PHI);
+        phi->dest = call_instruction->dest;
+        phi->incoming = incoming;
+    }
+    free(returned);
+    return after;
+}
+
+/* Replace calls in the function numbered caller with copies of the
+ * callees whose size, less what the call costs and what constant
+ * arguments may fold, is within limit. Callees are copied as they are
+ * now, so inlining callees first carries their own inlining along. The
+ * blocks stay in an order where each follows its predecessors. sizes
+ * caches the size of each function, -1 until needed, for the calls to
+ * come; callers come after callees, so a size once found still holds.
+ * Returns how many calls were inlined.
+ */
+int inline_calls(CallGraph *graph, int caller, int limit, int *sizes) {
+    IrFunction *function = graph->program->functions[caller];
+    Inliner inliner;
+    inliner.graph = graph;
+    inliner.caller = caller;
+    inliner.function = function;
+    inliner.limit = limit;
+    inliner.sizes = sizes;
+    inliner.registers = function->register_count;
+    inliner.is_constant = calloc(function->register_count > 0 ? function->register_count : 1, 1);
+
+    int candidates = 0;
+    for (int b = 0; b < function->block_count; b++) {
+        IrBlock *block = &function->blocks[b];
+        for (int i = 0; i < block->count; i++) {
+            IrInstruction *instruction = &block->instructions[i];
+            if (instruction->opcode == IR_CONST) {
+                inliner.is_constant[instruction->dest] = 1;
+            } else if (instruction->opcode == IR_CALL) {
+                candidates += callee_to_inline(&inliner, instruction->call) != IR_NONE;
+            }
+        }
+    }
+    if (candidates == 0) {
+        free(inliner.is_constant);
+        return 0;
+    }
+
+    inliner.map_capacity = function->register_count > 0 ? function->register_count : 1;
+    inliner.map = ir_identity_map(function);
+
+    // Rebuild the blocks in order, splitting each at the calls inlined.
+    // The first piece of each block keeps its predecessors and the last
+    // its terminator, renumbered at the end.
+    IrBlock *old = function->blocks;
+    int old_count = function->block_count;
+    int *first = malloc(old_count * sizeof(int));
+    int *last = malloc(old_count * sizeof(int));
+    function->blocks = NULL;
+    function->block_count = 0;
+    function->block_capacity = 0;
+    int inlined = 0;
+    for (int b = 0; b < old_count; b++) {
+        IrBlock *source = &old[b];
+        int current = ir_block_new(function);
+        first[b] = current;
+        IrBlock *piece = &function->blocks[current];
+        piece->predecessors = source->predecessors;
+        piece->predecessor_count = source->predecessor_count;
+        piece->predecessor_capacity = source->predecessor_capacity;
+        for (int i = 0; i < source->count; i++) {
+            IrInstruction *instruction = &source->instructions[i];
+            int callee = instruction->opcode == IR_CALL ? callee_to_inline(&inliner, instruction->call) : IR_NONE;
+            if (callee != IR_NONE) {
+                current = inline_call(&inliner, current, instruction, graph->program->functions[callee]);
+                inlined++;
+            } else {
+                *ir_append(function, current, instruction->opcode) = *instruction;
+            }
+        }
+        ir_block_trim(function, current);
+        last[b] = current;
+        free(source->instructions);
+    }
+    free(old);
+
+    for (int b = 0; b < old_count; b++) {
+        IrBlock *piece = &function->blocks[first[b]];
+        for (int i = 0; i < piece->predecessor_count; i++) {
+            piece->predecessors[i] = last[piece->predecessors[i]];
+        }
+        piece = &function->blocks[last[b]];
+        IrInstruction *terminator = &piece->instructions[piece->count - 1];
+        if (terminator->opcode == IR_BRANCH) {
+            terminator->targets[1] = first[terminator->targets[1]];
+        }
+        if (terminator->opcode == IR_BRANCH || terminator->opcode == IR_JUMP) {
+            terminator->targets[0] = first[terminator->targets[0]];
+        }
+    }
+    ir_replace_registers(function, inliner.map);
+
+    free(first);
+    free(last);
+    free(inliner.map);
+    free(inliner.is_constant);
+    return inlined;
+}
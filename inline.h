@@ -0,0 +1,14 @@
+#include "ir.h"
+#include "callgraph.h"
+
+#ifndef INLINE_HEADER
+#define INLINE_HEADER
+
+/* The default -finline-limit: how many instructions a call may grow its
+ * caller by, after what inlining saves.
+ */
+#define DEFAULT_INLINE_LIMIT 16
+
+int inline_calls(CallGraph *graph, int caller, int limit, int *sizes);
+
+#endif
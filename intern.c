@@ -0,0 +1,102 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "intern.h"
+
+/* Interned strings live in large chunks that are never moved or freed,
+ * and an open-addressing table maps their contents back to them.
+ *
+ * The table is the one piece of state shared by every compilation in the
+ * process, so inserting takes a lock. Reading a Name never does: the
+ * characters behind it are immutable once interned.
+ */
+
+#define STRING_CHUNK_SIZE (64 * 1024)
+#define INITIAL_TABLE_SIZE 1024
+
+typedef struct InternEntry {
+    Name name;
+    uint32_t hash;
+} InternEntry;
+
+static pthread_mutex_t intern_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static InternEntry *table = NULL;
+static size_t table_size = 0;
+static size_t table_count = 0;
+
+static char *chunk = NULL;
+static size_t chunk_used = 0;
+static size_t chunk_size = 0;
+
+static uint32_t hash_text(const char *text, int length) {
+    uint32_t hash = 2166136261u;
+    for (int i = 0; i < length; i++) {
+        hash ^= (unsigned char)text[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static Name store_text(const char *text, int length) {
+    size_t needed = length + 1;
+    if (chunk == NULL || chunk_used + needed > chunk_size) {
+        chunk_size = needed > STRING_CHUNK_SIZE ? needed : STRING_CHUNK_SIZE;
+        chunk = malloc(chunk_size);
+        chunk_used = 0;
+    }
+    char *copy = chunk + chunk_used;
+    memcpy(copy, text, length);
+    copy[length] = '\0';
+    chunk_used += needed;
+    return copy;
+}
+
+static void grow_table(void) {
+    size_t new_size = table_size ? table_size * 2 : INITIAL_TABLE_SIZE;
+    InternEntry *new_table = calloc(new_size, sizeof(InternEntry));
+
+    for (size_t i = 0; i < table_size; i++) {
+        if (table[i].name == NULL) continue;
+        size_t slot = table[i].hash & (new_size - 1);
+        while (new_table[slot].name != NULL) {
+            slot = (slot + 1) & (new_size - 1);
+        }
+        new_table[slot] = table[i];
+    }
+
+    free(table);
+    table = new_table;
+    table_size = new_size;
+}
+
+Name intern(const char *text, int length) {
+    uint32_t hash = hash_text(text, length);
+
+    pthread_mutex_lock(&intern_lock);
+    if (table_count * 2 >= table_size) {
+        grow_table();
+    }
+
+    size_t slot = hash & (table_size - 1);
+    while (table[slot].name != NULL) {
+        InternEntry *entry = &table[slot];
+        if (entry->hash == hash && strncmp(entry->name, text, length) == 0 && entry->name[length] == '\0') {
+            pthread_mutex_unlock(&intern_lock);
+            return entry->name;
+        }
+        slot = (slot + 1) & (table_size - 1);
+    }
+
+    table[slot].name = store_text(text, length);
+    table[slot].hash = hash;
+    table_count++;
+    Name name = table[slot].name;
+    pthread_mutex_unlock(&intern_lock);
+    return name;
+}
+
+Name intern_string(const char *text) {
+    return intern(text, strlen(text));
+}
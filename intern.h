@@ -0,0 +1,13 @@
+#ifndef INTERN_HEADER
+#define INTERN_HEADER
+
+/* An interned identifier. Every distinct spelling is stored once for the
+ * lifetime of the compiler, so two Names are equal exactly when the
+ * pointers are equal, and a Name can be printed like any C string.
+ */
+typedef const char *Name;
+
+Name intern(const char *text, int length);
+Name intern_string(const char *text);
+
+#endif
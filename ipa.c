@@ -0,0 +1,258 @@
+#include <stdlib.h>
+#include <string.h>
+#include "ipa.h"
+
+/* The number of the program's main function, or IR_NONE. */
+static int find_main(IrProgram *program) {
+    for (int f = 0; f < program->function_count; f++) {
+        if (strcmp(program->functions[f]->name, "main") == 0) return f;
+    }
+    return IR_NONE;
+}
+
+/* Drop the functions main never calls, directly or not, keeping the
+ * rest in source order. Returns how many were dropped.
+ */
+int drop_unreachable_functions(IrProgram *program) {
+    int root = find_main(program);
+    if (root == IR_NONE) return 0;
+    CallGraph *graph = call_graph_new(program);
+    char *reachable = call_graph_reachable(graph, root);
+    call_graph_free(graph);
+
+    int kept = 0;
+    for (int f = 0; f < program->function_count; f++) {
+        if (reachable[f]) {
+            program->functions[kept++] = program->functions[f];
+        } else {
+            ir_function_free(program->functions[f]);
+        }
+    }
+    free(reachable);
+    int dropped = program->function_count - kept;
+    program->function_count = kept;
+    return dropped;
+}
+
+typedef enum {
+    ARGUMENT_UNKNOWN, // No call seen passes it anything yet
+    ARGUMENT_CONSTANT,
+    ARGUMENT_VARYING,
+} ArgumentState;
+
+/* What the calls of a function pass one of its parameters. */
+typedef struct Argument {
+    ArgumentState state;
+    long value; // When CONSTANT
+} Argument;
+
+/* Meet argument with what one more call passes, returning whether it
+ * changed.
+ */
+static int meet(Argument *argument, Argument passed) {
+    if (argument->state == ARGUMENT_VARYING || passed.state == ARGUMENT_UNKNOWN) return 0;
+    if (argument->state == ARGUMENT_CONSTANT && passed.state == ARGUMENT_CONSTANT && argument->value == passed.value) {
+        return 0;
+    }
+    argument->state = argument->state == ARGUMENT_UNKNOWN ? passed.state : ARGUMENT_VARYING;
+    argument->value = passed.value;
+    return 1;
+}
+
+/* Of each of a function's registers, the instruction defining it. */
+static IrInstruction **find_definitions(IrFunction *function) {
+    IrInstruction **definitions = calloc(function->register_count > 0 ? function->register_count : 1,
+                                         sizeof(IrInstruction *));
+    for (int b = 0; b < function->block_count; b++) {
+        IrBlock *block = &function->blocks[b];
+        for (int i = 0; i < block->count; i++) {
+            if (block->instructions[i].dest != IR_NONE) {
+                definitions[block->instructions[i].dest] = &block->instructions[i];
+            }
+        }
+    }
+    return definitions;
+}
+
+/* Turn the parameters that every call passes the same constant into
+ * that constant, for the callee's own passes to fold. A parameter passed
+ * on as an argument counts as what the caller is passed, and a function
+ * passing itself a parameter unchanged adds nothing new; until a call
+ * says otherwise, a parameter is assumed constant, so such cycles still
+ * find their constants. Returns how many parameters became constants.
+ */
+int propagate_constant_arguments(CallGraph *graph) {
+    IrProgram *program = graph->program;
+    int root = find_main(program);
+    if (root == IR_NONE) return 0;
+    int n = program->function_count;
+    int *first = malloc((n + 1) * sizeof(int)); // Function f's parameters are arguments[first[f]] up to first[f + 1]
+    first[0] = 0;
+    for (int f = 0; f < n; f++) {
+        first[f + 1] = first[f] + program->functions[f]->parameter_count;
+    }
+    Argument *arguments = calloc(first[n] > 0 ? first[n] : 1, sizeof(Argument));
+    for (int k = first[root]; k < first[root + 1]; k++) {
+        arguments[k].state = ARGUMENT_VARYING;
+    }
+
+    // Callers first, so one sweep mostly settles what a later one checks.
+    // Only calls of the program's own functions tell anything.
+    int changed = 1;
+    while (changed) {
+        changed = 0;
+        for (int i = n - 1; i >= 0; i--) {
+            int f = graph->order[i];
+            if (graph->first_callee[f] == graph->first_callee[f + 1]) continue;
+            IrFunction *function = program->functions[f];
+            IrInstruction **definitions = find_definitions(function);
+            for (int b = 0; b < function->block_count; b++) {
+                IrBlock *block = &function->blocks[b];
+                for (int j = 0; j < block->count; j++) {
+                    if (!ir_is_call(block->instructions[j].opcode)) continue;
+                    IrCall *call = block->instructions[j].call;
+                    int g = call_graph_find(graph, call->callee);
+                    if (g == IR_NONE) continue;
+                    int count = program->functions[g]->parameter_count;
+                    for (int k = 0; k < count; k++) {
+                        Argument passed = { ARGUMENT_VARYING, 0 };
+                        IrInstruction *definition = k < call->argument_count ? definitions[call->arguments[k]] : NULL;
+                        if (call->argument_count != count || definition == NULL) {
+                            // Passed nothing, or something undefined
+                        } else if (definition->opcode == IR_CONST) {
+                            passed.state = ARGUMENT_CONSTANT;
+                            passed.value = definition->immediate;
+                        } else if (definition->opcode == IR_PARAM) {
+                            if (g == f && definition->immediate == k) continue;
+                            passed = arguments[first[f] + definition->immediate];
+                        }
+                        changed |= meet(&arguments[first[g] + k], passed);
+                    }
+                }
+            }
+            free(definitions);
+        }
+    }
+
+    int replaced = 0;
+    for (int f = 0; f < n; f++) {
+        IrFunction *function = program->functions[f];
+        for (int b = 0; b < function->block_count; b++) {
+            IrBlock *block = &function->blocks[b];
+            for (int i = 0; i < block->count; i++) {
+                IrInstruction *instruction = &block->instructions[i];
+                if (instruction->opcode != IR_PARAM) continue;
+                Argument *argument = &arguments[first[f] + instruction->immediate];
+                if (argument->state == ARGUMENT_CONSTANT) {
+                    instruction->opcode = IR_CONST;
+                    instruction->immediate = argument->value;
+                    replaced++;
+                }
+            }
+        }
+    }
+    free(first);
+    free(arguments);
+    return replaced;
+}
+
+/* Of each of a function's registers, whether anything that must run
+ * reads it: calls, stores, prints and the control flow, and returns
+ * only if what the function returns is needed.
+ */
+static char *find_live(IrFunction *function, int returns) {
+    char *live = calloc(function->register_count > 0 ? function->register_count : 1, 1);
+    int changed = 1;
+    while (changed) {
+        changed = 0;
+        for (int b = function->block_count - 1; b >= 0; b--) {
+            IrBlock *block = &function->blocks[b];
+            for (int i = block->count - 1; i >= 0; i--) {
+                IrInstruction *instruction = &block->instructions[i];
+                if (instruction->dest != IR_NONE && instruction->opcode != IR_CALL && !live[instruction->dest]) {
+                    continue;
+                }
+                if (instruction->opcode == IR_RETURN && !returns) continue;
+                for (int j = 0; j < ir_operand_count(instruction->opcode); j++) {
+                    int operand = instruction->operands[j];
+                    if (operand != IR_NONE && !live[operand]) {
+                        live[operand] = 1;
+                        changed = 1;
+                    }
+                }
+                if (ir_is_call(instruction->opcode)) {
+                    for (int j = 0; j < instruction->call->argument_count; j++) {
+                        changed |= !live[instruction->call->arguments[j]];
+                        live[instruction->call->arguments[j]] = 1;
+                    }
+                } else if (instruction->opcode == IR_PHI) {
+                    for (int j = 0; j < block->predecessor_count; j++) {
+                        changed |= !live[instruction->incoming[j]];
+                        live[instruction->incoming[j]] = 1;
+                    }
+                }
+            }
+        }
+    }
+    return live;
+}
+
+/* Make the functions whose result no call uses return nothing, so that
+ * what they computed only to return is left for dead code to remove.
+ * A result is used by a caller that needs it itself, not one that only
+ * returns it in turn to callers that ignore it. Returns how many
+ * functions no longer return a value.
+ */
+int drop_unused_results(CallGraph *graph) {
+    IrProgram *program = graph->program;
+    int root = find_main(program);
+    if (root == IR_NONE) return 0;
+    int n = program->function_count;
+    char *needed = calloc(n, 1);
+    needed[root] = 1;
+
+    int changed = 1;
+    while (changed) {
+        changed = 0;
+        for (int i = n - 1; i >= 0; i--) {
+            int f = graph->order[i];
+            if (graph->first_callee[f] == graph->first_callee[f + 1]) continue;
+            IrFunction *function = program->functions[f];
+            char *live = find_live(function, needed[f]);
+            for (int b = 0; b < function->block_count; b++) {
+                IrBlock *block = &function->blocks[b];
+                for (int j = 0; j < block->count; j++) {
+                    IrInstruction *instruction = &block->instructions[j];
+                    if (instruction->opcode == IR_CALL ? !live[instruction->dest]
+                        : instruction->opcode != IR_TAIL_CALL || !needed[f]) {
+                        continue;
+                    }
+                    int g = call_graph_find(graph, instruction->call->callee);
+                    if (g != IR_NONE && !needed[g]) {
+                        needed[g] = 1;
+                        changed = 1;
+                    }
+                }
+            }
+            free(live);
+        }
+    }
+
+    int dropped = 0;
+    for (int f = 0; f < n; f++) {
+        if (needed[f]) continue;
+        IrFunction *function = program->functions[f];
+        int returned = 0;
+        for (int b = 0; b < function->block_count; b++) {
+            IrBlock *block = &function->blocks[b];
+            IrInstruction *last = &block->instructions[block->count - 1];
+            if (last->opcode == IR_RETURN && last->operands[0] != IR_NONE) {
+                last->operands[0] = IR_NONE;
+                returned = 1;
+            }
+        }
+        dropped += returned;
+    }
+    free(needed);
+    return dropped;
+}
@@ -0,0 +1,14 @@
+#include "ir.h"
+#include "callgraph.h"
+
+#ifndef IPA_HEADER
+#define IPA_HEADER
+
+/* Analyses over a whole program, from main. Each does nothing to a
+ * program without main, whose functions may be called from anywhere.
+ */
+int drop_unreachable_functions(IrProgram *program);
+int propagate_constant_arguments(CallGraph *graph);
+int drop_unused_results(CallGraph *graph);
+
+#endif
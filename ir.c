@@ -0,0 +1,708 @@
+#include <stdlib.h>
+#include <stdarg.h>
+#include <err.h>
+#include "ir.h"
+
+IrProgram *ir_program_new(void) {
+    IrProgram *program = malloc(sizeof(IrProgram));
+    program->functions = NULL;
+    program->function_count = 0;
+    program->function_capacity = 0;
+    program->arena = arena_new();
+    program->whole = 0;
+    return program;
+}
+
+void ir_program_free(IrProgram *program) {
+    if (program == NULL) return;
+    for (int i = 0; i < program->function_count; i++) {
+        ir_function_free(program->functions[i]);
+    }
+    free(program->functions);
+    arena_free(program->arena);
+    free(program);
+}
+
+/* Make room for one more item in an array, doubling it when full. The
+ * arrays that grow are malloc'd, as a copy left behind in an arena at
+ * each doubling would about double the memory the IR takes.
+ */
+static void *grow(void *items, int count, int *capacity, size_t item_size) {
+    if (count < *capacity) {
+        return items;
+    }
+    *capacity = *capacity > 0 ? *capacity * 2 : 2;
+    return realloc(items, *capacity * item_size);
+}
+
+IrFunction *ir_function_new(IrProgram *program, Name name, int parameter_count) {
+    IrFunction *function = arena_alloc(program->arena, sizeof(IrFunction));
+    function->name = name;
+    function->parameter_count = parameter_count;
+    function->blocks = NULL;
+    function->block_count = 0;
+    function->block_capacity = 0;
+    function->arrays = NULL;
+    function->array_count = 0;
+    function->array_capacity = 0;
+    function->array_words = 0;
+    function->register_count = 0;
+    function->arena = program->arena;
+
+    program->functions = grow(program->functions, program->function_count,
+                              &program->function_capacity, sizeof(IrFunction *));
+    program->functions[program->function_count++] = function;
+    return function;
+}
+
+/* Free what a function holds; it lives in its program's arena. */
+void ir_function_free(IrFunction *function) {
+    for (int b = 0; b < function->block_count; b++) {
+        free(function->blocks[b].instructions);
+        free(function->blocks[b].predecessors);
+    }
+    free(function->blocks);
+    free(function->arrays);
+}
+
+/* Add an empty block, returning its number. */
+int ir_block_new(IrFunction *function) {
+    function->blocks = grow(function->blocks, function->block_count,
+                            &function->block_capacity, sizeof(IrBlock));
+    IrBlock *block = &function->blocks[function->block_count];
+    block->instructions = NULL;
+    block->count = 0;
+    block->capacity = 0;
+    block->predecessors = NULL;
+    block->predecessor_count = 0;
+    block->predecessor_capacity = 0;
+    return function->block_count++;
+}
+
+/* Give the function an array of length words, returning its number. */
+int ir_array_new(IrFunction *function, Name name, int length) {
+    function->arrays = grow(function->arrays, function->array_count,
+                            &function->array_capacity, sizeof(IrArray));
+    IrArray *array = &function->arrays[function->array_count];
+    array->name = name;
+    array->length = length;
+    array->offset = function->array_words;
+    function->array_words += length;
+    return function->array_count++;
+}
+
+/* Add an instruction with no operands or result to the end of a block.
+ * The pointer is good until the block next grows.
+ */
+IrInstruction *ir_append(IrFunction *function, int block, IrOpcode opcode) {
+    IrBlock *b = &function->blocks[block];
+    b->instructions = grow(b->instructions, b->count, &b->capacity, sizeof(IrInstruction));
+    IrInstruction *instruction = &b->instructions[b->count++];
+    instruction->opcode = opcode;
+    instruction->dest = IR_NONE;
+    instruction->operands[0] = IR_NONE;
+    instruction->operands[1] = IR_NONE;
+    instruction->immediate = 0;
+    return instruction;
+}
+
+/* Append an instruction on up to two registers, returning the register it
+ * defines, or IR_NONE.
+ */
+int ir_emit(IrFunction *function, int block, IrOpcode opcode, int left, int right) {
+    IrInstruction *instruction = ir_append(function, block, opcode);
+    instruction->operands[0] = left;
+    instruction->operands[1] = right;
+    if (ir_has_result(opcode)) {
+        instruction->dest = function->register_count++;
+    }
+    return instruction->dest;
+}
+
+void ir_add_predecessor(IrFunction *function, int block, int predecessor) {
+    IrBlock *b = &function->blocks[block];
+    b->predecessors = grow(b->predecessors, b->predecessor_count,
+                           &b->predecessor_capacity, sizeof(int));
+    b->predecessors[b->predecessor_count++] = predecessor;
+}
+
+/* A map of registers to their replacements, each replacing itself. A
+ * register replaced by another stands for whatever that one stands for.
+ */
+int *ir_identity_map(IrFunction *function) {
+    int *map = malloc((function->register_count > 0 ? function->register_count : 1) * sizeof(int));
+    for (int r = 0; r < function->register_count; r++) map[r] = r;
+    return map;
+}
+
+/* What reg finally stands for in map, shortening the way there. */
+int ir_find(int *map, int reg) {
+    while (map[reg] != reg) {
+        map[reg] = map[map[reg]];
+        reg = map[reg];
+    }
+    return reg;
+}
+
+/* Read every register the function uses through map. */
+void ir_replace_registers(IrFunction *function, int *map) {
+    for (int b = 0; b < function->block_count; b++) {
+        IrBlock *block = &function->blocks[b];
+        for (int i = 0; i < block->count; i++) {
+            IrInstruction *instruction = &block->instructions[i];
+            for (int j = 0; j < ir_operand_count(instruction->opcode); j++) {
+                if (instruction->operands[j] != IR_NONE) {
+                    instruction->operands[j] = ir_find(map, instruction->operands[j]);
+                }
+            }
+            if (ir_is_call(instruction->opcode)) {
+                for (int j = 0; j < instruction->call->argument_count; j++) {
+                    instruction->call->arguments[j] = ir_find(map, instruction->call->arguments[j]);
+                }
+            } else if (instruction->opcode == IR_PHI) {
+                for (int j = 0; j < block->predecessor_count; j++) {
+                    instruction->incoming[j] = ir_find(map, instruction->incoming[j]);
+                }
+            }
+        }
+    }
+}
+
+/* Give back the spare room of a block that is complete. */
+void ir_block_trim(IrFunction *function, int block) {
+    IrBlock *b = &function->blocks[block];
+    if (b->count > 0 && b->count < b->capacity) {
+        b->instructions = realloc(b->instructions, b->count * sizeof(IrInstruction));
+        b->capacity = b->count;
+    }
+}
+
+int ir_is_terminator(IrOpcode opcode) {
+    return opcode == IR_BRANCH || opcode == IR_JUMP || opcode == IR_RETURN || opcode == IR_TAIL_CALL;
+}
+
+/* Whether an instruction's call holds a callee and its arguments. */
+int ir_is_call(IrOpcode opcode) {
+    return opcode == IR_CALL || opcode == IR_TAIL_CALL;
+}
+
+int ir_has_result(IrOpcode opcode) {
+    switch (opcode) {
+        case IR_STORE:
+        case IR_CHECK:
+        case IR_PRINT:
+        case IR_BRANCH:
+        case IR_JUMP:
+        case IR_RETURN:
+        case IR_TAIL_CALL:
+            return 0;
+        default:
+            return 1;
+    }
+}
+
+/* The registers an instruction reads from operands; calls and phis read
+ * theirs from elsewhere, and a return may have none.
+ */
+int ir_operand_count(IrOpcode opcode) {
+    switch (opcode) {
+        case IR_CONST:
+        case IR_PARAM:
+        case IR_CALL:
+        case IR_PHI:
+        case IR_JUMP:
+        case IR_TAIL_CALL:
+            return 0;
+        case IR_NEG:
+        case IR_NOT:
+        case IR_LOGICAL_NOT:
+        case IR_LOAD:
+        case IR_CHECK:
+        case IR_PRINT:
+        case IR_BRANCH:
+        case IR_RETURN:
+            return 1;
+        default:
+            return 2;
+    }
+}
+
+static const char *opcode_name(IrOpcode opcode) {
+    switch (opcode) {
+        case IR_CONST: return "const";
+        case IR_PARAM: return "param";
+        case IR_NEG: return "neg";
+        case IR_NOT: return "not";
+        case IR_LOGICAL_NOT: return "lnot";
+        case IR_ADD: return "add";
+        case IR_SUB: return "sub";
+        case IR_MUL: return "mul";
+        case IR_AND: return "and";
+        case IR_OR: return "or";
+        case IR_EQ: return "eq";
+        case IR_GT: return "gt";
+        case IR_LT: return "lt";
+        case IR_GE: return "ge";
+        case IR_LE: return "le";
+        case IR_LOAD: return "load";
+        case IR_STORE: return "store";
+        case IR_CHECK: return "check";
+        case IR_CALL: return "call";
+        case IR_PRINT: return "print";
+        case IR_PHI: return "phi";
+        case IR_BRANCH: return "branch";
+        case IR_JUMP: return "jump";
+        case IR_RETURN: return "return";
+        case IR_TAIL_CALL: return "tail call";
+    }
+    return "?";
+}
+
+static void print_instruction(FILE *out, IrFunction *function, IrBlock *block, IrInstruction *instruction) {
+    fprintf(out, "    ");
+    if (instruction->dest != IR_NONE) {
+        fprintf(out, "%%%d = ", instruction->dest);
+    }
+    fprintf(out, "%s", opcode_name(instruction->opcode));
+
+    switch (instruction->opcode) {
+        case IR_CONST:
+        case IR_PARAM:
+            fprintf(out, " %ld", instruction->immediate);
+            break;
+        case IR_LOAD:
+            fprintf(out, " %s[%%%d]", function->arrays[instruction->array].name, instruction->operands[0]);
+            break;
+        case IR_STORE:
+            fprintf(out, " %s[%%%d], %%%d", function->arrays[instruction->array].name,
+                    instruction->operands[0], instruction->operands[1]);
+            break;
+        case IR_CHECK:
+            fprintf(out, " %%%d, %ld", instruction->operands[0], instruction->immediate);
+            break;
+        case IR_CALL:
+        case IR_TAIL_CALL:
+            fprintf(out, " %s(", instruction->call->callee);
+            for (int i = 0; i < instruction->call->argument_count; i++) {
+                fprintf(out, "%s%%%d", i > 0 ? ", " : "", instruction->call->arguments[i]);
+            }
+            fprintf(out, ")");
+            break;
+        case IR_PHI:
+            for (int i = 0; i < block->predecessor_count; i++) {
+                fprintf(out, "%s [%%%d, block%d]", i > 0 ? "," : "",
+                        instruction->incoming[i], block->predecessors[i]);
+            }
+            break;
+        case IR_BRANCH:
+            fprintf(out, " %%%d, block%d, block%d", instruction->operands[0],
+                    instruction->targets[0], instruction->targets[1]);
+            break;
+        case IR_JUMP:
+            fprintf(out, " block%d", instruction->targets[0]);
+            break;
+        default:
+            for (int i = 0; i < ir_operand_count(instruction->opcode); i++) {
+                if (instruction->operands[i] != IR_NONE) {
+                    fprintf(out, "%s %%%d", i > 0 ? "," : "", instruction->operands[i]);
+                }
+            }
+            break;
+    }
+    fprintf(out, "\n");
+}
+
+static void print_function(FILE *out, IrFunction *function) {
+    fprintf(out, "function %s, %d parameters\n", function->name, function->parameter_count);
+    for (int i = 0; i < function->array_count; i++) {
+        fprintf(out, "    array %s[%d]\n", function->arrays[i].name, function->arrays[i].length);
+    }
+    for (int b = 0; b < function->block_count; b++) {
+        IrBlock *block = &function->blocks[b];
+        fprintf(out, "block%d:", b);
+        for (int i = 0; i < block->predecessor_count; i++) {
+            fprintf(out, "%s block%d", i > 0 ? "," : " ; from", block->predecessors[i]);
+        }
+        fprintf(out, "\n");
+        for (int i = 0; i < block->count; i++) {
+            print_instruction(out, function, block, &block->instructions[i]);
+        }
+    }
+}
+
+void ir_print(FILE *out, IrProgram *program) {
+    for (int i = 0; i < program->function_count; i++) {
+        if (i > 0) {
+            fprintf(out, "\n");
+        }
+        print_function(out, program->functions[i]);
+    }
+}
+
+/* The blocks an instruction may pass control to, returning how many. */
+int ir_successors(IrInstruction *instruction, int targets[2]) {
+    switch (instruction->opcode) {
+        case IR_BRANCH:
+            targets[0] = instruction->targets[0];
+            targets[1] = instruction->targets[1];
+            return 2;
+        case IR_JUMP:
+            targets[0] = instruction->targets[0];
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+typedef struct Verifier {
+    IrFunction *function;
+    int errors;
+    int *definition_block; // For each register, or IR_NONE
+    int *definition_index;
+    int *order; // Of each block in reverse postorder, or IR_NONE if unreachable
+    int *idom; // Immediate dominators
+    int *enter, *exit; // Times each block is entered and left in a walk of the dominator tree
+} Verifier;
+
+static void fail(Verifier *verifier, int block, const char *message, ...) {
+    char text[200];
+    va_list arguments;
+    va_start(arguments, message);
+    vsnprintf(text, sizeof(text), message, arguments);
+    va_end(arguments);
+    warnx("Invalid IR in %s, block%d: %s", verifier->function->name, block, text);
+    verifier->errors++;
+}
+
+static int valid_register(Verifier *verifier, int reg) {
+    return reg >= 0 && reg < verifier->function->register_count;
+}
+
+/* The checks that need only the instruction and its block. */
+static void check_shape(Verifier *verifier, int b) {
+    IrFunction *function = verifier->function;
+    IrBlock *block = &function->blocks[b];
+    if (block->count == 0 || !ir_is_terminator(block->instructions[block->count - 1].opcode)) {
+        fail(verifier, b, "does not end in a branch, jump or return");
+    }
+
+    int phis = 1;
+    for (int i = 0; i < block->count; i++) {
+        IrInstruction *instruction = &block->instructions[i];
+        IrOpcode opcode = instruction->opcode;
+        if (ir_is_terminator(opcode) && i != block->count - 1) {
+            fail(verifier, b, "%s before the end", opcode_name(opcode));
+        }
+        if (opcode == IR_PHI && !phis) {
+            fail(verifier, b, "phi after other instructions");
+        }
+        phis = opcode == IR_PHI;
+
+        if (ir_has_result(opcode) != (instruction->dest != IR_NONE)) {
+            fail(verifier, b, "%s with a result wrongly present or missing", opcode_name(opcode));
+        } else if (instruction->dest != IR_NONE) {
+            int dest = instruction->dest;
+            if (!valid_register(verifier, dest)) {
+                fail(verifier, b, "%%%d out of range", dest);
+            } else if (verifier->definition_block[dest] != IR_NONE) {
+                fail(verifier, b, "%%%d defined again", dest);
+            } else {
+                verifier->definition_block[dest] = b;
+                verifier->definition_index[dest] = i;
+            }
+        }
+
+        for (int j = 0; j < ir_operand_count(opcode); j++) {
+            int operand = instruction->operands[j];
+            if (!valid_register(verifier, operand) && !(opcode == IR_RETURN && operand == IR_NONE)) {
+                fail(verifier, b, "%s operand %d is not a register", opcode_name(opcode), j);
+            }
+        }
+
+        switch (opcode) {
+            case IR_PARAM:
+                if (instruction->immediate < 0 || instruction->immediate >= function->parameter_count) {
+                    fail(verifier, b, "no parameter %ld", instruction->immediate);
+                }
+                break;
+            case IR_LOAD:
+            case IR_STORE:
+                if (instruction->array < 0 || instruction->array >= function->array_count) {
+                    fail(verifier, b, "no array %d", instruction->array);
+                }
+                break;
+            case IR_CALL:
+            case IR_TAIL_CALL:
+                for (int j = 0; j < instruction->call->argument_count; j++) {
+                    if (!valid_register(verifier, instruction->call->arguments[j])) {
+                        fail(verifier, b, "call argument %d is not a register", j);
+                    }
+                }
+                break;
+            case IR_PHI:
+                for (int j = 0; j < block->predecessor_count; j++) {
+                    if (!valid_register(verifier, instruction->incoming[j])) {
+                        fail(verifier, b, "phi operand %d is not a register", j);
+                    }
+                }
+                break;
+            case IR_BRANCH:
+            case IR_JUMP: {
+                int targets[2];
+                for (int j = ir_successors(instruction, targets) - 1; j >= 0; j--) {
+                    if (targets[j] <= 0 || targets[j] >= function->block_count) {
+                        fail(verifier, b, "%s to block%d", opcode_name(opcode), targets[j]);
+                    }
+                }
+                if (opcode == IR_BRANCH && targets[0] == targets[1]) {
+                    fail(verifier, b, "branch with both targets block%d", targets[0]);
+                }
+                break;
+            }
+            default:
+                break;
+        }
+    }
+}
+
+/* Check that the predecessors of each block are exactly the blocks whose
+ * terminators lead to it.
+ */
+static void check_edges(Verifier *verifier) {
+    IrFunction *function = verifier->function;
+    int *incoming = calloc(function->block_count, sizeof(int));
+    for (int b = 0; b < function->block_count; b++) {
+        IrBlock *block = &function->blocks[b];
+        if (block->count > 0) {
+            int targets[2];
+            for (int j = ir_successors(&block->instructions[block->count - 1], targets) - 1; j >= 0; j--) {
+                if (targets[j] > 0 && targets[j] < function->block_count) {
+                    incoming[targets[j]]++;
+                }
+            }
+        }
+    }
+    for (int b = 0; b < function->block_count; b++) {
+        IrBlock *block = &function->blocks[b];
+        if (block->predecessor_count != incoming[b]) {
+            fail(verifier, b, "lists %d predecessors for %d incoming edges", block->predecessor_count, incoming[b]);
+            continue;
+        }
+        for (int i = 0; i < block->predecessor_count; i++) {
+            int p = block->predecessors[i];
+            int targets[2], count = 0;
+            if (p >= 0 && p < function->block_count && function->blocks[p].count > 0) {
+                IrBlock *predecessor = &function->blocks[p];
+                count = ir_successors(&predecessor->instructions[predecessor->count - 1], targets);
+            }
+            if (!(count > 0 && targets[0] == b) && !(count > 1 && targets[1] == b)) {
+                fail(verifier, b, "lists block%d, which does not lead to it", p);
+            }
+        }
+    }
+    free(incoming);
+}
+
+static int intersect(Verifier *verifier, int a, int b) {
+    while (a != b) {
+        while (verifier->order[a] > verifier->order[b]) a = verifier->idom[a];
+        while (verifier->order[b] > verifier->order[a]) b = verifier->idom[b];
+    }
+    return a;
+}
+
+/* Find each block's immediate dominator (Cooper, Harvey and Kennedy),
+ * then number the dominator tree so that a dominates b exactly when b's
+ * interval lies within a's. Returns 0 if some block is unreachable.
+ */
+static int find_dominators(Verifier *verifier) {
+    IrFunction *function = verifier->function;
+    int n = function->block_count;
+    int *postorder = malloc(n * sizeof(int));
+    int *stack = malloc(n * sizeof(int));
+    int *next_successor = calloc(n, sizeof(int));
+    int count = 0, depth = 0;
+    for (int b = 0; b < n; b++) verifier->order[b] = IR_NONE;
+
+    // Depth first from the entry, without recursion
+    stack[depth++] = 0;
+    verifier->order[0] = 0;
+    while (depth > 0) {
+        int b = stack[depth - 1];
+        IrBlock *block = &function->blocks[b];
+        int targets[2];
+        int successor_count = ir_successors(&block->instructions[block->count - 1], targets);
+        if (next_successor[b] < successor_count) {
+            int s = targets[next_successor[b]++];
+            if (verifier->order[s] == IR_NONE) {
+                verifier->order[s] = 0;
+                stack[depth++] = s;
+            }
+        } else {
+            postorder[count++] = b;
+            depth--;
+        }
+    }
+    int reachable = count == n;
+    for (int b = 0; b < n; b++) {
+        if (verifier->order[b] == IR_NONE) {
+            fail(verifier, b, "unreachable");
+        }
+    }
+
+    for (int i = 0; i < count; i++) {
+        verifier->order[postorder[i]] = count - 1 - i;
+        verifier->idom[postorder[i]] = IR_NONE;
+    }
+    if (reachable) {
+        verifier->idom[0] = 0;
+        int changed = 1;
+        while (changed) {
+            changed = 0;
+            for (int i = count - 2; i >= 0; i--) {
+                int b = postorder[i];
+                IrBlock *block = &function->blocks[b];
+                int idom = IR_NONE;
+                for (int j = 0; j < block->predecessor_count; j++) {
+                    int p = block->predecessors[j];
+                    if (verifier->idom[p] != IR_NONE) {
+                        idom = idom == IR_NONE ? p : intersect(verifier, p, idom);
+                    }
+                }
+                if (idom != verifier->idom[b]) {
+                    verifier->idom[b] = idom;
+                    changed = 1;
+                }
+            }
+        }
+
+        // Children of each block in the dominator tree, by counting sort
+        int *first_child = calloc(n + 1, sizeof(int));
+        int *children = malloc(n * sizeof(int));
+        for (int b = 1; b < n; b++) first_child[verifier->idom[b] + 1]++;
+        for (int b = 0; b < n; b++) first_child[b + 1] += first_child[b];
+        for (int b = 0; b < n; b++) next_successor[b] = 0;
+        for (int b = 1; b < n; b++) {
+            int parent = verifier->idom[b];
+            children[first_child[parent] + next_successor[parent]++] = b;
+        }
+
+        // The children are now walked in turn, counting through them again.
+        int time = 0;
+        for (int b = 0; b < n; b++) next_successor[b] = 0;
+        depth = 0;
+        stack[depth++] = 0;
+        verifier->enter[0] = time++;
+        while (depth > 0) {
+            int b = stack[depth - 1];
+            if (first_child[b] + next_successor[b] < first_child[b + 1]) {
+                int child = children[first_child[b] + next_successor[b]++];
+                verifier->enter[child] = time++;
+                stack[depth++] = child;
+            } else {
+                verifier->exit[b] = time++;
+                depth--;
+            }
+        }
+        free(first_child);
+        free(children);
+    }
+
+    free(postorder);
+    free(stack);
+    free(next_successor);
+    return reachable;
+}
+
+static int dominates(Verifier *verifier, int a, int b) {
+    return verifier->enter[a] <= verifier->enter[b] && verifier->exit[b] <= verifier->exit[a];
+}
+
+/* Check that the definition of reg is available at instruction index of
+ * block b, or at its end if index is the block's count.
+ */
+static void check_use(Verifier *verifier, int b, int index, int reg) {
+    if (!valid_register(verifier, reg)) {
+        return; // Already reported
+    }
+    int definition = verifier->definition_block[reg];
+    if (definition == IR_NONE) {
+        fail(verifier, b, "%%%d is never defined", reg);
+    } else if (definition == b ? verifier->definition_index[reg] >= index : !dominates(verifier, definition, b)) {
+        fail(verifier, b, "%%%d is used where its definition may not have run", reg);
+    }
+}
+
+static void check_uses(Verifier *verifier) {
+    IrFunction *function = verifier->function;
+    for (int b = 0; b < function->block_count; b++) {
+        IrBlock *block = &function->blocks[b];
+        for (int i = 0; i < block->count; i++) {
+            IrInstruction *instruction = &block->instructions[i];
+            for (int j = 0; j < ir_operand_count(instruction->opcode); j++) {
+                if (instruction->operands[j] != IR_NONE) {
+                    check_use(verifier, b, i, instruction->operands[j]);
+                }
+            }
+            if (ir_is_call(instruction->opcode)) {
+                for (int j = 0; j < instruction->call->argument_count; j++) {
+                    check_use(verifier, b, i, instruction->call->arguments[j]);
+                }
+            } else if (instruction->opcode == IR_PHI) {
+                // Each operand must be available where its edge leaves.
+                for (int j = 0; j < block->predecessor_count; j++) {
+                    int p = block->predecessors[j];
+                    check_use(verifier, p, function->blocks[p].count, instruction->incoming[j]);
+                }
+            }
+        }
+    }
+}
+
+/* Check a function's invariants: each block ends in its only terminator,
+ * phis come first and have an operand per predecessor, predecessors match
+ * the edges, every block is reachable, and every register is defined once,
+ * before each use on every path. Reports each violation, returning how
+ * many there were.
+ */
+int ir_verify(IrFunction *function) {
+    Verifier verifier;
+    verifier.function = function;
+    verifier.errors = 0;
+    if (function->block_count == 0) {
+        warnx("Invalid IR in %s: no blocks", function->name);
+        return 1;
+    }
+
+    int registers = function->register_count > 0 ? function->register_count : 1;
+    int blocks = function->block_count;
+    verifier.definition_block = malloc(registers * sizeof(int));
+    verifier.definition_index = malloc(registers * sizeof(int));
+    for (int r = 0; r < function->register_count; r++) verifier.definition_block[r] = IR_NONE;
+    verifier.order = malloc(blocks * sizeof(int));
+    verifier.idom = malloc(blocks * sizeof(int));
+    verifier.enter = malloc(blocks * sizeof(int));
+    verifier.exit = malloc(blocks * sizeof(int));
+
+    if (function->blocks[0].predecessor_count > 0) {
+        fail(&verifier, 0, "the entry has predecessors");
+    }
+    for (int b = 0; b < blocks; b++) {
+        check_shape(&verifier, b);
+    }
+    if (verifier.errors == 0) {
+        check_edges(&verifier);
+    }
+    // Dominance is only meaningful once the graph itself is sound.
+    if (verifier.errors == 0 && find_dominators(&verifier)) {
+        check_uses(&verifier);
+    }
+
+    free(verifier.definition_block);
+    free(verifier.definition_index);
+    free(verifier.order);
+    free(verifier.idom);
+    free(verifier.enter);
+    free(verifier.exit);
+    return verifier.errors;
+}
@@ -0,0 +1,123 @@
+#include <stdio.h>
+#include "arena.h"
+#include "intern.h"
+
+#ifndef IR_HEADER
+#define IR_HEADER
+
+/* A three-address intermediate representation in SSA form. A function is
+ * an array of basic blocks, the first its entry, each a list of
+ * instructions ending in one terminator: a branch, jump or return. Every
+ * instruction with a result defines a new virtual register, numbered
+ * within its function and assigned nowhere else. Where control flow
+ * joins, phis at the start of the block pick a register per predecessor.
+ * Arrays live in the frame, read and written by load and store.
+ */
+typedef enum IrOpcode {
+    IR_CONST, // dest = immediate
+    IR_PARAM, // dest = the parameter numbered immediate
+    IR_NEG,
+    IR_NOT,
+    IR_LOGICAL_NOT,
+    IR_ADD,
+    IR_SUB,
+    IR_MUL,
+    IR_AND,
+    IR_OR,
+    IR_EQ,
+    IR_GT,
+    IR_LT,
+    IR_GE,
+    IR_LE,
+    IR_LOAD, // dest = array[operands[0]]
+    IR_STORE, // array[operands[0]] = operands[1]
+    IR_CHECK, // Trap unless 0 <= operands[0] < immediate
+    IR_CALL, // dest = call(arguments)
+    IR_PRINT,
+    IR_PHI,
+    IR_BRANCH, // To targets[0] if operands[0] is nonzero, else targets[1]
+    IR_JUMP, // To targets[0]
+    IR_RETURN, // operands[0], or IR_NONE if the function falls off its end
+    IR_TAIL_CALL, // Return what call(arguments) returns, in place of this function
+} IrOpcode;
+
+#define IR_NONE (-1) // In place of a register or block
+
+typedef struct IrCall {
+    Name callee;
+    int argument_count;
+    int arguments[]; // Registers
+} IrCall;
+
+typedef struct IrInstruction {
+    IrOpcode opcode;
+    int dest; // The register defined, or IR_NONE
+    int operands[2]; // Registers used, or IR_NONE
+    union {
+        long immediate;
+        int array; // Of a LOAD or STORE, its index in the function's arrays
+        int targets[2]; // Of a BRANCH or JUMP, block numbers
+        IrCall *call; // Of a CALL or TAIL_CALL
+        int *incoming; // Of a PHI, a register for each predecessor, in order
+    };
+} IrInstruction;
+
+typedef struct IrBlock {
+    IrInstruction *instructions;
+    int count;
+    int capacity;
+    int *predecessors; // Block numbers
+    int predecessor_count;
+    int predecessor_capacity;
+} IrBlock;
+
+typedef struct IrArray {
+    Name name;
+    int length; // In words
+    int offset; // Its first word, among the words of all the function's arrays
+} IrArray;
+
+typedef struct IrFunction {
+    Name name;
+    int parameter_count;
+    IrBlock *blocks;
+    int block_count;
+    int block_capacity;
+    IrArray *arrays;
+    int array_count;
+    int array_capacity;
+    int array_words; // Of all its arrays
+    int register_count;
+    Arena *arena; // The program's, for calls and phi operands added later
+} IrFunction;
+
+typedef struct IrProgram {
+    IrFunction **functions; // In source order
+    int function_count;
+    int function_capacity;
+    Arena *arena; // Holds the functions, calls and phi operands; the arrays that grow are malloc'd
+    int whole; // Whether it holds every function, so none is called from elsewhere
+} IrProgram;
+
+IrProgram *ir_program_new(void);
+void ir_program_free(IrProgram *program);
+IrFunction *ir_function_new(IrProgram *program, Name name, int parameter_count);
+void ir_function_free(IrFunction *function);
+int ir_block_new(IrFunction *function);
+void ir_block_trim(IrFunction *function, int block);
+int ir_array_new(IrFunction *function, Name name, int length);
+IrInstruction *ir_append(IrFunction *function, int block, IrOpcode opcode);
+int ir_emit(IrFunction *function, int block, IrOpcode opcode, int left, int right);
+void ir_add_predecessor(IrFunction *function, int block, int predecessor);
+int *ir_identity_map(IrFunction *function);
+int ir_find(int *map, int reg);
+void ir_replace_registers(IrFunction *function, int *map);
+int ir_is_terminator(IrOpcode opcode);
+int ir_is_call(IrOpcode opcode);
+int ir_has_result(IrOpcode opcode);
+int ir_operand_count(IrOpcode opcode);
+int ir_successors(IrInstruction *instruction, int targets[2]);
+void ir_print(FILE *out, IrProgram *program);
+int ir_verify(IrFunction *function);
+
+#endif
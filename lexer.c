@@ -0,0 +1,248 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "lexer.h"
+#include "intern.h"
+#include "syntax.h"
+#include "compilation.h"
+#include "build/y.tab.h"
+
+/* A hand-written scanner over a memory-mapped source file. Identifiers
+ * are interned straight out of the mapping, so each distinct name is
+ * copied once no matter how often it appears.
+ */
+
+Source *source_open(char *file_name) {
+    int fd = open(file_name, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return NULL;
+    }
+
+    Source *source = malloc(sizeof(Source));
+    source->length = st.st_size;
+    source->mapped = 0;
+    source->text = "";
+
+    if (source->length > 0) {
+        void *map = mmap(NULL, source->length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED) {
+            madvise(map, source->length, MADV_SEQUENTIAL);
+            source->text = map;
+            source->mapped = 1;
+        } else {
+            // Not mappable (e.g. a pipe), so fall back to reading it in.
+            char *buffer = malloc(source->length);
+            size_t total = 0;
+            ssize_t n;
+            while (total < source->length && (n = read(fd, buffer + total, source->length - total)) > 0) {
+                total += n;
+            }
+            source->text = buffer;
+            source->length = total;
+        }
+    }
+
+    close(fd);
+    source->index = structural_index_build(source->text, source->length);
+    return source;
+}
+
+void source_close(Source *source) {
+    if (source == NULL) return;
+    structural_index_free(source->index);
+    if (source->mapped) {
+        munmap((void *)source->text, source->length);
+    } else if (source->length > 0) {
+        free((void *)source->text);
+    }
+    free(source);
+}
+
+void lexer_init(Lexer *lexer, Source *source) {
+    lexer_init_range(lexer, source, 0, source->length);
+}
+
+/* Tokenize only bytes [begin, end) of the source. Positions in error
+ * messages are still relative to the whole file.
+ */
+void lexer_init_range(Lexer *lexer, Source *source, size_t begin, size_t end) {
+    lexer->source = source;
+    lexer->cursor = source->text + begin;
+    lexer->end = source->text + end;
+    lexer->token_start = lexer->cursor;
+    lexer->error_count = 0;
+    lexer->silent = 0;
+}
+
+static void report_at(Lexer *lexer, const char *position, const char *message) {
+    if (lexer->silent) return;
+    int line, column;
+    structural_line_column(lexer->source->index, position - lexer->source->text, &line, &column);
+    fprintf(stderr, "error: line %d, column %d: %s\n", line, column, message);
+}
+
+static void lexer_error(Lexer *lexer, const char *position, const char *message) {
+    lexer->error_count++;
+    report_at(lexer, position, message);
+}
+
+/* Keywords are matched with a perfect hash over (length, first char, last
+ * char), followed by a single memcmp against the one possible candidate.
+ */
+typedef struct Keyword {
+    const char *text;
+    int length;
+    int token;
+} Keyword;
+
+#define KEYWORD_HASH(s, len) (((len) + (unsigned char)(s)[0] + (unsigned char)(s)[(len) - 1]) & 15)
+
+static const Keyword keywords[16] = {
+    [1] = {"if", 2, IF},
+    [6] = {"return", 6, RETURN},
+    [7] = {"fun", 3, FUN},
+    [9] = {"print", 5, PRINT},
+    [11] = {"var", 3, TYPE},
+    [14] = {"else", 4, ELSE},
+};
+
+static int keyword_token(const char *start, int length) {
+    if (length < 2 || length > 6) return 0;
+    const Keyword *keyword = &keywords[KEYWORD_HASH(start, length)];
+    if (keyword->length == length && memcmp(keyword->text, start, length) == 0) {
+        return keyword->token;
+    }
+    return 0;
+}
+
+static int is_ident_start(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+int lexer_next(Lexer *lexer, YYSTYPE *value) {
+    const StructuralIndex *index = lexer->source->index;
+    const char *text = lexer->source->text;
+    const char *end = lexer->end;
+
+    // Whitespace and comments were found up front, so jump straight to the
+    // next token boundary. A token ends just before the next one starts
+    // unless it is followed by whitespace or a comment, which always begins
+    // with '/'.
+    const char *p = lexer->cursor;
+    if (p + 1 < end && *p == ' ' && p[1] != ' ') {
+        p++; // A lone separating space is cheaper to step over than to look up
+    }
+    if (p < end && (*p == ' ' || (*p >= '\t' && *p <= '\r') || *p == '/')) {
+        p = text + structural_next_token(index, p - text);
+        if (p > end) {
+            p = end;
+        }
+    }
+    lexer->cursor = p;
+    lexer->token_start = p;
+
+    if (p >= end) {
+        if (index->unterminated_comment < index->length && text + index->unterminated_comment < end) {
+            lexer_error(lexer, text + index->unterminated_comment, "unterminated comment");
+        }
+        return 0;
+    }
+
+    const char *start = p;
+    char c = *p++;
+
+    if (is_ident_start(c)) {
+        size_t position = p - text;
+        uint64_t rest = ~index->identifier[position / 64] >> (position % 64);
+        if (rest != 0) {
+            p += __builtin_ctzll(rest);
+        } else {
+            p = text + structural_identifier_end(index, position);
+        }
+        if (p > end) {
+            p = end;
+        }
+        lexer->cursor = p;
+        int length = p - start;
+        int token = keyword_token(start, length);
+        if (token) {
+            return token;
+        }
+        value->name = intern(start, length);
+        return IDENTIFIER;
+    }
+
+    if (c >= '0' && c <= '9') {
+        long number = c - '0';
+        int overflow = 0;
+        while (p < end && *p >= '0' && *p <= '9') {
+            number = number * 10 + (*p - '0');
+            if (number > INT_MAX) {
+                overflow = 1;
+                number = INT_MAX;
+            }
+            p++;
+        }
+        lexer->cursor = p;
+        if (overflow) {
+            lexer_error(lexer, start, "integer literal out of range");
+        }
+        value->number = (int)number;
+        return NUMBER;
+    }
+
+    char next = p < end ? *p : '\0';
+    lexer->cursor = p;
+
+    switch (c) {
+        case '{': return OPEN_BRACE;
+        case '}': return CLOSE_BRACE;
+        case '(': return LB;
+        case ')': return RB;
+        case '[': return LSB;
+        case ']': return RSB;
+        case '~': return NT;
+        case '!': return LN;
+        case '+': return PLUS;
+        case '-': return MINUS;
+        case '*': return MULT;
+        case ';': return SEMICOLON;
+        case ',': return COMMA;
+        case '&':
+            if (next == '&') { lexer->cursor++; return AD; }
+            break;
+        case '|':
+            if (next == '|') { lexer->cursor++; return ORR; }
+            break;
+        case '=':
+            if (next == '=') { lexer->cursor++; return EQ; }
+            return ASN;
+        case '<':
+            if (next == '=') { lexer->cursor++; return LT_EQ; }
+            return LST;
+        case '>':
+            if (next == '=') { lexer->cursor++; return GT_EQ; }
+            return GRT;
+    }
+
+    // Hand the raw character to the parser, which has no rule for it and
+    // reports a syntax error.
+    lexer_error(lexer, start, "unexpected character");
+    return c ? (unsigned char)c : 1;
+}
+
+/* Report an error at the most recent token. */
+void lexer_report(Lexer *lexer, const char *message) {
+    report_at(lexer, lexer->token_start, message);
+}
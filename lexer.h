@@ -0,0 +1,34 @@
+#include <stddef.h>
+#include "scan.h"
+
+#ifndef LEXER_HEADER
+#define LEXER_HEADER
+
+/* A source file, memory-mapped read-only. */
+typedef struct Source {
+    const char *text;
+    size_t length;
+    int mapped; // 1 if text is an mmap region, 0 if it was read into the heap
+    StructuralIndex *index;
+} Source;
+
+typedef struct Lexer {
+    Source *source;
+    const char *cursor;
+    const char *end;
+    const char *token_start; // Start of the most recent token, for error positions
+    int error_count;
+    int silent; // Count errors without printing them
+} Lexer;
+
+union YYSTYPE;
+
+Source *source_open(char *file_name);
+void source_close(Source *source);
+
+void lexer_init(Lexer *lexer, Source *source);
+void lexer_init_range(Lexer *lexer, Source *source, size_t begin, size_t end);
+int lexer_next(Lexer *lexer, union YYSTYPE *value);
+void lexer_report(Lexer *lexer, const char *message);
+
+#endif
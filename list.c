@@ -6,66 +6,57 @@
 
 List *list_new(void) {
     List *list = malloc(sizeof(List));
-    list->size = 0;
-    list->items = NULL;
+    vector_init(&list->items, sizeof(void *), NULL);
 
     return list;
 };
 
+List *list_new_in(Arena *arena) {
+    List *list = arena_alloc(arena, sizeof(List));
+    vector_init(&list->items, sizeof(void *), arena);
+
+    return list;
+}
+
+/* A list in an arena is released along with the arena. */
 void list_free(List *list) {
-    if (list->items != NULL) {
-        free(list->items);
-    }
+    if (list->items.arena != NULL) return;
+    vector_release(&list->items);
     free(list);
 }
 
-int list_length(List *list) { return list->size; }
+int list_length(List *list) { return vector_length(&list->items); }
 
 void list_append(List *list, void *item) {
-    list->size++;
-    list->items = realloc(list->items, list->size * sizeof(item));
-
-    list->items[list->size - 1] = item;
+    vector_push_back(&list->items, &item);
 }
 
 /* Insert item as the first element in list. */
 void list_push(List *list, void *item) {
-    list->size++;
-
-    void **new_items = malloc(list->size * sizeof(item));
-    memcpy(new_items + 1, list->items, (list->size - 1) * sizeof(item));
-
-    if (list->items != NULL) {
-        free(list->items);
-    }
-    list->items = new_items;
-
-    list->items[0] = item;
+    vector_push_front(&list->items, &item);
 }
 
 /* Remove the last item from the list, and return it.
  */
 void *list_pop(List *list) {
-    void *value = list_get(list, list->size - 1);
-
-    list->size--;
-    list->items = realloc(list->items, list->size * sizeof(value));
+    void *value;
+    vector_pop_back(&list->items, &value);
 
     return value;
 }
 
-void *list_get(List *list, int index) { return list->items[index]; }
+void *list_get(List *list, int index) { return *(void **)vector_at(&list->items, index); }
 
 void list_set(List *list, int index, void *value) {
-    if (index < 0 || index > list->size) {
+    if (index < 0 || index > list_length(list)) {
         warnx("Index %d is out of bounds!", index);
     }
 
-    else if (index == list->size) {
+    else if (index == list_length(list)) {
         list_append(list, value);
     }
 
     else {
-        list->items[index] = value;
+        *(void **)vector_at(&list->items, index) = value;
     }
 }
\ No newline at end of file
@@ -1,14 +1,15 @@
+#include "arena.h"
+#include "vector.h"
+
 #ifndef LIST_HEADER
 #define LIST_HEADER
 
 typedef struct List {
-    int size;
-    void **items;
+    Vector items; // Of void *; in an arena if the list is
 } List;
 
-#define INITIAL_LIST_SIZE 32
-
 List *list_new(void);
+List *list_new_in(Arena *arena);
 
 int list_length(List *list);
 
@@ -24,4 +25,4 @@ void *list_get(List *list, int index);
 
 void list_set(List *list, int index, void *value);
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,504 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include "lower.h"
+#include "semantic.h"
+#include "range.h"
+#include "vector.h"
+#include "walk.h"
+
+/* Lowering builds SSA form directly. Each scalar variable's Symbol holds
+ * the register with its value at the point reached, so reading a
+ * variable emits nothing and assigning one just rebinds it. The language
+ * has no loops, so control only joins after an IF: both arms start from
+ * the state before it, and a phi is placed at the join for each variable
+ * the arms leave in different registers. Statements after a return are
+ * never reached and are left out.
+ */
+
+/* A variable's register before a change, so that it can be undone. */
+typedef struct Change {
+    Symbol *symbol;
+    int value;
+} Change;
+
+typedef struct Branch {
+    size_t mark; // The length of changes before the IF
+    size_t then_begin; // Where the then arm's results start in then_values
+    int then_end; // The block the then arm ends in, or IR_NONE if it returned
+} Branch;
+
+typedef struct Lowering {
+    IrProgram *program;
+    Context *ctx;
+    IrFunction *function; // Being lowered
+    int block; // Where code goes next, or IR_NONE after a return
+    Vector values; // Of int, the registers of expressions not yet used
+    Vector changes; // Of Change, every change since the function began
+    Vector then_values; // Of Change, holding the state at the end of then arms
+    Vector branches; // Of Branch, one per IF being lowered
+    Vector arrays; // Of Symbol *, the arrays in scope
+} Lowering;
+
+static void push_value(Lowering *lowering, int reg) {
+    vector_push_back(&lowering->values, &reg);
+}
+
+static int pop_value(Lowering *lowering) {
+    int reg;
+    vector_pop_back(&lowering->values, &reg);
+    return reg;
+}
+
+static int emit(Lowering *lowering, IrOpcode opcode, int left, int right) {
+    return ir_emit(lowering->function, lowering->block, opcode, left, right);
+}
+
+static int emit_constant(Lowering *lowering, long value) {
+    int reg = emit(lowering, IR_CONST, IR_NONE, IR_NONE);
+    IrBlock *block = &lowering->function->blocks[lowering->block];
+    block->instructions[block->count - 1].immediate = value;
+    return reg;
+}
+
+/* End a block with a jump whose target is set once it is known. The
+ * block is then complete, and is trimmed to size.
+ */
+static void end_with_jump(Lowering *lowering, int block) {
+    ir_append(lowering->function, block, IR_JUMP)->targets[0] = IR_NONE;
+    ir_block_trim(lowering->function, block);
+}
+
+static void set_jump_target(Lowering *lowering, int from, int to) {
+    IrBlock *block = &lowering->function->blocks[from];
+    block->instructions[block->count - 1].targets[0] = to;
+    ir_add_predecessor(lowering->function, to, from);
+}
+
+static void set_value(Lowering *lowering, Symbol *symbol, int value) {
+    Change change = { symbol, symbol->value };
+    vector_push_back(&lowering->changes, &change);
+    symbol->value = value;
+}
+
+static void undo_changes(Lowering *lowering, size_t mark) {
+    while (vector_length(&lowering->changes) > mark) {
+        Change change;
+        vector_pop_back(&lowering->changes, &change);
+        change.symbol->value = change.value;
+    }
+}
+
+static Symbol *find_array(Lowering *lowering, Name name) {
+    for (size_t i = vector_length(&lowering->arrays); i > 0; i--) {
+        Symbol *symbol = *(Symbol **)vector_at(&lowering->arrays, i - 1);
+        if (symbol->name == name) {
+            return symbol;
+        }
+    }
+    return NULL;
+}
+
+/* With bounds checking, guard an access unless it was proven in range. */
+static void check_index(Lowering *lowering, Syntax *access, int index) {
+    Context *ctx = lowering->ctx;
+    if (ctx->bounds_checks == NULL) return;
+    int limit = bounds_check_limit(ctx->bounds_checks, access);
+    if (limit == 0) {
+        ctx->checks_elided++;
+    } else if (limit > 0) {
+        IrInstruction *check = ir_append(lowering->function, lowering->block, IR_CHECK);
+        check->operands[0] = index;
+        check->immediate = limit;
+        ctx->checks_emitted++;
+    }
+}
+
+/* Assigning an array stores to its first element, as it always has. */
+static void store_element(Lowering *lowering, Symbol *array, int index, int value) {
+    IrInstruction *store = ir_append(lowering->function, lowering->block, IR_STORE);
+    store->operands[0] = index;
+    store->operands[1] = value;
+    store->array = array->value;
+}
+
+static int load_element(Lowering *lowering, Symbol *array, int index) {
+    int reg = emit(lowering, IR_LOAD, index, IR_NONE);
+    IrBlock *block = &lowering->function->blocks[lowering->block];
+    block->instructions[block->count - 1].array = array->value;
+    return reg;
+}
+
+static void enter_function(Lowering *lowering, Syntax *syntax) {
+    Syntax *parameters = syntax->function.parameters;
+    int count = parameters ? list_length(parameters->function_arguments.arguments) : 0;
+    lowering->function = ir_function_new(lowering->program, syntax->function.name, count);
+    lowering->block = ir_block_new(lowering->function);
+    vector_release(&lowering->changes);
+    vector_release(&lowering->arrays);
+
+    for (int i = 0; i < count; i++) {
+        Symbol *symbol = ((Syntax *)list_get(parameters->function_arguments.arguments, i))->define_var_statement.symbol;
+        int reg = emit(lowering, IR_PARAM, IR_NONE, IR_NONE);
+        IrBlock *entry = &lowering->function->blocks[lowering->block];
+        entry->instructions[entry->count - 1].immediate = i;
+        symbol->value = reg;
+    }
+}
+
+static int lower_enter(Walker *walker, WalkFrame *frame, WalkFrame *parent) {
+    (void)parent;
+    Lowering *lowering = walker->data;
+    Syntax *syntax = frame->node;
+
+    switch (syntax->type) {
+        case FUNCTION:
+            enter_function(lowering, syntax);
+            return 1;
+        case IMMEDIATE:
+            push_value(lowering, emit_constant(lowering, syntax->immediate.value));
+            return 0;
+        case VARIABLE: {
+            Symbol *symbol = syntax->variable.symbol;
+            if (symbol->type == TYPE_ARRAY) {
+                push_value(lowering, load_element(lowering, symbol, emit_constant(lowering, 0)));
+            } else {
+                push_value(lowering, symbol->value);
+            }
+            return 0;
+        }
+        case DEFINE_VAR: {
+            Symbol *symbol = syntax->define_var_statement.symbol;
+            if (symbol->type != TYPE_ARRAY) {
+                return 1;
+            }
+            // Arrays start zeroed, so declaring one emits nothing.
+            symbol->value = ir_array_new(lowering->function, symbol->name, symbol->array_size);
+            vector_push_back(&lowering->arrays, &symbol);
+            return 0;
+        }
+        case BLOCK:
+            frame->value = vector_length(&lowering->arrays);
+            return 1;
+        default:
+            return 1;
+    }
+}
+
+static int lower_before_child(Walker *walker, WalkFrame *frame, int index, Syntax *child) {
+    (void)child;
+    Lowering *lowering = walker->data;
+    Syntax *syntax = frame->node;
+
+    switch (syntax->type) {
+        case FUNCTION:
+            return index != 0;
+        case BLOCK:
+            // Drop the values of expression statements.
+            while (vector_length(&lowering->values) > 0) {
+                vector_pop_back(&lowering->values, NULL);
+            }
+            return lowering->block != IR_NONE;
+        case IF_STATEMENT:
+            if (index == 1) {
+                IrFunction *function = lowering->function;
+                int condition = pop_value(lowering);
+                int then_block = ir_block_new(function);
+                int else_block = ir_block_new(function);
+                IrInstruction *branch = ir_append(function, lowering->block, IR_BRANCH);
+                branch->operands[0] = condition;
+                branch->targets[0] = then_block;
+                branch->targets[1] = else_block;
+                ir_add_predecessor(function, then_block, lowering->block);
+                ir_add_predecessor(function, else_block, lowering->block);
+                ir_block_trim(function, lowering->block);
+
+                Branch pending = { vector_length(&lowering->changes), 0, IR_NONE };
+                vector_push_back(&lowering->branches, &pending);
+                // The else block follows the then arm's blocks.
+                frame->value = else_block;
+                lowering->block = then_block;
+            } else if (index == 2) {
+                Branch *branch = vector_at(&lowering->branches, vector_length(&lowering->branches) - 1);
+                branch->then_end = lowering->block;
+                if (branch->then_end != IR_NONE) {
+                    end_with_jump(lowering, branch->then_end);
+                }
+                branch->then_begin = vector_length(&lowering->then_values);
+                for (size_t i = branch->mark; i < vector_length(&lowering->changes); i++) {
+                    Change *change = vector_at(&lowering->changes, i);
+                    Change result = { change->symbol, change->symbol->value };
+                    vector_push_back(&lowering->then_values, &result);
+                }
+                undo_changes(lowering, branch->mark);
+                lowering->block = frame->value;
+            }
+            return 1;
+        default:
+            return 1;
+    }
+}
+
+/* A change to a variable at the end of an arm, and where in the arm's
+ * changes it first appears.
+ */
+typedef struct ArmValue {
+    Symbol *symbol;
+    int value;
+    size_t order;
+} ArmValue;
+
+static int compare_symbols(const void *a, const void *b) {
+    const ArmValue *x = a, *y = b;
+    if (x->symbol != y->symbol) {
+        return (uintptr_t)x->symbol < (uintptr_t)y->symbol ? -1 : 1;
+    }
+    return x->order < y->order ? -1 : x->order > y->order;
+}
+
+static int compare_order(const void *a, const void *b) {
+    const ArmValue *x = a, *y = b;
+    return x->order < y->order ? -1 : x->order > y->order;
+}
+
+/* Copy changes[begin, end) to an array sorted by symbol, numbering them
+ * in order from first.
+ */
+static ArmValue *sorted_changes(Vector *changes, size_t begin, size_t end, size_t first) {
+    ArmValue *sorted = malloc((end > begin ? end - begin : 1) * sizeof(ArmValue));
+    for (size_t i = begin; i < end; i++) {
+        Change *change = vector_at(changes, i);
+        ArmValue value = { change->symbol, change->value, first + i - begin };
+        sorted[i - begin] = value;
+    }
+    qsort(sorted, end - begin, sizeof(ArmValue), compare_symbols);
+    return sorted;
+}
+
+/* At the join of an IF whose arms both fall through, give each variable
+ * either arm changed a phi of its registers at the ends of the two arms.
+ * A variable one arm left alone has its register from before the IF in
+ * that arm; one declared inside an arm had none, and is out of scope.
+ * Phis are placed in the order their variables were first changed, which
+ * unlike the symbols' addresses does not depend on how analysis ran.
+ */
+static void join_arms(Lowering *lowering, Branch *branch) {
+    size_t end = vector_length(&lowering->changes);
+    for (size_t i = branch->mark; i < end; i++) {
+        Change *change = vector_at(&lowering->changes, i);
+        Change result = { change->symbol, change->symbol->value };
+        vector_push_back(&lowering->then_values, &result);
+    }
+    size_t then_end = vector_length(&lowering->then_values) - (end - branch->mark);
+    size_t then_count = then_end - branch->then_begin, else_count = end - branch->mark;
+    ArmValue *then_arm = sorted_changes(&lowering->then_values, branch->then_begin, then_end, 0);
+    ArmValue *else_arm = sorted_changes(&lowering->then_values, then_end, vector_length(&lowering->then_values), then_count);
+    // Each joined variable, with its register from the then arm in value
+    // and from the else arm in else_values
+    ArmValue *joined = malloc((then_count + else_count + 1) * sizeof(ArmValue));
+    int *else_values = malloc((then_count + else_count + 1) * sizeof(int));
+    size_t count = 0;
+
+    undo_changes(lowering, branch->mark);
+    size_t i = 0, j = 0;
+    while (i < then_count || j < else_count) {
+        Symbol *symbol = j == else_count || (i < then_count && (uintptr_t)then_arm[i].symbol < (uintptr_t)else_arm[j].symbol)
+            ? then_arm[i].symbol : else_arm[j].symbol;
+        ArmValue result = { symbol, symbol->value, (size_t)-1 };
+        int else_value = symbol->value;
+        if (i < then_count && then_arm[i].symbol == symbol) {
+            result.order = then_arm[i].order;
+        } else {
+            result.order = else_arm[j].order;
+        }
+        while (i < then_count && then_arm[i].symbol == symbol) result.value = then_arm[i++].value;
+        while (j < else_count && else_arm[j].symbol == symbol) else_value = else_arm[j++].value;
+        if (symbol->value != IR_NONE && result.value != else_value) {
+            else_values[result.order] = else_value;
+            joined[count++] = result;
+        }
+    }
+    qsort(joined, count, sizeof(ArmValue), compare_order);
+
+    for (size_t k = 0; k < count; k++) {
+        int phi = emit(lowering, IR_PHI, IR_NONE, IR_NONE);
+        IrBlock *join = &lowering->function->blocks[lowering->block];
+        int *incoming = arena_alloc(lowering->program->arena, 2 * sizeof(int));
+        incoming[0] = joined[k].value;
+        incoming[1] = else_values[joined[k].order];
+        join->instructions[join->count - 1].incoming = incoming;
+        set_value(lowering, joined[k].symbol, phi);
+    }
+    free(then_arm);
+    free(else_arm);
+    free(joined);
+    free(else_values);
+}
+
+static void join_branches(Lowering *lowering) {
+    Branch branch;
+    vector_pop_back(&lowering->branches, &branch);
+    int else_end = lowering->block;
+
+    if (branch.then_end != IR_NONE || else_end != IR_NONE) {
+        if (else_end != IR_NONE) end_with_jump(lowering, else_end);
+        int join = ir_block_new(lowering->function);
+        if (branch.then_end != IR_NONE) set_jump_target(lowering, branch.then_end, join);
+        if (else_end != IR_NONE) set_jump_target(lowering, else_end, join);
+        lowering->block = join;
+    }
+    if (branch.then_end != IR_NONE && else_end != IR_NONE) {
+        join_arms(lowering, &branch);
+    } else if (branch.then_end != IR_NONE) {
+        undo_changes(lowering, branch.mark);
+        for (size_t i = branch.then_begin; i < vector_length(&lowering->then_values); i++) {
+            Change value = *(Change *)vector_at(&lowering->then_values, i);
+            set_value(lowering, value.symbol, value.value);
+        }
+    }
+    while (vector_length(&lowering->then_values) > branch.then_begin) {
+        vector_pop_back(&lowering->then_values, NULL);
+    }
+}
+
+static const IrOpcode binary_opcodes[] = {
+    [ADDITION] = IR_ADD,
+    [SUBTRACTION] = IR_SUB,
+    [MULTIPLICATION] = IR_MUL,
+    [GREATER] = IR_GT,
+    [LESS] = IR_LT,
+    [AND] = IR_AND,
+    [OR] = IR_OR,
+    [EQUALS] = IR_EQ,
+    [GREATER_EQUALS] = IR_GE,
+    [LESS_EQUALS] = IR_LE,
+};
+
+static const IrOpcode unary_opcodes[] = {
+    [NEGATION] = IR_NEG,
+    [BITWISE_NEGATION] = IR_NOT,
+    [LOGICAL_NEGATION] = IR_LOGICAL_NOT,
+};
+
+static void lower_call(Lowering *lowering, Syntax *syntax) {
+    Syntax *arguments = syntax->function_call.function_arguments;
+    int count = arguments ? list_length(arguments->function_arguments.arguments) : 0;
+    IrCall *call = arena_alloc(lowering->program->arena, sizeof(IrCall) + count * sizeof(int));
+    call->callee = syntax->function_call.function_name;
+    call->argument_count = count;
+    for (int i = count - 1; i >= 0; i--) {
+        call->arguments[i] = pop_value(lowering);
+    }
+    int reg = emit(lowering, IR_CALL, IR_NONE, IR_NONE);
+    IrBlock *block = &lowering->function->blocks[lowering->block];
+    block->instructions[block->count - 1].call = call;
+    push_value(lowering, reg);
+}
+
+static void lower_leave(Walker *walker, WalkFrame *frame) {
+    Lowering *lowering = walker->data;
+    Syntax *syntax = frame->node;
+
+    switch (syntax->type) {
+        case UNARY_OPERATOR: {
+            int operand = pop_value(lowering);
+            push_value(lowering, emit(lowering, unary_opcodes[syntax->unary_expression.unary_type], operand, IR_NONE));
+            break;
+        }
+        case BINARY_OPERATOR: {
+            int right = pop_value(lowering);
+            int left = pop_value(lowering);
+            push_value(lowering, emit(lowering, binary_opcodes[syntax->binary_expression.binary_type], left, right));
+            break;
+        }
+        case FUNCTION_CALL:
+            lower_call(lowering, syntax);
+            break;
+        case ARRAY_ACCESS: {
+            int index = pop_value(lowering);
+            check_index(lowering, syntax, index);
+            push_value(lowering, load_element(lowering, syntax->array_access.symbol, index));
+            break;
+        }
+        case ARRAY_ASSIGNMENT: {
+            int value = pop_value(lowering);
+            int index = pop_value(lowering);
+            check_index(lowering, syntax, index);
+            store_element(lowering, find_array(lowering, syntax->array_assignment.array_name), index, value);
+            break;
+        }
+        case DEFINE_VAR:
+            if (syntax->define_var_statement.symbol->type != TYPE_ARRAY) {
+                set_value(lowering, syntax->define_var_statement.symbol, pop_value(lowering));
+            }
+            break;
+        case ASSIGNMENT: {
+            Symbol *symbol = syntax->assignment.symbol;
+            int value = pop_value(lowering);
+            if (symbol->type == TYPE_ARRAY) {
+                store_element(lowering, symbol, emit_constant(lowering, 0), value);
+            } else {
+                set_value(lowering, symbol, value);
+            }
+            break;
+        }
+        case PRINT_STATEMENT:
+            emit(lowering, IR_PRINT, pop_value(lowering), IR_NONE);
+            break;
+        case RETURN_STATEMENT: {
+            int value = syntax->return_statement.expression ? pop_value(lowering) : IR_NONE;
+            emit(lowering, IR_RETURN, value, IR_NONE);
+            ir_block_trim(lowering->function, lowering->block);
+            lowering->block = IR_NONE;
+            break;
+        }
+        case IF_STATEMENT:
+            join_branches(lowering);
+            break;
+        case BLOCK:
+            while (vector_length(&lowering->values) > 0) {
+                vector_pop_back(&lowering->values, NULL);
+            }
+            while (vector_length(&lowering->arrays) > (size_t)frame->value) {
+                vector_pop_back(&lowering->arrays, NULL);
+            }
+            break;
+        case FUNCTION:
+            // Falling off the end returns nothing in particular.
+            if (lowering->block != IR_NONE) {
+                emit(lowering, IR_RETURN, IR_NONE, IR_NONE);
+                ir_block_trim(lowering->function, lowering->block);
+            }
+            lowering->function = NULL;
+            break;
+        default:
+            break;
+    }
+}
+
+IrProgram *lower_syntax(Syntax *syntax, Context *ctx) {
+    if (ctx->bounds_checks != NULL) {
+        analyze_ranges(ctx->bounds_checks, syntax);
+    }
+
+    Lowering lowering;
+    lowering.program = ir_program_new();
+    lowering.program->whole = ctx->whole_program;
+    lowering.ctx = ctx;
+    lowering.function = NULL;
+    lowering.block = IR_NONE;
+    vector_init(&lowering.values, sizeof(int), NULL);
+    vector_init(&lowering.changes, sizeof(Change), NULL);
+    vector_init(&lowering.then_values, sizeof(Change), NULL);
+    vector_init(&lowering.branches, sizeof(Branch), NULL);
+    vector_init(&lowering.arrays, sizeof(Symbol *), NULL);
+
+    Walker walker = { lower_enter, lower_before_child, lower_leave, &lowering };
+    walk_syntax(&walker, syntax);
+
+    vector_release(&lowering.values);
+    vector_release(&lowering.changes);
+    vector_release(&lowering.then_values);
+    vector_release(&lowering.branches);
+    vector_release(&lowering.arrays);
+    return lowering.program;
+}
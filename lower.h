@@ -0,0 +1,14 @@
+#include "syntax.h"
+#include "context.h"
+#include "ir.h"
+
+#ifndef LOWER_HEADER
+#define LOWER_HEADER
+
+/* Translate an analyzed tree, such as a TOP_LEVEL, into IR, one function
+ * per FUNCTION. If ctx checks bounds, every array access not proven in
+ * range is preceded by a CHECK.
+ */
+IrProgram *lower_syntax(Syntax *syntax, Context *ctx);
+
+#endif
@@ -4,12 +4,20 @@
 #include <unistd.h>
 #include <assert.h>
 #include <err.h>
+#include <sys/resource.h>
 
-#include "stack.h"
 #include "syntax.h"
+#include "flat.h"
+#include "cache.h"
+#include "lexer.h"
+#include "compilation.h"
 #include "build/y.tab.h"
 #include "semantic.h"
+#include "eval.h"
 #include "assembly.h"
+#include "lower.h"
+#include "opt.h"
+#include "inline.h"
 
 void print_help()
 {
@@ -20,79 +28,202 @@ void print_help()
     printf("    $ dd --dump-tokens foo.dd\n");
     printf("To output the AST without compiling:\n");
     printf("    $ dd --dump-ast foo.dd\n");
+    printf("To parse and analyze with N threads:\n");
+    printf("    $ dd -j N foo.dd\n");
+    printf("To compile one function at a time, bounding memory use:\n");
+    printf("    $ dd --stream foo.dd\n");
+    printf("To run parsing, analysis and code generation on separate threads:\n");
+    printf("    $ dd --pipeline foo.dd\n");
+    printf("To save the parsed AST to build/foo.ddast, and reuse it while foo.dd is unchanged:\n");
+    printf("    $ dd --emit-ast-cache foo.dd\n");
+    printf("To output the IR without compiling, checking its invariants:\n");
+    printf("    $ dd --emit-ir foo.dd\n");
+    printf("To trap on array indices out of range, except where they are proven in range:\n");
+    printf("    $ dd --bounds-check foo.dd\n");
+    printf("To optimize at level N, from 0, the default, to 2:\n");
+    printf("    $ dd -ON foo.dd\n");
+    printf("To let inlining at -O2 grow a caller by up to N instructions a call:\n");
+    printf("    $ dd -O2 -finline-limit=N foo.dd\n");
+    printf("To report peak memory use, and the time each optimization pass takes and what it removes:\n");
+    printf("    $ dd --stats foo.dd\n");
     printf("To print this message:\n");
     printf("    $ dd --help\n\n");
 }
 
-extern Stack *syntax_stack;
-
-extern int yyparse(void);
-extern FILE *yyin;
-extern int yylex(void);
-
 typedef enum
 {
     TOKENIZE,
     PARSE,
+    EMIT_IR,
     EMIT_ASM,
 } stage_t;
 
+void print_stats()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    long peak_kb = usage.ru_maxrss / 1024; // Bytes on macOS
+#else
+    long peak_kb = usage.ru_maxrss;
+#endif
+    printf("Peak RSS: %ld KB\n", peak_kb);
+}
+
+/* Print the IR of an analyzed tree, returning 1 if it fails to verify. */
+int dump_ir(Compilation *compilation, Syntax *syntax)
+{
+    Context *ctx = codegen_context_new(compilation);
+    ctx->whole_program = 1;
+    IrProgram *program = lower_syntax(syntax, ctx);
+    optimize_program(program, ctx->optimize, ctx->inline_limit, &ctx->opt_stats);
+    printf("---IR---\n");
+    ir_print(stdout, program);
+    int errors = 0;
+    for (int i = 0; i < program->function_count; i++)
+    {
+        errors += ir_verify(program->functions[i]);
+    }
+    ir_program_free(program);
+    codegen_context_free(compilation, ctx);
+    return errors > 0;
+}
+
 int main(int argc, char *argv[])
 {
     ++argv, --argc; /* Skip over program name. */
 
     stage_t terminate_at = EMIT_ASM;
 
-    check_target_architecture();
+    char *file_name = NULL;
+    int jobs = 1;
+    int stream = 0;
+    int pipeline = 0;
+    int stats = 0;
+    int ast_cache = 0;
+    int bounds_check = 0;
+    int optimize = 0;
+    int inline_limit = DEFAULT_INLINE_LIMIT;
 
-    char *file_name;
-
-    if (argc == 1 && strcmp(argv[0], "--help") == 0)
+    for (int i = 0; i < argc; i++)
     {
-        print_help();
-        return 0;
+        if (strcmp(argv[i], "--help") == 0)
+        {
+            print_help();
+            return 0;
+        }
+        else if (strcmp(argv[i], "--dump-tokens") == 0)
+        {
+            terminate_at = TOKENIZE;
+        }
+        else if (strcmp(argv[i], "--dump-ast") == 0)
+        {
+            terminate_at = PARSE;
+        }
+        else if (strcmp(argv[i], "--emit-ir") == 0)
+        {
+            terminate_at = EMIT_IR;
+        }
+        else if (strcmp(argv[i], "--stream") == 0)
+        {
+            stream = 1;
+        }
+        else if (strcmp(argv[i], "--pipeline") == 0)
+        {
+            pipeline = 1;
+        }
+        else if (strcmp(argv[i], "--stats") == 0)
+        {
+            stats = 1;
+        }
+        else if (strcmp(argv[i], "--emit-ast-cache") == 0)
+        {
+            ast_cache = 1;
+        }
+        else if (strcmp(argv[i], "--bounds-check") == 0)
+        {
+            bounds_check = 1;
+        }
+        else if (strncmp(argv[i], "-O", 2) == 0 && argv[i][2] >= '0' && argv[i][2] <= '2' && argv[i][3] == '\0')
+        {
+            optimize = argv[i][2] - '0';
+        }
+        else if (strncmp(argv[i], "-finline-limit=", 15) == 0)
+        {
+            inline_limit = atoi(argv[i] + 15);
+        }
+        else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+        {
+            jobs = atoi(argv[++i]);
+        }
+        else if (strncmp(argv[i], "-j", 2) == 0 && argv[i][2] != '\0')
+        {
+            jobs = atoi(argv[i] + 2);
+        }
+        else if (argv[i][0] != '-' && file_name == NULL)
+        {
+            file_name = argv[i];
+        }
+        else
+        {
+            print_help();
+            return 1;
+        }
     }
-    else if (argc == 1)
+
+    if (file_name == NULL || jobs < 1)
     {
-        file_name = argv[0];
+        print_help();
+        return 1;
     }
-    else if (argc == 2 && strcmp(argv[0], "--dump-tokens") == 0)
+
+    int result;
+    SemanticAnalyzer *analyzer = NULL;
+
+    int cached = 0;
+
+    char *filename = strrchr(file_name, '/');
+    char output_file[100];
+    char cache_file[100];
+    if (filename == NULL)
+        filename = file_name;
+    else
+        filename++;
+
+    // Leave file_name intact: the compilation keeps referring to it.
+    snprintf(output_file, sizeof(output_file), "build/%.*s.asm", (int)strlen(filename) - 3, filename);
+    snprintf(cache_file, sizeof(cache_file), "build/%.*s.ddast", (int)strlen(filename) - 3, filename);
+
+    // Streaming and pipelining interleave parsing with the later stages,
+    // so they always parse.
+    AstCache *cache = NULL;
+    if (ast_cache && terminate_at != TOKENIZE && !stream && !pipeline)
     {
-        terminate_at = TOKENIZE;
-        file_name = argv[1];
+        cache = ast_cache_open(cache_file, file_name);
     }
-    else if (argc == 2 && strcmp(argv[0], "--dump-ast") == 0)
+
+    Compilation *compilation;
+    if (cache != NULL)
     {
-        terminate_at = PARSE;
-        file_name = argv[1];
+        compilation = compilation_new_from_flat(file_name, &cache->flat);
+        ast_cache_close(cache);
+        cached = 1;
     }
     else
     {
-        print_help();
-        return 1;
+        compilation = compilation_new(file_name);
     }
 
-    int result;
-
-    yyin = fopen(file_name, "r");
-
-    if (yyin == NULL)
+    if (compilation == NULL)
     {
         printf("Could not open file: '%s'\n", file_name);
         result = 2;
         goto cleanup_file;
     }
 
-    char *filename = strrchr(file_name, '/');
-    char output_file[100];
-    if (filename == NULL)
-        filename = file_name;
-    else
-        filename++;
-
-    strcpy(filename + strlen(filename) - 3, ".asm");
-    strcpy(output_file, "build/");
-    strcat(output_file, filename);
+    compilation->bounds_check = bounds_check;
+    compilation->optimize = optimize;
+    compilation->inline_limit = inline_limit;
 
     if (terminate_at == TOKENIZE)
     {
@@ -100,7 +231,8 @@ int main(int argc, char *argv[])
         printf("Tokens \n");
         int token_count = 0;
 
-        while ((tokens = yylex()) != 0)
+        YYSTYPE value;
+        while ((tokens = lexer_next(&compilation->lexer, &value)) != 0)
         {
             printf("%-10sToken: %-4d\n", "", tokens);
             token_count++;
@@ -113,59 +245,101 @@ int main(int argc, char *argv[])
         goto cleanup_file;
     }
 
-    syntax_stack = stack_new();
-
-    result = yyparse();
-
-    if (result != 0)
+    if (stream && terminate_at == EMIT_ASM)
     {
-        goto cleanup_syntax;
+        analyzer = semantic_analyzer_new();
+        result = compilation_stream(compilation, analyzer, output_file);
     }
-
-    Syntax *complete_syntax = stack_pop(syntax_stack);
-    if (syntax_stack->size > 0)
+    else if (pipeline && terminate_at == EMIT_ASM)
     {
-        warnx("Did not consume the whole syntax stack during parsing! Remaining:");
-        while (syntax_stack->size > 0)
+        analyzer = semantic_analyzer_new();
+        result = compilation_pipeline(compilation, analyzer, output_file);
+    }
+    else if (!cached)
+    {
+        result = compilation_parse_parallel(compilation, jobs);
+        if (result == 0 && ast_cache)
         {
-            fprintf(stderr, "%s", syntax_type_name(stack_pop(syntax_stack)));
+            FlatSyntax *flat = flat_syntax_build(compilation->syntax);
+            if (ast_cache_write(flat, cache_file, file_name) != 0)
+            {
+                warnx("Could not write AST cache %s", cache_file);
+            }
+            flat_syntax_free(flat);
         }
     }
+    else
+    {
+        result = 0;
+    }
+
+    if (result != 0)
+    {
+        goto cleanup_file;
+    }
+
+    Syntax *complete_syntax = compilation->syntax;
     printf("\n \n");
     if (terminate_at == PARSE)
     {
         printf("---AST---\n");
-        print_syntax(complete_syntax);
+        FlatSyntax *flat = flat_syntax_build(complete_syntax);
+        print_flat_syntax(flat);
+        flat_syntax_free(flat);
     }
     else
     {
-        // Perform semantic analysis
-        SemanticAnalyzer *analyzer = semantic_analyzer_new();
-        analyze_semantics(analyzer, complete_syntax);
+        // Perform semantic analysis, unless streaming already did
+        if (analyzer == NULL)
+        {
+            analyzer = semantic_analyzer_new();
+            analyze_semantics_parallel(analyzer, complete_syntax, jobs);
+        }
         List *errors = get_semantic_errors(analyzer);
         if (list_length(errors) > 0) {
             printf("Semantic errors found:\n");
             for (int i = 0; i < list_length(errors); i++) {
                 printf("%s\n", (char *)list_get(errors, i));
             }
-            semantic_analyzer_free(analyzer);
             result = 1;
-            goto cleanup_syntax;
+            goto cleanup_file;
+        }
+        if (terminate_at == EMIT_IR)
+        {
+            fold_pure_calls(analyzer, complete_syntax);
+            result = dump_ir(compilation, complete_syntax);
+            goto cleanup_file;
+        }
+        // Streaming and pipelining free each function once it is
+        // emitted, so only a serial compilation can fold pure calls.
+        if (!stream && !pipeline)
+        {
+            fold_pure_calls(analyzer, complete_syntax);
+            write_assembly(compilation, output_file);
         }
-        semantic_analyzer_free(analyzer);
-        write_assembly(complete_syntax, output_file);
-        syntax_free(complete_syntax); // Move here
 
         printf("Written %s.\n", output_file);
+        if (bounds_check)
+        {
+            printf("Bounds checks: %d emitted, %d proven safe.\n",
+                   compilation->checks_emitted, compilation->checks_elided);
+        }
     }
 
-cleanup_syntax:
-    stack_free(syntax_stack);
-
 cleanup_file:
-    if (yyin != NULL)
+    if (stats && optimize > 0 && result == 0)
+    {
+        opt_stats_print(stdout, &compilation->opt_stats);
+    }
+    if (analyzer != NULL)
+    {
+        semantic_analyzer_free(analyzer);
+    }
+    compilation_free(compilation);
+
+    if (stats)
     {
-        fclose(yyin);
+        print_stats();
     }
 
     return result;
@@ -0,0 +1,1183 @@
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "opt.h"
+#include "callgraph.h"
+#include "inline.h"
+#include "ipa.h"
+
+
+static long instruction_count(IrFunction *function) {
+    long count = 0;
+    for (int b = 0; b < function->block_count; b++) {
+        count += function->blocks[b].count;
+    }
+    return count;
+}
+
+/* Every predecessor comes earlier, as lowering leaves blocks. Passes keep
+ * to that order, but check it before relying on it.
+ */
+static int is_topological(IrFunction *function) {
+    for (int b = 0; b < function->block_count; b++) {
+        IrBlock *block = &function->blocks[b];
+        for (int i = 0; i < block->predecessor_count; i++) {
+            if (block->predecessors[i] >= b) return 0;
+        }
+    }
+    return 1;
+}
+
+/* Remove the edge into block from predecessor, with its phi operands. */
+static void remove_edge(IrFunction *function, int block, int predecessor) {
+    IrBlock *b = &function->blocks[block];
+    int edge = 0;
+    while (b->predecessors[edge] != predecessor) edge++;
+    int after = b->predecessor_count - edge - 1;
+    memmove(&b->predecessors[edge], &b->predecessors[edge + 1], after * sizeof(int));
+    for (int i = 0; i < b->count && b->instructions[i].opcode == IR_PHI; i++) {
+        int *incoming = b->instructions[i].incoming;
+        memmove(&incoming[edge], &incoming[edge + 1], after * sizeof(int));
+    }
+    b->predecessor_count--;
+}
+
+static int has_phis(IrBlock *block) {
+    return block->count > 0 && block->instructions[0].opcode == IR_PHI;
+}
+
+/* Drop the blocks control can no longer reach, turn the phis of blocks
+ * left with one predecessor into plain uses of their operands, send the
+ * edges into empty blocks on to where they jump, and merge each block
+ * into a predecessor that only jumps to it. The blocks keep their order,
+ * so each still follows its predecessors.
+ */
+static void simplify_cfg(IrFunction *function) {
+    int n = function->block_count;
+    char *reachable = calloc(n, 1);
+    int *stack = malloc(n * sizeof(int));
+    int depth = 0;
+    stack[depth++] = 0;
+    reachable[0] = 1;
+    while (depth > 0) {
+        IrBlock *block = &function->blocks[stack[--depth]];
+        int targets[2];
+        for (int j = ir_successors(&block->instructions[block->count - 1], targets) - 1; j >= 0; j--) {
+            if (!reachable[targets[j]]) {
+                reachable[targets[j]] = 1;
+                stack[depth++] = targets[j];
+            }
+        }
+    }
+    free(stack);
+    for (int b = 0; b < n; b++) {
+        IrBlock *block = &function->blocks[b];
+        if (!reachable[b]) {
+            int targets[2];
+            for (int j = ir_successors(&block->instructions[block->count - 1], targets) - 1; j >= 0; j--) {
+                if (reachable[targets[j]]) remove_edge(function, targets[j], b);
+            }
+        }
+    }
+
+    int *map = ir_identity_map(function);
+    int mapped = 0;
+    for (int b = 1; b < n; b++) {
+        IrBlock *block = &function->blocks[b];
+        if (reachable[b] && block->predecessor_count == 1 && has_phis(block)) {
+            int phis = 0;
+            while (block->instructions[phis].opcode == IR_PHI) {
+                map[block->instructions[phis].dest] = block->instructions[phis].incoming[0];
+                phis++;
+            }
+            memmove(block->instructions, &block->instructions[phis], (block->count - phis) * sizeof(IrInstruction));
+            block->count -= phis;
+            mapped = 1;
+        }
+    }
+    if (mapped) {
+        ir_replace_registers(function, map);
+    }
+    free(map);
+
+    // Without phis in the way, a branch whose arms both come to nothing
+    // becomes a jump.
+    for (int e = 1; e < n; e++) {
+        IrBlock *empty = &function->blocks[e];
+        if (!reachable[e] || empty->count != 1 || empty->instructions[0].opcode != IR_JUMP) continue;
+        int t = empty->instructions[0].targets[0];
+        if (t == e || has_phis(&function->blocks[t])) continue;
+        remove_edge(function, t, e);
+        for (int i = 0; i < empty->predecessor_count; i++) {
+            int p = empty->predecessors[i];
+            IrInstruction *last = &function->blocks[p].instructions[function->blocks[p].count - 1];
+            if (last->opcode == IR_BRANCH && (last->targets[0] == t || last->targets[1] == t)) {
+                last->opcode = IR_JUMP;
+                last->operands[0] = IR_NONE;
+                last->targets[0] = t;
+                last->targets[1] = IR_NONE;
+            } else {
+                last->targets[last->targets[0] == e ? 0 : 1] = t;
+                ir_add_predecessor(function, t, p);
+            }
+        }
+        empty->predecessor_count = 0;
+        reachable[e] = 0;
+    }
+
+    for (int a = 0; a < n; a++) {
+        if (!reachable[a]) continue;
+        IrBlock *block = &function->blocks[a];
+        for (;;) {
+            IrInstruction *last = &block->instructions[block->count - 1];
+            int t = last->targets[0];
+            if (last->opcode != IR_JUMP || t == a || function->blocks[t].predecessor_count != 1) break;
+            IrBlock *next = &function->blocks[t];
+            block->count--;
+            if (block->count + next->count > block->capacity) {
+                block->capacity = block->count + next->count;
+                block->instructions = realloc(block->instructions, block->capacity * sizeof(IrInstruction));
+            }
+            memcpy(&block->instructions[block->count], next->instructions, next->count * sizeof(IrInstruction));
+            block->count += next->count;
+
+            int targets[2];
+            for (int j = ir_successors(&next->instructions[next->count - 1], targets) - 1; j >= 0; j--) {
+                IrBlock *successor = &function->blocks[targets[j]];
+                for (int k = 0; k < successor->predecessor_count; k++) {
+                    if (successor->predecessors[k] == t) successor->predecessors[k] = a;
+                }
+            }
+            reachable[t] = 0;
+        }
+    }
+
+    // Number the blocks left, in order, and move them down.
+    int *number = malloc(n * sizeof(int));
+    int count = 0;
+    for (int b = 0; b < n; b++) {
+        if (reachable[b]) {
+            number[b] = count;
+            function->blocks[count++] = function->blocks[b];
+        } else {
+            free(function->blocks[b].instructions);
+            free(function->blocks[b].predecessors);
+        }
+    }
+    function->block_count = count;
+    for (int b = 0; b < count; b++) {
+        IrBlock *block = &function->blocks[b];
+        IrInstruction *last = &block->instructions[block->count - 1];
+        if (last->opcode == IR_BRANCH || last->opcode == IR_JUMP) {
+            last->targets[0] = number[last->targets[0]];
+            if (last->opcode == IR_BRANCH) last->targets[1] = number[last->targets[1]];
+        }
+        for (int i = 0; i < block->predecessor_count; i++) {
+            block->predecessors[i] = number[block->predecessors[i]];
+        }
+    }
+    free(number);
+    free(reachable);
+}
+
+/* The value of a register in constant propagation: unknown until some
+ * path reaching its definition is found, then one constant, or varying.
+ */
+enum { UNKNOWN, CONSTANT, VARYING };
+
+typedef struct Lattice {
+    int state;
+    long value;
+} Lattice;
+
+/* Move cell down the lattice to meet state and value, returning 1 if it
+ * moved.
+ */
+static int lower(Lattice *cell, int state, long value) {
+    if (state == UNKNOWN || cell->state == VARYING) return 0;
+    if (cell->state == CONSTANT && state == CONSTANT && cell->value == value) return 0;
+    cell->state = cell->state == UNKNOWN ? state : VARYING;
+    cell->value = value;
+    return 1;
+}
+
+/* Evaluate an operation on constants as the generated code would, on
+ * 64-bit words that wrap.
+ */
+static long fold(IrOpcode opcode, long left, long right) {
+    unsigned long a = (unsigned long)left, b = (unsigned long)right;
+    switch (opcode) {
+        case IR_NEG: return (long)(0 - a);
+        case IR_NOT: return ~left;
+        case IR_LOGICAL_NOT: return left == 0;
+        case IR_ADD: return (long)(a + b);
+        case IR_SUB: return (long)(a - b);
+        case IR_MUL: return (long)(a * b);
+        case IR_AND: return left & right;
+        case IR_OR: return left | right;
+        case IR_EQ: return left == right;
+        case IR_GT: return left > right;
+        case IR_LT: return left < right;
+        case IR_GE: return left >= right;
+        case IR_LE: return left <= right;
+        default: return 0;
+    }
+}
+
+/* Whether control may pass along the edge from block from to block to. */
+static int edge_taken(IrFunction *function, Lattice *values, char *reachable, int from, int to) {
+    if (!reachable[from]) return 0;
+    IrBlock *block = &function->blocks[from];
+    IrInstruction *last = &block->instructions[block->count - 1];
+    if (last->opcode != IR_BRANCH) return 1;
+    Lattice condition = values[last->operands[0]];
+    if (condition.state != CONSTANT) return condition.state == VARYING;
+    return last->targets[condition.value != 0 ? 0 : 1] == to;
+}
+
+/* Sparse conditional constant propagation (Wegman and Zadeck): find the
+ * registers that hold one constant on every path control can take,
+ * counting only the arms of branches their conditions allow. Those
+ * registers become constants, branches on constants become jumps, and
+ * the arms never taken are dropped.
+ */
+static void propagate_constants(IrFunction *function) {
+    int n = function->block_count;
+    Lattice *values = calloc(function->register_count > 0 ? function->register_count : 1, sizeof(Lattice));
+    char *reachable = calloc(n, 1);
+    reachable[0] = 1;
+
+    // With blocks after their predecessors one sweep settles everything,
+    // and a second finds nothing left to change.
+    int changed = 1;
+    while (changed) {
+        changed = 0;
+        for (int b = 0; b < n; b++) {
+            IrBlock *block = &function->blocks[b];
+            for (int i = 0; i < block->predecessor_count && !reachable[b]; i++) {
+                if (edge_taken(function, values, reachable, block->predecessors[i], b)) {
+                    reachable[b] = 1;
+                    changed = 1;
+                }
+            }
+            if (!reachable[b]) continue;
+
+            for (int i = 0; i < block->count; i++) {
+                IrInstruction *instruction = &block->instructions[i];
+                if (instruction->dest == IR_NONE) continue;
+                Lattice result = {UNKNOWN, 0};
+                switch (instruction->opcode) {
+                    case IR_CONST:
+                        result = (Lattice){CONSTANT, instruction->immediate};
+                        break;
+                    case IR_PARAM:
+                    case IR_LOAD:
+                    case IR_CALL:
+                        result.state = VARYING;
+                        break;
+                    case IR_PHI:
+                        for (int j = 0; j < block->predecessor_count; j++) {
+                            if (edge_taken(function, values, reachable, block->predecessors[j], b)) {
+                                Lattice incoming = values[instruction->incoming[j]];
+                                lower(&result, incoming.state, incoming.value);
+                            }
+                        }
+                        break;
+                    default: {
+                        int operands = ir_operand_count(instruction->opcode);
+                        Lattice left = values[instruction->operands[0]];
+                        Lattice right = operands > 1 ? values[instruction->operands[1]] : (Lattice){CONSTANT, 0};
+                        int absorbing = (instruction->opcode == IR_MUL || instruction->opcode == IR_AND)
+                            && ((left.state == CONSTANT && left.value == 0) || (right.state == CONSTANT && right.value == 0));
+                        if (absorbing) {
+                            result = (Lattice){CONSTANT, 0};
+                        } else if (left.state == VARYING || right.state == VARYING) {
+                            result.state = VARYING;
+                        } else if (left.state == CONSTANT && right.state == CONSTANT) {
+                            result = (Lattice){CONSTANT, fold(instruction->opcode, left.value, right.value)};
+                        }
+                        break;
+                    }
+                }
+                changed |= lower(&values[instruction->dest], result.state, result.value);
+            }
+        }
+    }
+
+    for (int b = 0; b < n; b++) {
+        IrBlock *block = &function->blocks[b];
+        if (!reachable[b]) continue;
+
+        // Phis found constant become constants, after the phis left.
+        int phis = 0;
+        while (phis < block->count && block->instructions[phis].opcode == IR_PHI) phis++;
+        IrInstruction *constant_phis = malloc((phis > 0 ? phis : 1) * sizeof(IrInstruction));
+        int kept = 0, constants = 0;
+        for (int i = 0; i < phis; i++) {
+            IrInstruction *phi = &block->instructions[i];
+            if (values[phi->dest].state == CONSTANT) {
+                constant_phis[constants++] = *phi;
+            } else {
+                block->instructions[kept++] = *phi;
+            }
+        }
+        for (int i = 0; i < constants; i++) {
+            block->instructions[kept + i] = constant_phis[i];
+        }
+        free(constant_phis);
+
+        for (int i = 0; i < block->count; i++) {
+            IrInstruction *instruction = &block->instructions[i];
+            if (instruction->dest != IR_NONE && instruction->opcode != IR_CONST
+                && values[instruction->dest].state == CONSTANT) {
+                instruction->opcode = IR_CONST;
+                instruction->operands[0] = IR_NONE;
+                instruction->operands[1] = IR_NONE;
+                instruction->immediate = values[instruction->dest].value;
+            }
+        }
+
+        IrInstruction *last = &block->instructions[block->count - 1];
+        if (last->opcode == IR_BRANCH && values[last->operands[0]].state == CONSTANT) {
+            int taken = values[last->operands[0]].value != 0 ? 0 : 1;
+            int untaken = last->targets[1 - taken];
+            last->opcode = IR_JUMP;
+            last->operands[0] = IR_NONE;
+            last->targets[0] = last->targets[taken];
+            last->targets[1] = IR_NONE;
+            remove_edge(function, untaken, b);
+        }
+    }
+    free(values);
+    free(reachable);
+    simplify_cfg(function);
+}
+
+/* Operations already computed, keyed by opcode, operands and immediate,
+ * in a hash table that can forget everything added since a mark.
+ */
+typedef struct ValueEntry {
+    IrOpcode opcode;
+    int operands[2];
+    long immediate;
+    int value;
+    int next; // In its bucket, or -1
+} ValueEntry;
+
+typedef struct ValueTable {
+    int *buckets;
+    unsigned long mask;
+    ValueEntry *entries;
+    int count;
+    int capacity;
+} ValueTable;
+
+static void table_init(ValueTable *table, int expected) {
+    unsigned long size = 16;
+    while (size < (unsigned long)expected * 2) size *= 2;
+    table->buckets = malloc(size * sizeof(int));
+    memset(table->buckets, -1, size * sizeof(int));
+    table->mask = size - 1;
+    table->entries = NULL;
+    table->count = 0;
+    table->capacity = 0;
+}
+
+static void table_free(ValueTable *table) {
+    free(table->buckets);
+    free(table->entries);
+}
+
+static unsigned long table_hash(ValueTable *table, IrOpcode opcode, int left, int right, long immediate) {
+    unsigned long h = (unsigned long)opcode * 0x9e3779b97f4a7c15UL;
+    h = (h ^ (unsigned int)left) * 0xff51afd7ed558ccdUL;
+    h = (h ^ (unsigned int)right) * 0xc4ceb9fe1a85ec53UL;
+    h = (h ^ (unsigned long)immediate) * 0x9e3779b97f4a7c15UL;
+    return (h >> 32) & table->mask;
+}
+
+static int table_find(ValueTable *table, IrOpcode opcode, int left, int right, long immediate) {
+    int i = table->buckets[table_hash(table, opcode, left, right, immediate)];
+    for (; i >= 0; i = table->entries[i].next) {
+        ValueEntry *entry = &table->entries[i];
+        if (entry->opcode == opcode && entry->operands[0] == left && entry->operands[1] == right
+            && entry->immediate == immediate) {
+            return entry->value;
+        }
+    }
+    return IR_NONE;
+}
+
+static void table_add(ValueTable *table, IrOpcode opcode, int left, int right, long immediate, int value) {
+    if (table->count == table->capacity) {
+        table->capacity = table->capacity > 0 ? table->capacity * 2 : 64;
+        table->entries = realloc(table->entries, table->capacity * sizeof(ValueEntry));
+    }
+    unsigned long h = table_hash(table, opcode, left, right, immediate);
+    table->entries[table->count] = (ValueEntry){opcode, {left, right}, immediate, value, table->buckets[h]};
+    table->buckets[h] = table->count++;
+}
+
+/* Forget the entries added since mark. Each is still first in its bucket. */
+static void table_pop(ValueTable *table, int mark) {
+    while (table->count > mark) {
+        ValueEntry *entry = &table->entries[--table->count];
+        table->buckets[table_hash(table, entry->opcode, entry->operands[0], entry->operands[1], entry->immediate)] = entry->next;
+    }
+}
+
+static int is_commutative(IrOpcode opcode) {
+    return opcode == IR_ADD || opcode == IR_MUL || opcode == IR_AND || opcode == IR_OR || opcode == IR_EQ;
+}
+
+/* Replace each pure operation computed again where an earlier one
+ * dominates it with that earlier result, walking the dominator tree with
+ * the computations in scope. Loads are reused, and stored values
+ * forwarded, only within a block and until the next store to the array.
+ */
+static void number_values(IrFunction *function) {
+    int n = function->block_count;
+    int *map = ir_identity_map(function);
+    ValueTable table;
+    table_init(&table, function->register_count);
+    int *generation = calloc(function->array_count > 0 ? function->array_count : 1, sizeof(int));
+    int generations = 0;
+
+    // Immediate dominators; with predecessors first, block numbers order
+    // them as Cooper, Harvey and Kennedy's intersection needs. Otherwise
+    // each block is taken on its own.
+    int topological = is_topological(function);
+    int *idom = malloc(n * sizeof(int));
+    idom[0] = IR_NONE;
+    for (int b = 1; b < n; b++) {
+        IrBlock *block = &function->blocks[b];
+        int dominator = topological && block->predecessor_count > 0 ? block->predecessors[0] : IR_NONE;
+        for (int i = 1; i < block->predecessor_count && dominator != IR_NONE; i++) {
+            int other = block->predecessors[i];
+            while (dominator != other && dominator != IR_NONE && other != IR_NONE) {
+                if (dominator > other) dominator = idom[dominator];
+                else other = idom[other];
+            }
+            if (dominator != other) dominator = IR_NONE;
+        }
+        idom[b] = dominator;
+    }
+    int *first_child = calloc(n + 1, sizeof(int));
+    int *children = malloc(n * sizeof(int));
+    int *next_child = calloc(n, sizeof(int));
+    for (int b = 1; b < n; b++) if (idom[b] != IR_NONE) first_child[idom[b] + 1]++;
+    for (int b = 0; b < n; b++) first_child[b + 1] += first_child[b];
+    for (int b = 1; b < n; b++) {
+        if (idom[b] != IR_NONE) children[first_child[idom[b]] + next_child[idom[b]]++] = b;
+    }
+    for (int b = 0; b < n; b++) next_child[b] = 0;
+
+    int *stack = malloc(n * sizeof(int));
+    int *marks = malloc(n * sizeof(int));
+    for (int root = 0; root < n; root++) {
+        if (idom[root] != IR_NONE) continue;
+        int depth = 0;
+        stack[depth++] = root;
+        int entering = 1;
+        while (depth > 0) {
+            int b = stack[depth - 1];
+            if (entering) {
+                marks[b] = table.count;
+                IrBlock *block = &function->blocks[b];
+                int kept = 0;
+                for (int i = 0; i < block->count; i++) {
+                    IrInstruction *instruction = &block->instructions[i];
+                    IrOpcode opcode = instruction->opcode;
+                    int operands = ir_operand_count(opcode);
+                    for (int j = 0; j < operands; j++) {
+                        if (instruction->operands[j] != IR_NONE) {
+                            instruction->operands[j] = ir_find(map, instruction->operands[j]);
+                        }
+                    }
+                    int left = instruction->operands[0], right = instruction->operands[1];
+                    long immediate = instruction->immediate;
+                    int reusable = instruction->dest != IR_NONE && opcode != IR_PHI && opcode != IR_CALL;
+                    if (opcode == IR_LOAD || opcode == IR_STORE) {
+                        right = generation[instruction->array];
+                        immediate = (long)b << 32 | instruction->array;
+                    } else if (reusable && is_commutative(opcode) && left > right) {
+                        left = instruction->operands[1];
+                        right = instruction->operands[0];
+                    }
+                    if (opcode == IR_STORE) {
+                        generation[instruction->array] = ++generations;
+                        table_add(&table, IR_LOAD, left, generations, immediate, instruction->operands[1]);
+                    } else if (reusable) {
+                        int earlier = table_find(&table, opcode, left, right, immediate);
+                        if (earlier != IR_NONE) {
+                            map[instruction->dest] = earlier;
+                            continue;
+                        }
+                        table_add(&table, opcode, left, right, immediate, instruction->dest);
+                    }
+                    block->instructions[kept++] = *instruction;
+                }
+                block->count = kept;
+            }
+            if (first_child[b] + next_child[b] < first_child[b + 1]) {
+                stack[depth++] = children[first_child[b] + next_child[b]++];
+                entering = 1;
+            } else {
+                table_pop(&table, marks[b]);
+                depth--;
+                entering = 0;
+            }
+        }
+    }
+    ir_replace_registers(function, map);
+
+    free(stack);
+    free(marks);
+    free(first_child);
+    free(children);
+    free(next_child);
+    free(idom);
+    free(generation);
+    table_free(&table);
+    free(map);
+}
+
+/* Propagate copies: a phi whose operands are all one register, or itself,
+ * is that register, as is an operation that adds or ors in zero,
+ * subtracts zero, multiplies by one, or ands with all ones.
+ */
+static void propagate_copies(IrFunction *function) {
+    int registers = function->register_count > 0 ? function->register_count : 1;
+    int *map = ir_identity_map(function);
+    char *is_constant = calloc(registers, 1);
+    long *constant = malloc(registers * sizeof(long));
+    for (int b = 0; b < function->block_count; b++) {
+        IrBlock *block = &function->blocks[b];
+        for (int i = 0; i < block->count; i++) {
+            if (block->instructions[i].opcode == IR_CONST) {
+                is_constant[block->instructions[i].dest] = 1;
+                constant[block->instructions[i].dest] = block->instructions[i].immediate;
+            }
+        }
+    }
+
+    int changed = 1;
+    while (changed) {
+        changed = 0;
+        for (int b = 0; b < function->block_count; b++) {
+            IrBlock *block = &function->blocks[b];
+            for (int i = 0; i < block->count; i++) {
+                IrInstruction *instruction = &block->instructions[i];
+                int dest = instruction->dest;
+                if (dest == IR_NONE || map[dest] != dest) continue;
+                int copy = IR_NONE;
+                if (instruction->opcode == IR_PHI) {
+                    int same = 1;
+                    for (int j = 0; j < block->predecessor_count && same; j++) {
+                        int incoming = ir_find(map, instruction->incoming[j]);
+                        if (incoming == dest) continue;
+                        same = copy == IR_NONE || copy == incoming;
+                        copy = incoming;
+                    }
+                    if (!same) copy = IR_NONE;
+                } else if (ir_operand_count(instruction->opcode) == 2) {
+                    int left = ir_find(map, instruction->operands[0]), right = ir_find(map, instruction->operands[1]);
+                    long identity;
+                    switch (instruction->opcode) {
+                        case IR_ADD: case IR_SUB: case IR_OR: identity = 0; break;
+                        case IR_MUL: identity = 1; break;
+                        case IR_AND: identity = -1; break;
+                        default: continue;
+                    }
+                    if (is_constant[right] && constant[right] == identity) {
+                        copy = left;
+                    } else if (instruction->opcode != IR_SUB && is_constant[left] && constant[left] == identity) {
+                        copy = right;
+                    }
+                }
+                if (copy != IR_NONE) {
+                    map[dest] = copy;
+                    changed = 1;
+                }
+            }
+        }
+    }
+
+    ir_replace_registers(function, map);
+    for (int b = 0; b < function->block_count; b++) {
+        IrBlock *block = &function->blocks[b];
+        int kept = 0;
+        for (int i = 0; i < block->count; i++) {
+            IrInstruction *instruction = &block->instructions[i];
+            if (instruction->dest == IR_NONE || map[instruction->dest] == instruction->dest) {
+                block->instructions[kept++] = *instruction;
+            }
+        }
+        block->count = kept;
+    }
+    free(is_constant);
+    free(constant);
+    free(map);
+}
+
+/* Remove stores to arrays never loaded, and stores overwritten in the
+ * same block before any load of their array, then give back the frame
+ * space of arrays no longer used at all.
+ */
+static void eliminate_dead_stores(IrFunction *function) {
+    if (function->array_count == 0) return;
+    char *loaded = calloc(function->array_count, 1);
+    int *generation = calloc(function->array_count, sizeof(int));
+    int generations = 0;
+    for (int b = 0; b < function->block_count; b++) {
+        IrBlock *block = &function->blocks[b];
+        for (int i = 0; i < block->count; i++) {
+            if (block->instructions[i].opcode == IR_LOAD) loaded[block->instructions[i].array] = 1;
+        }
+    }
+
+    // Walk each block backwards, with the places stored to since the last
+    // load of their arrays.
+    ValueTable later;
+    table_init(&later, 64);
+    for (int b = 0; b < function->block_count; b++) {
+        IrBlock *block = &function->blocks[b];
+        char *dead = calloc(block->count > 0 ? block->count : 1, 1);
+        for (int i = block->count - 1; i >= 0; i--) {
+            IrInstruction *instruction = &block->instructions[i];
+            if (instruction->opcode == IR_LOAD) {
+                generation[instruction->array] = ++generations;
+            } else if (instruction->opcode == IR_STORE) {
+                int array = instruction->array;
+                if (!loaded[array]
+                    || table_find(&later, IR_STORE, instruction->operands[0], generation[array], array) != IR_NONE) {
+                    dead[i] = 1;
+                } else {
+                    table_add(&later, IR_STORE, instruction->operands[0], generation[array], array, 0);
+                }
+            }
+        }
+        table_pop(&later, 0);
+        int kept = 0;
+        for (int i = 0; i < block->count; i++) {
+            if (!dead[i]) block->instructions[kept++] = block->instructions[i];
+        }
+        block->count = kept;
+        free(dead);
+    }
+    table_free(&later);
+
+    int *number = malloc(function->array_count * sizeof(int));
+    for (int a = 0; a < function->array_count; a++) number[a] = IR_NONE;
+    for (int b = 0; b < function->block_count; b++) {
+        IrBlock *block = &function->blocks[b];
+        for (int i = 0; i < block->count; i++) {
+            IrOpcode opcode = block->instructions[i].opcode;
+            if (opcode == IR_LOAD || opcode == IR_STORE) number[block->instructions[i].array] = 0;
+        }
+    }
+    int count = 0;
+    function->array_words = 0;
+    for (int a = 0; a < function->array_count; a++) {
+        if (number[a] == IR_NONE) continue;
+        number[a] = count;
+        function->arrays[count] = function->arrays[a];
+        function->arrays[count].offset = function->array_words;
+        function->array_words += function->arrays[count].length;
+        count++;
+    }
+    function->array_count = count;
+    for (int b = 0; b < function->block_count; b++) {
+        IrBlock *block = &function->blocks[b];
+        for (int i = 0; i < block->count; i++) {
+            IrInstruction *instruction = &block->instructions[i];
+            if (instruction->opcode == IR_LOAD || instruction->opcode == IR_STORE) {
+                instruction->array = number[instruction->array];
+            }
+        }
+    }
+    free(number);
+    free(generation);
+    free(loaded);
+}
+
+/* Remove every instruction whose result is never used and that does
+ * nothing else. Calls stay, for what they print.
+ */
+static void eliminate_dead_code(IrFunction *function) {
+    char *used = calloc(function->register_count > 0 ? function->register_count : 1, 1);
+    int topological = is_topological(function);
+
+    // Backwards, uses are seen before definitions; with predecessors first
+    // that holds across blocks too, and one sweep is enough.
+    int changed = 1;
+    while (changed) {
+        changed = 0;
+        for (int b = function->block_count - 1; b >= 0; b--) {
+            IrBlock *block = &function->blocks[b];
+            for (int i = block->count - 1; i >= 0; i--) {
+                IrInstruction *instruction = &block->instructions[i];
+                if (instruction->dest != IR_NONE && instruction->opcode != IR_CALL && !used[instruction->dest]) {
+                    continue;
+                }
+                for (int j = 0; j < ir_operand_count(instruction->opcode); j++) {
+                    int operand = instruction->operands[j];
+                    if (operand != IR_NONE && !used[operand]) {
+                        used[operand] = 1;
+                        changed = 1;
+                    }
+                }
+                if (ir_is_call(instruction->opcode)) {
+                    for (int j = 0; j < instruction->call->argument_count; j++) {
+                        changed |= !used[instruction->call->arguments[j]];
+                        used[instruction->call->arguments[j]] = 1;
+                    }
+                } else if (instruction->opcode == IR_PHI) {
+                    for (int j = 0; j < block->predecessor_count; j++) {
+                        changed |= !used[instruction->incoming[j]];
+                        used[instruction->incoming[j]] = 1;
+                    }
+                }
+            }
+        }
+        changed &= !topological;
+    }
+
+    for (int b = 0; b < function->block_count; b++) {
+        IrBlock *block = &function->blocks[b];
+        int kept = 0;
+        for (int i = 0; i < block->count; i++) {
+            IrInstruction *instruction = &block->instructions[i];
+            if (instruction->dest == IR_NONE || instruction->opcode == IR_CALL || used[instruction->dest]) {
+                block->instructions[kept++] = *instruction;
+            }
+        }
+        block->count = kept;
+    }
+    free(used);
+}
+
+/* The most arguments a tail call can take: all in registers, so none is
+ * left on the stack of the frame it leaves.
+ */
+static const int MAX_TAIL_CALL_ARGUMENTS = 8;
+
+/* Whether block returns what a call just before returns, or returns
+ * nothing after the call.
+ */
+static int ends_in_tail_call(IrBlock *block) {
+    if (block->count < 2) return 0;
+    IrInstruction *call = &block->instructions[block->count - 2];
+    IrInstruction *last = &block->instructions[block->count - 1];
+    return call->opcode == IR_CALL && last->opcode == IR_RETURN
+        && (last->operands[0] == call->dest || last->operands[0] == IR_NONE);
+}
+
+/* Whether function can become a loop where call makes a tail call: it
+ * calls the function itself, and going round again needs no arrays
+ * zeroed and no entry of its own.
+ */
+static int loops_back(IrFunction *function, IrCall *call) {
+    return call->callee == function->name && call->argument_count == function->parameter_count
+        && function->array_count == 0 && function->blocks[0].predecessor_count == 0;
+}
+
+/* Of each register, how many instructions read it. */
+static int *count_uses(IrFunction *function) {
+    int *uses = calloc(function->register_count > 0 ? function->register_count : 1, sizeof(int));
+    for (int b = 0; b < function->block_count; b++) {
+        IrBlock *block = &function->blocks[b];
+        for (int i = 0; i < block->count; i++) {
+            IrInstruction *instruction = &block->instructions[i];
+            for (int j = 0; j < ir_operand_count(instruction->opcode); j++) {
+                if (instruction->operands[j] != IR_NONE) uses[instruction->operands[j]]++;
+            }
+            if (ir_is_call(instruction->opcode)) {
+                for (int j = 0; j < instruction->call->argument_count; j++) uses[instruction->call->arguments[j]]++;
+            } else if (instruction->opcode == IR_PHI) {
+                for (int j = 0; j < block->predecessor_count; j++) uses[instruction->incoming[j]]++;
+            }
+        }
+    }
+    return uses;
+}
+
+/* Whether an instruction does nothing but compute its result, so that
+ * it may as well come before a call as after it.
+ */
+static int is_pure(IrOpcode opcode) {
+    switch (opcode) {
+        case IR_CONST:
+        case IR_NEG:
+        case IR_NOT:
+        case IR_LOGICAL_NOT:
+        case IR_ADD:
+        case IR_SUB:
+        case IR_MUL:
+        case IR_AND:
+        case IR_OR:
+        case IR_EQ:
+        case IR_GT:
+        case IR_LT:
+        case IR_GE:
+        case IR_LE:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+/* The operators that can carry a result through recursion: associative
+ * and commutative, wrapping around as they do.
+ */
+static int is_associative(IrOpcode opcode) {
+    return opcode == IR_ADD || opcode == IR_MUL || opcode == IR_AND || opcode == IR_OR;
+}
+
+/* The value x with x op value == value. */
+static long identity(IrOpcode opcode) {
+    switch (opcode) {
+        case IR_MUL: return 1;
+        case IR_AND: return -1;
+        default: return 0;
+    }
+}
+
+/* A call of the function by itself whose result is returned, as it is
+ * or combined with other values by one operator, as in
+ * `return n + f(n - 1)`.
+ */
+typedef struct SelfCall {
+    int block;
+    int call; // Its index in the block
+    int combine; // The operator, or IR_NONE
+} SelfCall;
+
+/* Whether block ends in a self call that can loop back, finding it. */
+static int find_self_call(IrFunction *function, int b, int *uses, SelfCall *self) {
+    IrBlock *block = &function->blocks[b];
+    IrInstruction *last = &block->instructions[block->count - 1];
+    if (last->opcode != IR_RETURN) return 0;
+    int c = block->count - 2;
+    while (c >= 0 && last->operands[0] != IR_NONE && is_pure(block->instructions[c].opcode)) c--;
+    if (c < 0 || block->instructions[c].opcode != IR_CALL || !loops_back(function, block->instructions[c].call)) {
+        return 0;
+    }
+    self->block = b;
+    self->call = c;
+    self->combine = IR_NONE;
+    if (last->operands[0] == IR_NONE) return 1;
+
+    // Follow the result through the operators to the return, each of
+    // which must be all that reads it.
+    int value = block->instructions[c].dest;
+    for (int i = c + 1; i < block->count - 1; i++) {
+        IrInstruction *instruction = &block->instructions[i];
+        int left = instruction->operands[0] == value, right = instruction->operands[1] == value;
+        if (!left && !right) continue;
+        if ((left && right) || uses[value] != 1 || !is_associative(instruction->opcode)
+            || (self->combine != IR_NONE && self->combine != (int)instruction->opcode)) {
+            return 0;
+        }
+        self->combine = instruction->opcode;
+        value = instruction->dest;
+    }
+    return value == last->operands[0] && uses[value] == 1;
+}
+
+/* Make the count self calls found jump back to the function's entry. A
+ * new entry takes the parameters, and the old one, now block 1, a phi
+ * for each, picking the argument of each jump. With an operator to
+ * combine, another phi accumulates what the calls' results would have
+ * been combined with, which every return then combines with what it
+ * returns: f(n) = n + f(n - 1) becomes f(n, a) = f(n - 1, a + n).
+ */
+static void make_loop(IrFunction *function, SelfCall *calls, int count, int combine) {
+    int n = function->block_count;
+    ir_block_new(function);
+    memmove(&function->blocks[1], &function->blocks[0], n * sizeof(IrBlock));
+    IrBlock *entry = &function->blocks[0];
+    entry->instructions = NULL;
+    entry->count = entry->capacity = 0;
+    entry->predecessors = NULL;
+    entry->predecessor_count = entry->predecessor_capacity = 0;
+    for (int b = 1; b <= n; b++) {
+        IrBlock *block = &function->blocks[b];
+        IrInstruction *last = &block->instructions[block->count - 1];
+        if (last->opcode == IR_BRANCH) last->targets[1]++;
+        if (last->opcode == IR_BRANCH || last->opcode == IR_JUMP) last->targets[0]++;
+        for (int i = 0; i < block->predecessor_count; i++) block->predecessors[i]++;
+    }
+
+    IrBlock *header = &function->blocks[1];
+    int kept = 0;
+    for (int i = 0; i < header->count; i++) {
+        if (header->instructions[i].opcode == IR_PARAM) {
+            *ir_append(function, 0, IR_PARAM) = header->instructions[i];
+        } else {
+            header->instructions[kept++] = header->instructions[i];
+        }
+    }
+    header->count = kept;
+    int parameters = entry->count;
+    int start = IR_NONE;
+    if (combine != IR_NONE) {
+        start = ir_emit(function, 0, IR_CONST, IR_NONE, IR_NONE);
+        entry->instructions[entry->count - 1].immediate = identity(combine);
+    }
+    ir_append(function, 0, IR_JUMP)->targets[0] = 1;
+    ir_add_predecessor(function, 1, 0);
+    for (int t = 0; t < count; t++) {
+        ir_add_predecessor(function, 1, calls[t].block + 1);
+    }
+
+    int phis = parameters + (combine != IR_NONE);
+    IrInstruction *instructions = malloc((phis + kept) * sizeof(IrInstruction));
+    memcpy(&instructions[phis], header->instructions, kept * sizeof(IrInstruction));
+    for (int p = 0; p < phis; p++) {
+        instructions[p].opcode = IR_PHI;
+        instructions[p].dest = function->register_count++;
+        instructions[p].operands[0] = instructions[p].operands[1] = IR_NONE;
+        instructions[p].incoming = arena_alloc(function->arena, (count + 1) * sizeof(int));
+    }
+    int accumulator = combine != IR_NONE ? instructions[parameters].dest : IR_NONE;
+    free(header->instructions);
+    header->instructions = instructions;
+    header->count = header->capacity = phis + kept;
+
+    // The loop reads the phis in place of the parameters, and the
+    // operators read the accumulator in place of each call's result.
+    int *map = ir_identity_map(function);
+    for (int p = 0; p < parameters; p++) {
+        instructions[p].incoming[0] = entry->instructions[p].dest;
+        map[entry->instructions[p].dest] = instructions[p].dest;
+    }
+    if (accumulator != IR_NONE) {
+        instructions[parameters].incoming[0] = start;
+    }
+    for (int t = 0; t < count; t++) {
+        int b = calls[t].block + 1;
+        IrBlock *tail = &function->blocks[b];
+        IrInstruction *call = &tail->instructions[calls[t].call];
+        for (int p = 0; p < parameters; p++) {
+            instructions[p].incoming[t + 1] = call->call->arguments[entry->instructions[p].immediate];
+        }
+        if (accumulator != IR_NONE) {
+            map[call->dest] = accumulator;
+            instructions[parameters].incoming[t + 1] = calls[t].combine != IR_NONE
+                ? tail->instructions[tail->count - 1].operands[0] : accumulator;
+        }
+        memmove(call, call + 1, (tail->count - calls[t].call - 2) * sizeof(IrInstruction));
+        tail->count -= 2;
+        ir_append(function, b, IR_JUMP)->targets[0] = 1;
+        ir_block_trim(function, b);
+    }
+    ir_replace_registers(function, map);
+    for (int p = 0; p < parameters; p++) {
+        instructions[p].incoming[0] = entry->instructions[p].dest;
+    }
+    free(map);
+
+    if (accumulator == IR_NONE) return;
+    for (int b = 1; b <= n; b++) {
+        IrBlock *block = &function->blocks[b];
+        IrInstruction *last = &block->instructions[block->count - 1];
+        if (last->opcode != IR_RETURN || last->operands[0] == IR_NONE) continue;
+        int value = last->operands[0];
+        last->opcode = combine;
+        last->dest = function->register_count++;
+        last->operands[0] = accumulator;
+        last->operands[1] = value;
+        value = last->dest;
+        ir_append(function, b, IR_RETURN)->operands[0] = value;
+    }
+}
+
+/* Return what a call returns by a tail call, which leaves the frame
+ * before it branches, so recursion through it takes no stack. A function
+ * that calls itself so loops instead, and so does one that combines
+ * what it returns with the result of calling itself, by way of an
+ * accumulator.
+ */
+static void eliminate_tail_calls(IrFunction *function) {
+    int *uses = count_uses(function);
+    SelfCall *calls = NULL;
+    int count = 0, combine = IR_NONE, tail_calls = 0;
+    for (int b = 0; b < function->block_count; b++) {
+        IrBlock *block = &function->blocks[b];
+        tail_calls += block->instructions[block->count - 1].opcode == IR_TAIL_CALL;
+        SelfCall self;
+        if (!find_self_call(function, b, uses, &self)) continue;
+        if (self.combine != IR_NONE) {
+            // One accumulator can only combine by one operator.
+            if (combine != IR_NONE && combine != self.combine) continue;
+            combine = self.combine;
+        }
+        if (calls == NULL) calls = malloc(function->block_count * sizeof(SelfCall));
+        calls[count++] = self;
+    }
+    free(uses);
+    if (combine != IR_NONE && tail_calls > 0) {
+        // Returns by tail call cannot combine theirs with the accumulator.
+        int kept = 0;
+        for (int t = 0; t < count; t++) {
+            if (calls[t].combine == IR_NONE) calls[kept++] = calls[t];
+        }
+        count = kept;
+        combine = IR_NONE;
+    }
+    if (count > 0) {
+        make_loop(function, calls, count, combine);
+    }
+    free(calls);
+
+    for (int b = 0; b < function->block_count; b++) {
+        IrBlock *block = &function->blocks[b];
+        if (!ends_in_tail_call(block)) continue;
+        IrInstruction *call = &block->instructions[block->count - 2];
+        if (call->call->argument_count <= MAX_TAIL_CALL_ARGUMENTS) {
+            call->opcode = IR_TAIL_CALL;
+            call->dest = IR_NONE;
+            block->count--;
+        }
+    }
+}
+
+typedef struct PassInfo {
+    const char *name;
+    int level; // The lowest -O level that runs it
+    void (*run)(IrFunction *function);
+} PassInfo;
+
+static const PassInfo passes[PASS_COUNT] = {
+    [PASS_INTERPROCEDURAL] = {"interprocedural", 1, NULL},
+    [PASS_INLINE] = {"inlining", 2, NULL},
+    [PASS_TAIL_CALLS] = {"tail calls", 1, eliminate_tail_calls},
+    [PASS_CONSTANTS] = {"constant propagation", 1, propagate_constants},
+    [PASS_VALUE_NUMBERING] = {"value numbering", 2, number_values},
+    [PASS_COPIES] = {"copy propagation", 1, propagate_copies},
+    [PASS_DEAD_STORES] = {"dead stores", 2, eliminate_dead_stores},
+    [PASS_DEAD_CODE] = {"dead code", 1, eliminate_dead_code},
+};
+
+void opt_stats_clear(OptStats *stats) {
+    for (int p = 0; p < PASS_COUNT; p++) {
+        stats->seconds[p] = 0;
+        stats->removed[p] = 0;
+    }
+    stats->inlined = 0;
+    stats->functions_dropped = 0;
+    stats->constant_parameters = 0;
+    stats->unused_results = 0;
+}
+
+void opt_stats_add(OptStats *total, const OptStats *stats) {
+    for (int p = 0; p < PASS_COUNT; p++) {
+        total->seconds[p] += stats->seconds[p];
+        total->removed[p] += stats->removed[p];
+    }
+    total->inlined += stats->inlined;
+    total->functions_dropped += stats->functions_dropped;
+    total->constant_parameters += stats->constant_parameters;
+    total->unused_results += stats->unused_results;
+}
+
+void opt_stats_print(FILE *out, const OptStats *stats) {
+    fprintf(out, "Pass %-20s %9.6fs, %ld functions dropped, %ld parameters made constant, %ld results unused\n",
+            passes[PASS_INTERPROCEDURAL].name, stats->seconds[PASS_INTERPROCEDURAL], stats->functions_dropped,
+            stats->constant_parameters, stats->unused_results);
+    fprintf(out, "Pass %-20s %9.6fs, %ld calls inlined, %ld instructions added\n",
+            passes[PASS_INLINE].name, stats->seconds[PASS_INLINE], stats->inlined, -stats->removed[PASS_INLINE]);
+    for (int p = 0; p < PASS_COUNT; p++) {
+        if (p == PASS_INTERPROCEDURAL || p == PASS_INLINE) continue;
+        // Making loops of tail calls can add more than it removes.
+        fprintf(out, "Pass %-20s %9.6fs, %ld instructions %s\n", passes[p].name, stats->seconds[p],
+                stats->removed[p] < 0 ? -stats->removed[p] : stats->removed[p],
+                stats->removed[p] < 0 ? "added" : "removed");
+    }
+}
+
+static double now(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+/* At -O2, rounds of passes stop once one changes nothing, or after this. */
+static const int MAX_ROUNDS = 4;
+
+/* Run the passes that level calls for over function, in order. Each
+ * pass can expose work for those before it, such as a value forwarded
+ * from a store to fold, so at -O2 they run again while that pays.
+ */
+void optimize_function(IrFunction *function, int level, OptStats *stats) {
+    for (int round = 0; round < (level >= 2 ? MAX_ROUNDS : 1); round++) {
+        int changed = 0;
+        for (int p = 0; p < PASS_COUNT; p++) {
+            if (level < passes[p].level || passes[p].run == NULL) continue;
+            long before = instruction_count(function);
+            double start = now();
+            passes[p].run(function);
+            stats->seconds[p] += now() - start;
+            stats->removed[p] += before - instruction_count(function);
+            changed |= before != instruction_count(function);
+        }
+        if (!changed) break;
+    }
+}
+
+/* Drop what main cannot reach, then tell the functions left what
+ * holds at every call of them: constant arguments, and results no
+ * caller uses.
+ */
+static void optimize_interprocedural(IrProgram *program, OptStats *stats) {
+    if (program->function_count < 2) return;
+    double start = now();
+    stats->functions_dropped += drop_unreachable_functions(program);
+    CallGraph *graph = call_graph_new(program);
+    stats->constant_parameters += propagate_constant_arguments(graph);
+    stats->unused_results += drop_unused_results(graph);
+    call_graph_free(graph);
+    stats->seconds[PASS_INTERPROCEDURAL] += now() - start;
+}
+
+/* Optimize each function of program. A whole program first loses what
+ * main cannot reach, so nothing is spent on it. Inlining goes callees
+ * first, each optimized before it is copied into its callers, so its
+ * size is what a copy would cost and the copies need not be optimized
+ * again; functions inlined into every caller are then dropped too.
+ */
+void optimize_program(IrProgram *program, int level, int inline_limit, OptStats *stats) {
+    int whole = program->whole && level >= passes[PASS_INTERPROCEDURAL].level;
+    if (whole) {
+        optimize_interprocedural(program, stats);
+    }
+    if (level < passes[PASS_INLINE].level || inline_limit <= 0 || program->function_count < 2) {
+        for (int i = 0; i < program->function_count; i++) {
+            optimize_function(program->functions[i], level, stats);
+        }
+        return;
+    }
+    double start = now();
+    CallGraph *graph = call_graph_new(program);
+    int *sizes = malloc(program->function_count * sizeof(int));
+    memset(sizes, -1, program->function_count * sizeof(int));
+    stats->seconds[PASS_INLINE] += now() - start;
+    for (int i = 0; i < program->function_count; i++) {
+        int caller = graph->order[i];
+        IrFunction *function = program->functions[caller];
+        long before = instruction_count(function);
+        start = now();
+        stats->inlined += inline_calls(graph, caller, inline_limit, sizes);
+        stats->seconds[PASS_INLINE] += now() - start;
+        stats->removed[PASS_INLINE] += before - instruction_count(function);
+        optimize_function(function, level, stats);
+    }
+    free(sizes);
+    call_graph_free(graph);
+    if (whole) {
+        start = now();
+        stats->functions_dropped += drop_unreachable_functions(program);
+        stats->seconds[PASS_INTERPROCEDURAL] += now() - start;
+    }
+}
@@ -0,0 +1,36 @@
+#include <stdio.h>
+#include "ir.h"
+
+#ifndef OPT_HEADER
+#define OPT_HEADER
+
+/* The optimization passes over the IR, in the order they run. */
+typedef enum OptPass {
+    PASS_INTERPROCEDURAL, // Over the whole program, from main
+    PASS_INLINE, // Over the whole program, callees first
+    PASS_TAIL_CALLS, // Into jumps, and self recursion, with any accumulator, into loops
+    PASS_CONSTANTS, // Sparse conditional constant propagation
+    PASS_VALUE_NUMBERING, // Common subexpressions, over the dominator tree
+    PASS_COPIES,
+    PASS_DEAD_STORES,
+    PASS_DEAD_CODE,
+    PASS_COUNT,
+} OptPass;
+
+/* Time spent in each pass and the instructions it removed. */
+typedef struct OptStats {
+    double seconds[PASS_COUNT];
+    long removed[PASS_COUNT];
+    long inlined; // Calls
+    long functions_dropped; // Unreachable from main
+    long constant_parameters;
+    long unused_results; // Functions made to return nothing
+} OptStats;
+
+void opt_stats_clear(OptStats *stats);
+void opt_stats_add(OptStats *total, const OptStats *stats);
+void opt_stats_print(FILE *out, const OptStats *stats);
+void optimize_function(IrFunction *function, int level, OptStats *stats);
+void optimize_program(IrProgram *program, int level, int inline_limit, OptStats *stats);
+
+#endif
@@ -0,0 +1,48 @@
+#include <stdlib.h>
+#include <sched.h>
+#include "queue.h"
+
+/* head and tail only ever grow, and are reduced modulo the capacity when
+ * indexing. The release store of tail publishes the item written before
+ * it; the release store of head hands the slot back to the producer.
+ */
+
+Queue *queue_new(size_t capacity) {
+    size_t size = 1;
+    while (size < capacity) {
+        size *= 2;
+    }
+
+    Queue *queue = malloc(sizeof(Queue));
+    queue->items = malloc(size * sizeof(void *));
+    queue->mask = size - 1;
+    queue->head = 0;
+    queue->tail = 0;
+    return queue;
+}
+
+void queue_free(Queue *queue) {
+    free(queue->items);
+    free(queue);
+}
+
+/* Blocks while the queue is full. */
+void queue_push(Queue *queue, void *item) {
+    size_t tail = queue->tail;
+    while (tail - __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE) > queue->mask) {
+        sched_yield();
+    }
+    queue->items[tail & queue->mask] = item;
+    __atomic_store_n(&queue->tail, tail + 1, __ATOMIC_RELEASE);
+}
+
+/* Blocks while the queue is empty. */
+void *queue_pop(Queue *queue) {
+    size_t head = queue->head;
+    while (__atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE) == head) {
+        sched_yield();
+    }
+    void *item = queue->items[head & queue->mask];
+    __atomic_store_n(&queue->head, head + 1, __ATOMIC_RELEASE);
+    return item;
+}
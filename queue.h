@@ -0,0 +1,22 @@
+#include <stddef.h>
+
+#ifndef QUEUE_HEADER
+#define QUEUE_HEADER
+
+/* A bounded single-producer, single-consumer queue of pointers. One
+ * thread pushes and one thread pops; neither ever takes a lock. NULL
+ * cannot be queued.
+ */
+typedef struct Queue {
+    void **items;
+    size_t mask; // Capacity - 1, capacity being a power of two
+    size_t head; // Next slot to pop, written only by the consumer
+    size_t tail; // Next slot to push, written only by the producer
+} Queue;
+
+Queue *queue_new(size_t capacity);
+void queue_free(Queue *queue);
+void queue_push(Queue *queue, void *item);
+void *queue_pop(Queue *queue);
+
+#endif
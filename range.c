@@ -0,0 +1,593 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include "range.h"
+#include "vector.h"
+#include "walk.h"
+
+#define INITIAL_CHECKS_SIZE 64
+#define REFINE_DEPTH 16 // Of the operands a condition is compared against
+
+/* Value-range analysis tracks, for every integer variable, an interval
+ * holding every value it may have at the point reached, in the variable's
+ * Symbol. The language has no loops, so one walk in program order is
+ * exact up to the intervals themselves: the two arms of an IF start from
+ * the same state, narrowed by the condition, and are joined after it; an
+ * arm that returns takes no part in the join.
+ */
+
+typedef struct Interval {
+    long low, high;
+} Interval;
+
+static const Interval ANY = { LONG_MIN, LONG_MAX };
+
+/* A variable's interval before a change, so that it can be undone. */
+typedef struct Change {
+    Symbol *symbol;
+    long low, high;
+} Change;
+
+typedef struct Branch {
+    size_t mark; // The length of changes before the IF
+    size_t then_begin; // Where the then arm's results start in then_values
+    int pre_reachable;
+    int then_reachable;
+} Branch;
+
+typedef struct RangeWalk {
+    BoundsChecks *checks;
+    Vector values; // Of Interval, one per expression being analyzed
+    Vector changes; // Of Change, every change since the function began
+    Vector then_values; // Of Change, holding the state at the end of then arms
+    Vector branches; // Of Branch, one per IF being analyzed
+    Vector arrays; // Of Symbol *, the arrays declared so far in the function
+    int reachable;
+} RangeWalk;
+
+BoundsChecks *bounds_checks_new(void) {
+    BoundsChecks *checks = malloc(sizeof(BoundsChecks));
+    checks->table_size = INITIAL_CHECKS_SIZE;
+    checks->count = 0;
+    checks->nodes = calloc(checks->table_size, sizeof(Syntax *));
+    checks->limits = malloc(checks->table_size * sizeof(int));
+    return checks;
+}
+
+void bounds_checks_free(BoundsChecks *checks) {
+    if (checks == NULL) return;
+    free(checks->nodes);
+    free(checks->limits);
+    free(checks);
+}
+
+static size_t find_check(BoundsChecks *checks, Syntax *access) {
+    size_t mask = checks->table_size - 1;
+    size_t slot = ((uintptr_t)access * 0x9E3779B97F4A7C15ull >> 32) & mask;
+    while (checks->nodes[slot] != NULL && checks->nodes[slot] != access) {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+static void add_check(BoundsChecks *checks, Syntax *access, int limit) {
+    if ((checks->count + 1) * 2 > checks->table_size) {
+        Syntax **nodes = checks->nodes;
+        int *limits = checks->limits;
+        size_t size = checks->table_size;
+        checks->table_size *= 2;
+        checks->nodes = calloc(checks->table_size, sizeof(Syntax *));
+        checks->limits = malloc(checks->table_size * sizeof(int));
+        for (size_t i = 0; i < size; i++) {
+            if (nodes[i] == NULL) continue;
+            size_t slot = find_check(checks, nodes[i]);
+            checks->nodes[slot] = nodes[i];
+            checks->limits[slot] = limits[i];
+        }
+        free(nodes);
+        free(limits);
+    }
+    size_t slot = find_check(checks, access);
+    if (checks->nodes[slot] == NULL) {
+        checks->nodes[slot] = access;
+        checks->count++;
+    }
+    checks->limits[slot] = limit;
+}
+
+/* The length of the array access indexes, 0 if the index was proven in
+ * range, or -1 if the access was not analyzed.
+ */
+int bounds_check_limit(BoundsChecks *checks, Syntax *access) {
+    size_t slot = find_check(checks, access);
+    return checks->nodes[slot] == access ? checks->limits[slot] : -1;
+}
+
+static void record_access(RangeWalk *walk, Syntax *access, int length, Interval index) {
+    add_check(walk->checks, access, index.low >= 0 && index.high < length ? 0 : length);
+}
+
+static Interval interval_of(Symbol *symbol) {
+    if (symbol == NULL || symbol->type == TYPE_ARRAY) {
+        return ANY;
+    }
+    Interval interval = { symbol->low, symbol->high };
+    return interval;
+}
+
+static void set_range(RangeWalk *walk, Symbol *symbol, long low, long high) {
+    Change change = { symbol, symbol->low, symbol->high };
+    vector_push_back(&walk->changes, &change);
+    symbol->low = low;
+    symbol->high = high;
+}
+
+static void undo_changes(RangeWalk *walk, size_t mark) {
+    while (vector_length(&walk->changes) > mark) {
+        Change change;
+        vector_pop_back(&walk->changes, &change);
+        change.symbol->low = change.low;
+        change.symbol->high = change.high;
+    }
+}
+
+static Interval pop_value(RangeWalk *walk) {
+    Interval interval;
+    vector_pop_back(&walk->values, &interval);
+    return interval;
+}
+
+static void push_value(RangeWalk *walk, Interval interval) {
+    vector_push_back(&walk->values, &interval);
+}
+
+static void truncate_values(RangeWalk *walk, size_t length) {
+    while (vector_length(&walk->values) > length) {
+        vector_pop_back(&walk->values, NULL);
+    }
+}
+
+static Interval boolean(int can_be_false, int can_be_true) {
+    Interval interval = { can_be_false ? 0 : 1, can_be_true ? 1 : 0 };
+    return interval;
+}
+
+static Interval unary_range(UnaryExpressionType type, Interval a) {
+    Interval result;
+    switch (type) {
+        case NEGATION:
+            if (a.low == LONG_MIN) return ANY;
+            result.low = -a.high;
+            result.high = -a.low;
+            return result;
+        case BITWISE_NEGATION:
+            result.low = ~a.high;
+            result.high = ~a.low;
+            return result;
+        case LOGICAL_NEGATION:
+            return boolean(a.low != 0 || a.high != 0, a.low <= 0 && a.high >= 0);
+    }
+    return ANY;
+}
+
+/* The smallest number of the form 2^k - 1 at least value, which is not negative. */
+static long all_ones(long value) {
+    unsigned long ones = 0;
+    while (ones < (unsigned long)value) {
+        ones = ones * 2 + 1;
+    }
+    return (long)ones;
+}
+
+static Interval binary_range(BinaryExpressionType type, Interval a, Interval b) {
+    Interval result;
+    switch (type) {
+        case ADDITION:
+            if (__builtin_add_overflow(a.low, b.low, &result.low)
+                || __builtin_add_overflow(a.high, b.high, &result.high)) return ANY;
+            return result;
+        case SUBTRACTION:
+            if (__builtin_sub_overflow(a.low, b.high, &result.low)
+                || __builtin_sub_overflow(a.high, b.low, &result.high)) return ANY;
+            return result;
+        case MULTIPLICATION: {
+            long products[4];
+            if (__builtin_mul_overflow(a.low, b.low, &products[0])
+                || __builtin_mul_overflow(a.low, b.high, &products[1])
+                || __builtin_mul_overflow(a.high, b.low, &products[2])
+                || __builtin_mul_overflow(a.high, b.high, &products[3])) return ANY;
+            result.low = result.high = products[0];
+            for (int i = 1; i < 4; i++) {
+                if (products[i] < result.low) result.low = products[i];
+                if (products[i] > result.high) result.high = products[i];
+            }
+            return result;
+        }
+        case GREATER:
+            return boolean(a.low <= b.high, a.high > b.low);
+        case LESS:
+            return boolean(a.high >= b.low, a.low < b.high);
+        case GREATER_EQUALS:
+            return boolean(a.low < b.high, a.high >= b.low);
+        case LESS_EQUALS:
+            return boolean(a.high > b.low, a.low <= b.high);
+        case EQUALS:
+            return boolean(a.low != a.high || b.low != b.high || a.low != b.low,
+                           a.low <= b.high && b.low <= a.high);
+        case AND:
+            // Not negative if either operand is not.
+            if (a.low >= 0 && b.low >= 0) {
+                result.low = 0;
+                result.high = a.high < b.high ? a.high : b.high;
+                return result;
+            }
+            if (a.low >= 0 || b.low >= 0) {
+                result.low = 0;
+                result.high = a.low >= 0 ? a.high : b.high;
+                return result;
+            }
+            return ANY;
+        case OR:
+            if (a.low >= 0 && b.low >= 0) {
+                result.low = a.low > b.low ? a.low : b.low;
+                result.high = all_ones(a.high > b.high ? a.high : b.high);
+                return result;
+            }
+            return ANY;
+    }
+    return ANY;
+}
+
+/* The range of an operand in a condition, which analysis has passed. */
+static Interval operand_range(Syntax *syntax, int depth) {
+    if (depth > REFINE_DEPTH) {
+        return ANY;
+    }
+    switch (syntax->type) {
+        case IMMEDIATE: {
+            Interval interval = { syntax->immediate.value, syntax->immediate.value };
+            return interval;
+        }
+        case VARIABLE:
+            return interval_of(syntax->variable.symbol);
+        case UNARY_OPERATOR:
+            return unary_range(syntax->unary_expression.unary_type,
+                               operand_range(syntax->unary_expression.expression, depth + 1));
+        case BINARY_OPERATOR:
+            return binary_range(syntax->binary_expression.binary_type,
+                                operand_range(syntax->binary_expression.left, depth + 1),
+                                operand_range(syntax->binary_expression.right, depth + 1));
+        default:
+            return ANY;
+    }
+}
+
+/* Narrow a variable to the values for which `variable type bound` holds.
+ * If there are none, the code being entered is unreachable.
+ */
+static void constrain(RangeWalk *walk, Symbol *symbol, BinaryExpressionType type, Interval bound) {
+    if (symbol == NULL || symbol->type == TYPE_ARRAY) return;
+    long low = symbol->low, high = symbol->high;
+    switch (type) {
+        case LESS:
+            if (bound.high == LONG_MIN) { walk->reachable = 0; return; }
+            if (bound.high - 1 < high) high = bound.high - 1;
+            break;
+        case LESS_EQUALS:
+            if (bound.high < high) high = bound.high;
+            break;
+        case GREATER:
+            if (bound.low == LONG_MAX) { walk->reachable = 0; return; }
+            if (bound.low + 1 > low) low = bound.low + 1;
+            break;
+        case GREATER_EQUALS:
+            if (bound.low > low) low = bound.low;
+            break;
+        case EQUALS:
+            if (bound.low > low) low = bound.low;
+            if (bound.high < high) high = bound.high;
+            break;
+        default:
+            return;
+    }
+    if (low > high) {
+        walk->reachable = 0;
+    } else if (low != symbol->low || high != symbol->high) {
+        set_range(walk, symbol, low, high);
+    }
+}
+
+static int is_comparison(BinaryExpressionType type) {
+    return type == LESS || type == LESS_EQUALS || type == GREATER || type == GREATER_EQUALS || type == EQUALS;
+}
+
+/* The comparison that holds when this one does not, or -1 if that
+ * cannot be said with one interval.
+ */
+static int negated(BinaryExpressionType type) {
+    switch (type) {
+        case LESS: return GREATER_EQUALS;
+        case LESS_EQUALS: return GREATER;
+        case GREATER: return LESS_EQUALS;
+        case GREATER_EQUALS: return LESS;
+        default: return -1;
+    }
+}
+
+/* The same comparison with its operands swapped. */
+static BinaryExpressionType mirrored(BinaryExpressionType type) {
+    switch (type) {
+        case LESS: return GREATER;
+        case LESS_EQUALS: return GREATER_EQUALS;
+        case GREATER: return LESS;
+        case GREATER_EQUALS: return LESS_EQUALS;
+        default: return type;
+    }
+}
+
+/* Narrow the variables compared in condition to the values for which it
+ * holds, or does not. Conditions are booleans, so they are comparisons,
+ * their negations, or boolean variables, which tell nothing of indices.
+ */
+static void refine(RangeWalk *walk, Syntax *condition, int holds) {
+    if (condition->type == UNARY_OPERATOR && condition->unary_expression.unary_type == LOGICAL_NEGATION) {
+        refine(walk, condition->unary_expression.expression, !holds);
+        return;
+    }
+    if (condition->type != BINARY_OPERATOR || !is_comparison(condition->binary_expression.binary_type)) {
+        return;
+    }
+    BinaryExpression *bin = &condition->binary_expression;
+    int type = holds ? (int)bin->binary_type : negated(bin->binary_type);
+    if (type < 0) return;
+    if (bin->left->type == VARIABLE) {
+        constrain(walk, bin->left->variable.symbol, type, operand_range(bin->right, 0));
+    }
+    if (bin->right->type == VARIABLE) {
+        constrain(walk, bin->right->variable.symbol, mirrored(type), operand_range(bin->left, 0));
+    }
+}
+
+static Symbol *find_array(RangeWalk *walk, Name name) {
+    for (size_t i = vector_length(&walk->arrays); i > 0; i--) {
+        Symbol *symbol = *(Symbol **)vector_at(&walk->arrays, i - 1);
+        if (symbol->name == name) {
+            return symbol;
+        }
+    }
+    return NULL;
+}
+
+static int range_enter(Walker *walker, WalkFrame *frame, WalkFrame *parent) {
+    (void)parent;
+    RangeWalk *walk = walker->data;
+    Syntax *syntax = frame->node;
+
+    if (syntax->type == FUNCTION) {
+        vector_release(&walk->changes);
+        vector_release(&walk->arrays);
+        walk->reachable = 1;
+        // Nothing is known of the arguments.
+        Syntax *parameters = syntax->function.parameters;
+        int count = parameters ? list_length(parameters->function_arguments.arguments) : 0;
+        for (int i = 0; i < count; i++) {
+            Symbol *symbol = ((Syntax *)list_get(parameters->function_arguments.arguments, i))->define_var_statement.symbol;
+            if (symbol != NULL) {
+                symbol->low = ANY.low;
+                symbol->high = ANY.high;
+            }
+        }
+    }
+    // The values of the node's children are pushed above this.
+    frame->value = vector_length(&walk->values);
+    return 1;
+}
+
+static int range_before_child(Walker *walker, WalkFrame *frame, int index, Syntax *child) {
+    RangeWalk *walk = walker->data;
+    Syntax *syntax = frame->node;
+
+    switch (syntax->type) {
+        case FUNCTION:
+            return index != 0;
+        case BLOCK:
+            // Drop the values of expression statements.
+            truncate_values(walk, frame->value);
+            return 1;
+        case IF_STATEMENT:
+            if (index == 1) {
+                truncate_values(walk, frame->value);
+                Branch branch = { vector_length(&walk->changes), 0, walk->reachable, 0 };
+                vector_push_back(&walk->branches, &branch);
+                refine(walk, syntax->if_statement.condition, 1);
+            } else if (index == 2) {
+                Branch *branch = vector_at(&walk->branches, vector_length(&walk->branches) - 1);
+                branch->then_reachable = walk->reachable;
+                branch->then_begin = vector_length(&walk->then_values);
+                size_t mark = branch->mark;
+                for (size_t i = mark; i < vector_length(&walk->changes); i++) {
+                    Change *change = vector_at(&walk->changes, i);
+                    Change result = { change->symbol, change->symbol->low, change->symbol->high };
+                    vector_push_back(&walk->then_values, &result);
+                }
+                undo_changes(walk, mark);
+                walk->reachable = branch->pre_reachable;
+                // Code after an IF without an else is reached this way too.
+                refine(walk, syntax->if_statement.condition, 0);
+            }
+            (void)child;
+            return 1;
+        default:
+            return 1;
+    }
+}
+
+static int compare_changes(const void *a, const void *b) {
+    uintptr_t x = (uintptr_t)((const Change *)a)->symbol, y = (uintptr_t)((const Change *)b)->symbol;
+    return x < y ? -1 : x > y;
+}
+
+/* Copy changes[begin, end) to an array sorted by symbol. */
+static Change *sorted_changes(Vector *changes, size_t begin, size_t end) {
+    Change *sorted = malloc((end > begin ? end - begin : 1) * sizeof(Change));
+    for (size_t i = begin; i < end; i++) {
+        sorted[i - begin] = *(Change *)vector_at(changes, i);
+    }
+    qsort(sorted, end - begin, sizeof(Change), compare_changes);
+    return sorted;
+}
+
+/* After an IF whose arms both fall through, give each variable either arm
+ * changed the join of its values at the ends of the two arms. A variable
+ * one arm left alone has its value from before the IF in that arm.
+ */
+static void join_arms(RangeWalk *walk, Branch *branch) {
+    size_t end = vector_length(&walk->changes);
+    for (size_t i = branch->mark; i < end; i++) {
+        Change *change = vector_at(&walk->changes, i);
+        Change result = { change->symbol, change->symbol->low, change->symbol->high };
+        vector_push_back(&walk->then_values, &result);
+    }
+    size_t then_end = vector_length(&walk->then_values) - (end - branch->mark);
+    Change *then_arm = sorted_changes(&walk->then_values, branch->then_begin, then_end);
+    Change *else_arm = sorted_changes(&walk->then_values, then_end, vector_length(&walk->then_values));
+    size_t then_count = then_end - branch->then_begin, else_count = end - branch->mark;
+
+    undo_changes(walk, branch->mark);
+    size_t i = 0, j = 0;
+    while (i < then_count || j < else_count) {
+        Symbol *symbol = j == else_count || (i < then_count && (uintptr_t)then_arm[i].symbol < (uintptr_t)else_arm[j].symbol)
+            ? then_arm[i].symbol : else_arm[j].symbol;
+        Change then_value = { symbol, symbol->low, symbol->high }, else_value = then_value;
+        while (i < then_count && then_arm[i].symbol == symbol) then_value = then_arm[i++];
+        while (j < else_count && else_arm[j].symbol == symbol) else_value = else_arm[j++];
+        set_range(walk, symbol, then_value.low < else_value.low ? then_value.low : else_value.low,
+                  then_value.high > else_value.high ? then_value.high : else_value.high);
+    }
+    free(then_arm);
+    free(else_arm);
+}
+
+static void join_branches(RangeWalk *walk) {
+    Branch branch;
+    vector_pop_back(&walk->branches, &branch);
+    int else_reachable = walk->reachable;
+
+    if (branch.then_reachable && else_reachable) {
+        join_arms(walk, &branch);
+    } else if (branch.then_reachable) {
+        undo_changes(walk, branch.mark);
+        for (size_t i = branch.then_begin; i < vector_length(&walk->then_values); i++) {
+            Change value = *(Change *)vector_at(&walk->then_values, i);
+            set_range(walk, value.symbol, value.low, value.high);
+        }
+        walk->reachable = 1;
+    }
+    while (vector_length(&walk->then_values) > branch.then_begin) {
+        vector_pop_back(&walk->then_values, NULL);
+    }
+}
+
+static void range_leave(Walker *walker, WalkFrame *frame) {
+    RangeWalk *walk = walker->data;
+    Syntax *syntax = frame->node;
+
+    switch (syntax->type) {
+        case IMMEDIATE:
+        case ARRAY_TYPE: {
+            Interval interval = { syntax->immediate.value, syntax->immediate.value };
+            push_value(walk, interval);
+            break;
+        }
+        case VARIABLE:
+            push_value(walk, interval_of(syntax->variable.symbol));
+            break;
+        case UNARY_OPERATOR:
+            push_value(walk, unary_range(syntax->unary_expression.unary_type, pop_value(walk)));
+            break;
+        case BINARY_OPERATOR: {
+            Interval right = pop_value(walk);
+            Interval left = pop_value(walk);
+            push_value(walk, binary_range(syntax->binary_expression.binary_type, left, right));
+            break;
+        }
+        case FUNCTION_CALL:
+            truncate_values(walk, frame->value);
+            push_value(walk, ANY);
+            break;
+        case ARRAY_ACCESS: {
+            Interval index = pop_value(walk);
+            Symbol *symbol = syntax->array_access.symbol;
+            if (symbol != NULL) {
+                record_access(walk, syntax, symbol->array_size, index);
+            }
+            push_value(walk, ANY);
+            break;
+        }
+        case ARRAY_ASSIGNMENT: {
+            pop_value(walk);
+            Interval index = pop_value(walk);
+            Symbol *symbol = find_array(walk, syntax->array_assignment.array_name);
+            if (symbol != NULL) {
+                record_access(walk, syntax, symbol->array_size, index);
+            }
+            break;
+        }
+        case DEFINE_VAR: {
+            Interval value = pop_value(walk);
+            Symbol *symbol = syntax->define_var_statement.symbol;
+            if (symbol == NULL) break;
+            if (symbol->type == TYPE_ARRAY) {
+                vector_push_back(&walk->arrays, &symbol);
+            } else {
+                set_range(walk, symbol, value.low, value.high);
+            }
+            break;
+        }
+        case ASSIGNMENT: {
+            Interval value = pop_value(walk);
+            Symbol *symbol = syntax->assignment.symbol;
+            if (symbol != NULL && symbol->type != TYPE_ARRAY) {
+                set_range(walk, symbol, value.low, value.high);
+            }
+            break;
+        }
+        case RETURN_STATEMENT:
+            truncate_values(walk, frame->value);
+            walk->reachable = 0;
+            break;
+        case IF_STATEMENT:
+            join_branches(walk);
+            break;
+        default:
+            truncate_values(walk, frame->value);
+            break;
+    }
+}
+
+/* Analyze the array accesses of an analyzed tree, forgetting those of
+ * any tree analyzed before.
+ */
+void analyze_ranges(BoundsChecks *checks, Syntax *syntax) {
+    memset(checks->nodes, 0, checks->table_size * sizeof(Syntax *));
+    checks->count = 0;
+
+    RangeWalk walk;
+    walk.checks = checks;
+    vector_init(&walk.values, sizeof(Interval), NULL);
+    vector_init(&walk.changes, sizeof(Change), NULL);
+    vector_init(&walk.then_values, sizeof(Change), NULL);
+    vector_init(&walk.branches, sizeof(Branch), NULL);
+    vector_init(&walk.arrays, sizeof(Symbol *), NULL);
+    walk.reachable = 1;
+
+    Walker walker = { range_enter, range_before_child, range_leave, &walk };
+    walk_syntax(&walker, syntax);
+
+    vector_release(&walk.values);
+    vector_release(&walk.changes);
+    vector_release(&walk.then_values);
+    vector_release(&walk.branches);
+    vector_release(&walk.arrays);
+}
@@ -0,0 +1,23 @@
+#include <stddef.h>
+#include "syntax.h"
+#include "semantic.h"
+
+#ifndef RANGE_HEADER
+#define RANGE_HEADER
+
+/* The array accesses of an analyzed tree, each with the length of its
+ * array, or 0 where value-range analysis proved the index in range.
+ */
+typedef struct BoundsChecks {
+    Syntax **nodes; // Open-addressed by pointer
+    int *limits;
+    size_t table_size; // A power of two
+    size_t count;
+} BoundsChecks;
+
+BoundsChecks *bounds_checks_new(void);
+void bounds_checks_free(BoundsChecks *checks);
+void analyze_ranges(BoundsChecks *checks, Syntax *syntax);
+int bounds_check_limit(BoundsChecks *checks, Syntax *access);
+
+#endif
@@ -0,0 +1,316 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "scan.h"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+/* Stage one of lexing, in the style of simdjson: classify every byte of
+ * the source 64 bytes at a time, then resolve comment spans by walking
+ * only the '/', '*' and '\n' positions the classifier found. The lexer
+ * uses the resulting bitmaps to jump from one token boundary to the next.
+ */
+
+typedef struct BlockBits {
+    uint64_t whitespace;
+    uint64_t identifier;
+    uint64_t punctuation;
+    uint64_t newline;
+    uint64_t slash;
+    uint64_t star;
+} BlockBits;
+
+__attribute__((unused))
+static void classify_block_scalar(const unsigned char *block, BlockBits *bits) {
+    memset(bits, 0, sizeof(BlockBits));
+    for (int i = 0; i < 64; i++) {
+        uint64_t bit = (uint64_t)1 << i;
+        unsigned char c = block[i];
+        unsigned char lower = c | 0x20;
+        if (c == ' ' || (c >= '\t' && c <= '\r')) {
+            bits->whitespace |= bit;
+        } else if ((lower >= 'a' && lower <= 'z') || (c >= '0' && c <= '9') || c == '_') {
+            bits->identifier |= bit;
+        } else if (c >= '!' && c <= '~') {
+            bits->punctuation |= bit;
+        }
+        if (c == '\n') bits->newline |= bit;
+        if (c == '/') bits->slash |= bit;
+        if (c == '*') bits->star |= bit;
+    }
+}
+
+#if defined(__x86_64__)
+
+/* Unsigned lo <= v <= hi, using only SSE2. */
+static inline __m128i in_range_sse2(__m128i v, unsigned char lo, unsigned char hi) {
+    __m128i shifted = _mm_sub_epi8(v, _mm_set1_epi8((char)lo));
+    return _mm_cmpeq_epi8(_mm_min_epu8(shifted, _mm_set1_epi8((char)(hi - lo))), shifted);
+}
+
+__attribute__((unused))
+static void classify_block_sse2(const unsigned char *block, BlockBits *bits) {
+    memset(bits, 0, sizeof(BlockBits));
+    for (int i = 0; i < 4; i++) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(block + 16 * i));
+        __m128i space = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')), in_range_sse2(v, '\t', '\r'));
+        __m128i letter = in_range_sse2(_mm_or_si128(v, _mm_set1_epi8(0x20)), 'a', 'z');
+        __m128i ident = _mm_or_si128(_mm_or_si128(letter, in_range_sse2(v, '0', '9')),
+                                     _mm_cmpeq_epi8(v, _mm_set1_epi8('_')));
+        __m128i punct = _mm_andnot_si128(ident, in_range_sse2(v, '!', '~'));
+        int shift = 16 * i;
+        bits->whitespace |= (uint64_t)(uint16_t)_mm_movemask_epi8(space) << shift;
+        bits->identifier |= (uint64_t)(uint16_t)_mm_movemask_epi8(ident) << shift;
+        bits->punctuation |= (uint64_t)(uint16_t)_mm_movemask_epi8(punct) << shift;
+        bits->newline |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n'))) << shift;
+        bits->slash |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('/'))) << shift;
+        bits->star |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('*'))) << shift;
+    }
+}
+
+__attribute__((target("avx2")))
+static inline __m256i in_range_avx2(__m256i v, unsigned char lo, unsigned char hi) {
+    __m256i shifted = _mm256_sub_epi8(v, _mm256_set1_epi8((char)lo));
+    return _mm256_cmpeq_epi8(_mm256_min_epu8(shifted, _mm256_set1_epi8((char)(hi - lo))), shifted);
+}
+
+__attribute__((target("avx2"), unused))
+static void classify_block_avx2(const unsigned char *block, BlockBits *bits) {
+    memset(bits, 0, sizeof(BlockBits));
+    for (int i = 0; i < 2; i++) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(block + 32 * i));
+        __m256i space = _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')), in_range_avx2(v, '\t', '\r'));
+        __m256i letter = in_range_avx2(_mm256_or_si256(v, _mm256_set1_epi8(0x20)), 'a', 'z');
+        __m256i ident = _mm256_or_si256(_mm256_or_si256(letter, in_range_avx2(v, '0', '9')),
+                                        _mm256_cmpeq_epi8(v, _mm256_set1_epi8('_')));
+        __m256i punct = _mm256_andnot_si256(ident, in_range_avx2(v, '!', '~'));
+        int shift = 32 * i;
+        bits->whitespace |= (uint64_t)(uint32_t)_mm256_movemask_epi8(space) << shift;
+        bits->identifier |= (uint64_t)(uint32_t)_mm256_movemask_epi8(ident) << shift;
+        bits->punctuation |= (uint64_t)(uint32_t)_mm256_movemask_epi8(punct) << shift;
+        bits->newline |= (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n'))) << shift;
+        bits->slash |= (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('/'))) << shift;
+        bits->star |= (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('*'))) << shift;
+    }
+}
+
+#endif
+
+typedef void (*ClassifyFunction)(const unsigned char *block, BlockBits *bits);
+
+/* The widest classifier the CPU supports. Building with -D SCAN_SSE2 or
+ * -D SCAN_SCALAR caps it, so that bench/scan_bench can compare them.
+ */
+static ClassifyFunction select_classifier(void) {
+#if defined(__x86_64__) && !defined(SCAN_SCALAR)
+#if !defined(SCAN_SSE2)
+    if (__builtin_cpu_supports("avx2")) {
+        return classify_block_avx2;
+    }
+#endif
+    return classify_block_sse2;
+#else
+    return classify_block_scalar;
+#endif
+}
+
+/* Set the comment bits for bytes [start, end). */
+static void mark_comment(uint64_t *comment, size_t start, size_t end) {
+    if (start >= end) return;
+    size_t first = start / 64, last = (end - 1) / 64;
+    uint64_t head = ~(uint64_t)0 << (start % 64);
+    uint64_t tail = ~(uint64_t)0 >> (63 - (end - 1) % 64);
+    if (first == last) {
+        comment[first] |= head & tail;
+        return;
+    }
+    comment[first] |= head;
+    for (size_t b = first + 1; b < last; b++) {
+        comment[b] = ~(uint64_t)0;
+    }
+    comment[last] |= tail;
+}
+
+typedef enum {
+    IN_CODE,
+    IN_LINE_COMMENT,
+    IN_BLOCK_COMMENT
+} CommentState;
+
+StructuralIndex *structural_index_build(const char *text, size_t length) {
+    ClassifyFunction classify = select_classifier();
+
+    StructuralIndex *index = malloc(sizeof(StructuralIndex));
+    index->length = length;
+    index->block_count = (length + 63) / 64;
+    size_t words = index->block_count ? index->block_count : 1;
+    index->whitespace = malloc(words * sizeof(uint64_t));
+    index->comment = calloc(words, sizeof(uint64_t));
+    index->identifier = malloc(words * sizeof(uint64_t));
+    index->punctuation = malloc(words * sizeof(uint64_t));
+    index->unterminated_comment = length;
+
+    size_t newline_capacity = 1024;
+    index->newlines = malloc(newline_capacity * sizeof(size_t));
+    index->newline_count = 0;
+
+    CommentState state = IN_CODE;
+    size_t comment_start = 0;
+    size_t skip_until = 0; // Delimiter positions below this have been handled
+
+    for (size_t b = 0; b < index->block_count; b++) {
+        size_t base = b * 64;
+        BlockBits bits;
+        if (base + 64 <= length) {
+            classify((const unsigned char *)text + base, &bits);
+        } else {
+            unsigned char padded[64] = {0};
+            memcpy(padded, text + base, length - base);
+            classify(padded, &bits);
+        }
+        index->whitespace[b] = bits.whitespace;
+        index->identifier[b] = bits.identifier;
+        index->punctuation[b] = bits.punctuation;
+
+        for (uint64_t nl = bits.newline; nl != 0; nl &= nl - 1) {
+            if (index->newline_count == newline_capacity) {
+                newline_capacity *= 2;
+                index->newlines = realloc(index->newlines, newline_capacity * sizeof(size_t));
+            }
+            index->newlines[index->newline_count++] = base + __builtin_ctzll(nl);
+        }
+
+        // Only one kind of delimiter matters in each state, so step through
+        // just those positions.
+        for (;;) {
+            uint64_t candidates = state == IN_CODE ? bits.slash
+                                : state == IN_LINE_COMMENT ? bits.newline
+                                : bits.star;
+            if (skip_until > base) {
+                candidates = skip_until - base >= 64 ? 0 : candidates & (~(uint64_t)0 << (skip_until - base));
+            }
+            if (candidates == 0) break;
+
+            size_t position = base + __builtin_ctzll(candidates);
+            char next = position + 1 < length ? text[position + 1] : '\0';
+            skip_until = position + 1;
+
+            if (state == IN_CODE && next == '/') {
+                state = IN_LINE_COMMENT;
+                comment_start = position;
+                skip_until = position + 2;
+            } else if (state == IN_CODE && next == '*') {
+                state = IN_BLOCK_COMMENT;
+                comment_start = position;
+                skip_until = position + 2;
+            } else if (state == IN_LINE_COMMENT) {
+                mark_comment(index->comment, comment_start, position);
+                state = IN_CODE;
+            } else if (state == IN_BLOCK_COMMENT && next == '/') {
+                mark_comment(index->comment, comment_start, position + 2);
+                skip_until = position + 2;
+                state = IN_CODE;
+            }
+        }
+    }
+
+    if (state == IN_LINE_COMMENT) {
+        mark_comment(index->comment, comment_start, length);
+    } else if (state == IN_BLOCK_COMMENT) {
+        mark_comment(index->comment, comment_start, length);
+        index->unterminated_comment = comment_start;
+    }
+
+    return index;
+}
+
+void structural_index_free(StructuralIndex *index) {
+    if (index == NULL) return;
+    free(index->whitespace);
+    free(index->comment);
+    free(index->identifier);
+    free(index->punctuation);
+    free(index->newlines);
+    free(index);
+}
+
+/* The first offset >= position that is not whitespace or comment, or the
+ * length of the source if there is none.
+ */
+size_t structural_next_token(const StructuralIndex *index, size_t position) {
+    size_t b = position / 64;
+    if (b >= index->block_count) return index->length;
+
+    uint64_t token = ~(index->whitespace[b] | index->comment[b]) & (~(uint64_t)0 << (position % 64));
+    while (token == 0) {
+        if (++b >= index->block_count) return index->length;
+        token = ~(index->whitespace[b] | index->comment[b]);
+    }
+
+    size_t next = b * 64 + __builtin_ctzll(token);
+    return next < index->length ? next : index->length;
+}
+
+/* The first offset >= position that is not an identifier character. */
+size_t structural_identifier_end(const StructuralIndex *index, size_t position) {
+    size_t b = position / 64;
+    if (b >= index->block_count) return index->length;
+
+    uint64_t other = ~index->identifier[b] & (~(uint64_t)0 << (position % 64));
+    while (other == 0) {
+        if (++b >= index->block_count) return index->length;
+        other = ~index->identifier[b];
+    }
+
+    size_t end = b * 64 + __builtin_ctzll(other);
+    return end < index->length ? end : index->length;
+}
+
+/* 1-based line and column of an offset, by binary search over the
+ * newline index.
+ */
+void structural_line_column(const StructuralIndex *index, size_t position, int *line, int *column) {
+    size_t lo = 0, hi = index->newline_count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (index->newlines[mid] < position) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    size_t line_start = lo == 0 ? 0 : index->newlines[lo - 1] + 1;
+    *line = (int)lo + 1;
+    *column = (int)(position - line_start) + 1;
+}
+
+/* Find the end (one past the closing brace) of every top-level brace
+ * group, skipping braces inside comments. In a dd program those are the
+ * function bodies, so the source can be cut at these offsets into pieces
+ * that each parse on their own. Returns the number of offsets stored in
+ * *ends, which the caller frees.
+ */
+size_t structural_top_level_ends(const StructuralIndex *index, const char *text, size_t **ends) {
+    size_t capacity = 64, count = 0;
+    *ends = malloc(capacity * sizeof(size_t));
+    long depth = 0;
+
+    for (size_t b = 0; b < index->block_count; b++) {
+        for (uint64_t punct = index->punctuation[b] & ~index->comment[b]; punct != 0; punct &= punct - 1) {
+            size_t position = b * 64 + __builtin_ctzll(punct);
+            if (text[position] == '{') {
+                depth++;
+            } else if (text[position] == '}' && --depth == 0) {
+                if (count == capacity) {
+                    capacity *= 2;
+                    *ends = realloc(*ends, capacity * sizeof(size_t));
+                }
+                (*ends)[count++] = position + 1;
+            }
+        }
+    }
+
+    return count;
+}
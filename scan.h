@@ -0,0 +1,31 @@
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef SCAN_HEADER
+#define SCAN_HEADER
+
+/* A structural index of a source buffer, built in one vectorized pass
+ * before tokenizing. Each bitmap has one bit per source byte, packed
+ * into 64-bit words (bit i of word b describes byte 64 * b + i).
+ */
+typedef struct StructuralIndex {
+    size_t length;
+    size_t block_count;
+    uint64_t *whitespace;
+    uint64_t *comment; // Bytes inside // and /* */ comments, delimiters included
+    uint64_t *identifier; // [A-Za-z0-9_]
+    uint64_t *punctuation; // Any other printable character
+    size_t *newlines; // Offsets of every '\n', in order
+    size_t newline_count;
+    size_t unterminated_comment; // Offset of an unclosed /*, or length if none
+} StructuralIndex;
+
+StructuralIndex *structural_index_build(const char *text, size_t length);
+void structural_index_free(StructuralIndex *index);
+
+size_t structural_next_token(const StructuralIndex *index, size_t position);
+size_t structural_identifier_end(const StructuralIndex *index, size_t position);
+void structural_line_column(const StructuralIndex *index, size_t position, int *line, int *column);
+size_t structural_top_level_ends(const StructuralIndex *index, const char *text, size_t **ends);
+
+#endif
@@ -1,381 +1,652 @@
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include <err.h>
-#include "semantic.h"
-#include "list.h"
-
-Symbol *symbol_new(char *name, DataType type, int scope, int is_function, int array_size) {
-    Symbol *symbol = malloc(sizeof(Symbol));
-    symbol->name = strdup(name);
-    symbol->type = type;
-    symbol->scope = scope;
-    symbol->is_function = is_function;
-    symbol->parameters = is_function ? list_new() : NULL;
-    symbol->array_size = array_size;
-    return symbol;
-}
-
-void symbol_free(Symbol *symbol) {
-    if (symbol->name) free(symbol->name);
-    if (symbol->parameters) list_free(symbol->parameters);
-    free(symbol);
-}
-
-SymbolTable *symbol_table_new() {
-    SymbolTable *table = malloc(sizeof(SymbolTable));
-    table->symbols = list_new();
-    table->current_scope = 0;
-    return table;
-}
-
-void symbol_table_free(SymbolTable *table) {
-    for (int i = 0; i < list_length(table->symbols); i++) {
-        symbol_free((Symbol *)list_get(table->symbols, i));
-    }
-    list_free(table->symbols);
-    free(table);
-}
-
-void symbol_table_add(SymbolTable *table, char *name, DataType type, int is_function, int array_size) {
-    Symbol *symbol = symbol_new(name, type, table->current_scope, is_function, array_size);
-    list_append(table->symbols, symbol);
-}
-
-Symbol *symbol_table_lookup(SymbolTable *table, char *name, int scope) {
-    for (int i = 0; i < list_length(table->symbols); i++) {
-        Symbol *symbol = (Symbol *)list_get(table->symbols, i);
-        if (strcmp(symbol->name, name) == 0 && symbol->scope <= scope) {
-            return symbol;
-        }
-    }
-    return NULL;
-}
-
-SemanticAnalyzer *semantic_analyzer_new() {
-    SemanticAnalyzer *analyzer = malloc(sizeof(SemanticAnalyzer));
-    analyzer->table = symbol_table_new();
-    analyzer->errors = list_new();
-    analyzer->in_function = 0;
-    analyzer->current_function = NULL;
-    return analyzer;
-}
-
-void semantic_analyzer_free(SemanticAnalyzer *analyzer) {
-    symbol_table_free(analyzer->table);
-    for (int i = 0; i < list_length(analyzer->errors); i++) {
-        free(list_get(analyzer->errors, i));
-    }
-    list_free(analyzer->errors);
-    if (analyzer->current_function) free(analyzer->current_function);
-    free(analyzer);
-}
-
-void report_error(SemanticAnalyzer *analyzer, char *message, Syntax *syntax) {
-    char *error = malloc(256);
-    snprintf(error, 256, "Semantic Error: %s at %s", message, syntax_type_name(syntax));
-    list_append(analyzer->errors, error);
-}
-
-DataType get_expression_type(SemanticAnalyzer *analyzer, Syntax *syntax);
-
-void analyze_syntax(SemanticAnalyzer *analyzer, Syntax *syntax) {
-    if (!syntax) return;
-
-    switch (syntax->type) {
-        case TOP_LEVEL: {
-            List *declarations = syntax->top_level->declarations;
-            // First pass: Register all function declarations
-            for (int i = 0; i < list_length(declarations); i++) {
-                Syntax *decl = list_get(declarations, i);
-                if (decl->type == FUNCTION) {
-                    char *name = decl->function->name;
-                    if (symbol_table_lookup(analyzer->table, name, analyzer->table->current_scope)) {
-                        report_error(analyzer, "Function already declared", decl);
-                    } else {
-                        symbol_table_add(analyzer->table, name, TYPE_VOID, 1, 0);
-                        Symbol *func_symbol = symbol_table_lookup(analyzer->table, name, analyzer->table->current_scope);
-                        if (decl->function->parameters && decl->function->parameters->type == FUNCTION_ARGUMENTS) {
-                            List *params = decl->function->parameters->function_arguments->arguments;
-                            for (int j = 0; j < list_length(params); j++) {
-                                Syntax *param = list_get(params, j);
-                                if (param->type == DEFINE_VAR) {
-                                    char *param_name = param->define_var_statement->var_name;
-                                    list_append(func_symbol->parameters, strdup(param_name));
-                                }
-                            }
-                        }
-                    }
-                }
-            }
-            // Second pass: Analyze bodies of all declarations
-            for (int i = 0; i < list_length(declarations); i++) {
-                analyze_syntax(analyzer, list_get(declarations, i));
-            }
-            break;
-        }
-        case ARRAY_ASSIGNMENT: {
-            char *array_name = syntax->array_assignment->array_name;
-            Symbol *symbol = symbol_table_lookup(analyzer->table, array_name, analyzer->table->current_scope);
-            if (!symbol || symbol->type != TYPE_ARRAY) {
-                report_error(analyzer, "Assignment to non-array variable", syntax);
-            } else {
-                DataType index_type = get_expression_type(analyzer, syntax->array_assignment->index);
-                if (index_type != TYPE_INT) {
-                    report_error(analyzer, "Array index must be an integer", syntax);
-                }
-                DataType value_type = get_expression_type(analyzer, syntax->array_assignment->value);
-                if (value_type != TYPE_INT) {
-                    report_error(analyzer, "Array element must be an integer", syntax);
-                }
-                analyze_syntax(analyzer, syntax->array_assignment->index);
-                analyze_syntax(analyzer, syntax->array_assignment->value);
-            }
-            break;
-        }
-        case FUNCTION: {
-            char *name = syntax->function->name;
-            analyzer->in_function = 1;
-            analyzer->current_function = strdup(name);
-            analyzer->table->current_scope++;
-            // Analyze parameters
-            if (syntax->function->parameters && syntax->function->parameters->type == FUNCTION_ARGUMENTS) {
-                List *params = syntax->function->parameters->function_arguments->arguments;
-                for (int i = 0; i < list_length(params); i++) {
-                    Syntax *param = list_get(params, i);
-                    if (param->type == DEFINE_VAR) {
-                        char *param_name = param->define_var_statement->var_name;
-                        if (symbol_table_lookup(analyzer->table, param_name, analyzer->table->current_scope)) {
-                            report_error(analyzer, "Parameter already declared", param);
-                        } else {
-                            symbol_table_add(analyzer->table, param_name, TYPE_INT, 0, 0);
-                        }
-                    }
-                }
-            }
-            analyze_syntax(analyzer, syntax->function->root_block);
-            analyzer->table->current_scope--;
-            analyzer->in_function = 0;
-            free(analyzer->current_function);
-            analyzer->current_function = NULL;
-            break;
-        }
-        case BLOCK: {
-            analyzer->table->current_scope++;
-            List *statements = syntax->block->statements;
-            for (int i = 0; i < list_length(statements); i++) {
-                analyze_syntax(analyzer, list_get(statements, i));
-            }
-            // Clean up symbols in the current scope
-            for (int i = list_length(analyzer->table->symbols) - 1; i >= 0; i--) {
-                Symbol *symbol = list_get(analyzer->table->symbols, i);
-                if (symbol && symbol->scope >= analyzer->table->current_scope) {
-                    symbol_free(symbol);
-                    list_set(analyzer->table->symbols, i, NULL);
-                    list_pop(analyzer->table->symbols);
-                }
-            }
-            analyzer->table->current_scope--;
-            break;
-        }
-        case DEFINE_VAR: {
-            char *var_name = syntax->define_var_statement->var_name;
-            if (symbol_table_lookup(analyzer->table, var_name, analyzer->table->current_scope)) {
-                report_error(analyzer, "Variable already declared in this scope", syntax);
-            } else {
-                DataType init_type = get_expression_type(analyzer, syntax->define_var_statement->init_value);
-                if (init_type == TYPE_ARRAY) {
-                    if (syntax->define_var_statement->init_value->type != ARRAY_TYPE ||
-                        !syntax->define_var_statement->init_value->immediate) {
-                        report_error(analyzer, "Invalid array declaration", syntax);
-                    } else {
-                        int array_size = syntax->define_var_statement->init_value->immediate->value;
-                        if (array_size <= 0) {
-                            report_error(analyzer, "Array size must be positive", syntax);
-                        } else {
-                            symbol_table_add(analyzer->table, var_name, TYPE_ARRAY, 0, array_size);
-                        }
-                    }
-                } else if (init_type == TYPE_VOID) {
-                    report_error(analyzer, "Variable initialized with void type", syntax);
-                } else {
-                    symbol_table_add(analyzer->table, var_name, init_type, 0, 0);
-                }
-                analyze_syntax(analyzer, syntax->define_var_statement->init_value);
-            }
-            break;
-        }
-        case ASSIGNMENT: {
-            char *var_name = syntax->assignment->var_name;
-            Symbol *symbol = symbol_table_lookup(analyzer->table, var_name, analyzer->table->current_scope);
-            if (!symbol || symbol->is_function) {
-                report_error(analyzer, "Assignment to undeclared variable or function", syntax);
-            } else {
-                DataType expr_type = get_expression_type(analyzer, syntax->assignment->expression);
-                if (expr_type != symbol->type && !(symbol->type == TYPE_ARRAY && expr_type == TYPE_INT)) {
-                    report_error(analyzer, "Type mismatch in assignment", syntax);
-                }
-                analyze_syntax(analyzer, syntax->assignment->expression);
-            }
-            break;
-        }
-        case VARIABLE: {
-            char *var_name = syntax->variable->var_name;
-            if (!symbol_table_lookup(analyzer->table, var_name, analyzer->table->current_scope)) {
-                report_error(analyzer, "Use of undeclared variable", syntax);
-            }
-            break;
-        }
-        case FUNCTION_CALL: {
-            char *func_name = syntax->function_call->function_name;
-            Symbol *symbol = symbol_table_lookup(analyzer->table, func_name, analyzer->table->current_scope);
-            if (!symbol || !symbol->is_function) {
-                report_error(analyzer, "Call to undeclared function", syntax);
-            }
-            analyze_syntax(analyzer, syntax->function_call->function_arguments);
-            break;
-        }
-        case FUNCTION_ARGUMENTS: {
-            List *args = syntax->function_arguments->arguments;
-            for (int i = 0; i < list_length(args); i++) {
-                analyze_syntax(analyzer, list_get(args, i));
-            }
-            break;
-        }
-        case IF_STATEMENT: {
-            DataType cond_type = get_expression_type(analyzer, syntax->if_statement->condition);
-            if (cond_type != TYPE_BOOL) {
-                report_error(analyzer, "If condition must be boolean", syntax);
-            }
-            analyze_syntax(analyzer, syntax->if_statement->condition);
-            analyze_syntax(analyzer, syntax->if_statement->then_stmts);
-            if (syntax->if_statement->else_stmts) {
-                analyze_syntax(analyzer, syntax->if_statement->else_stmts);
-            }
-            break;
-        }
-        case RETURN_STATEMENT: {
-            if (!analyzer->in_function) {
-                report_error(analyzer, "Return statement outside function", syntax);
-            } else {
-                analyze_syntax(analyzer, syntax->return_statement->expression);
-            }
-            break;
-        }
-        case PRINT_STATEMENT: {
-            DataType expr_type = get_expression_type(analyzer, syntax->print_statement->expression);
-            if (expr_type != TYPE_INT) {
-                report_error(analyzer, "Print statement requires integer expression", syntax);
-            }
-            analyze_syntax(analyzer, syntax->print_statement->expression);
-            break;
-        }
-        case ARRAY_TYPE: {
-            if (syntax->array_access) { // Fixed: array_expression -> array_access
-                char *array_name = syntax->array_access->array_name;
-                Symbol *symbol = symbol_table_lookup(analyzer->table, array_name, analyzer->table->current_scope);
-                if (!symbol || symbol->type != TYPE_ARRAY) {
-                    report_error(analyzer, "Use of undeclared array", syntax);
-                } else {
-                    DataType index_type = get_expression_type(analyzer, syntax->array_access->index);
-                    if (index_type != TYPE_INT) {
-                        report_error(analyzer, "Array index must be an integer", syntax);
-                    }
-                    analyze_syntax(analyzer, syntax->array_access->index);
-                }
-            }
-            break;
-        }
-        case BINARY_OPERATOR: {
-            analyze_syntax(analyzer, syntax->binary_expression->left);
-            analyze_syntax(analyzer, syntax->binary_expression->right);
-            break;
-        }
-        case UNARY_OPERATOR: {
-            analyze_syntax(analyzer, syntax->unary_expression->expression);
-            break;
-        }
-        case IMMEDIATE: {
-            break;
-        }
-        default:
-            warnx("Unknown syntax type in semantic analysis: %s", syntax_type_name(syntax));
-            break;
-    }
-}
-
-DataType get_expression_type(SemanticAnalyzer *analyzer, Syntax *syntax) {
-    if (!syntax) return TYPE_VOID;
-
-    switch (syntax->type) {
-        case IMMEDIATE:
-            return TYPE_INT;
-        case VARIABLE: {
-            Symbol *symbol = symbol_table_lookup(analyzer->table, syntax->variable->var_name, analyzer->table->current_scope);
-            return symbol ? symbol->type : TYPE_VOID;
-        }
-        case ARRAY_TYPE: {
-            if (syntax->array_access) { // Fixed: array_expression -> array_access
-                Symbol *symbol = symbol_table_lookup(analyzer->table, syntax->array_access->array_name, analyzer->table->current_scope);
-                if (symbol && symbol->type == TYPE_ARRAY) {
-                    return TYPE_INT; // Array elements are integers
-                }
-                return TYPE_VOID;
-            }
-            return TYPE_ARRAY;
-        }
-        case BINARY_OPERATOR: {
-            BinaryExpression *bin = syntax->binary_expression;
-            DataType left_type = get_expression_type(analyzer, bin->left);
-            DataType right_type = get_expression_type(analyzer, bin->right);
-            if (left_type == TYPE_VOID || right_type == TYPE_VOID) {
-                report_error(analyzer, "Invalid operand types in binary operation", syntax);
-                return TYPE_VOID;
-            }
-            if (bin->binary_type == GREATER || bin->binary_type == LESS ||
-                bin->binary_type == EQUALS || bin->binary_type == GREATER_EQUALS ||
-                bin->binary_type == LESS_EQUALS) {
-                return TYPE_BOOL;
-            }
-            if (left_type != TYPE_INT || right_type != TYPE_INT) {
-                report_error(analyzer, "Binary operation requires integer operands", syntax);
-                return TYPE_VOID;
-            }
-            return TYPE_INT;
-        }
-        case UNARY_OPERATOR: {
-            UnaryExpression *unary = syntax->unary_expression;
-            DataType expr_type = get_expression_type(analyzer, unary->expression);
-            if (expr_type == TYPE_VOID) {
-                report_error(analyzer, "Invalid operand type in unary operation", syntax);
-                return TYPE_VOID;
-            }
-            if (unary->unary_type == LOGICAL_NEGATION) {
-                if (expr_type != TYPE_BOOL) {
-                    report_error(analyzer, "Logical negation requires boolean operand", syntax);
-                    return TYPE_VOID;
-                }
-                return TYPE_BOOL;
-            }
-            if (expr_type != TYPE_INT) {
-                report_error(analyzer, "Unary operation requires integer operand", syntax);
-                return TYPE_VOID;
-            }
-            return TYPE_INT;
-        }
-        case FUNCTION_CALL: {
-            Symbol *symbol = symbol_table_lookup(analyzer->table, syntax->function_call->function_name, analyzer->table->current_scope);
-            return symbol ? symbol->type : TYPE_VOID;
-        }
-        default:
-            return TYPE_VOID;
-    }
-}
-
-void analyze_semantics(SemanticAnalyzer *analyzer, Syntax *syntax) {
-    analyze_syntax(analyzer, syntax);
-}
-
-List *get_semantic_errors(SemanticAnalyzer *analyzer) {
-    return analyzer->errors;
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <err.h>
+#include <pthread.h>
+#include "semantic.h"
+#include "list.h"
+#include "walk.h"
+
+/* Functions live as long as the analyzer. A variable is allocated with
+ * the tree that declares it, since the tree's nodes point to it and code
+ * generation reads it after the variable has gone out of scope.
+ */
+Symbol *symbol_new(Arena *arena, Name name, DataType type, int scope, int is_function, int array_size) {
+    Symbol *symbol = is_function ? malloc(sizeof(Symbol)) : arena_alloc(arena, sizeof(Symbol));
+    symbol->name = name;
+    symbol->type = type;
+    symbol->scope = scope;
+    symbol->is_function = is_function;
+    symbol->parameters = is_function ? list_new() : NULL;
+    symbol->array_size = array_size;
+    symbol->shadowed = NULL;
+    symbol->value = -1; // Not yet lowered
+    symbol->low = 0;
+    symbol->high = 0;
+    symbol->definition = NULL;
+    symbol->pure = is_function;
+    symbol->callees = NULL;
+    symbol->callers = NULL;
+    return symbol;
+}
+
+void symbol_free(Symbol *symbol) {
+    if (!symbol->is_function) return;
+    list_free(symbol->parameters);
+    if (symbol->callees) list_free(symbol->callees);
+    if (symbol->callers) list_free(symbol->callers);
+    free(symbol);
+}
+
+#define INITIAL_TABLE_SIZE 64
+
+SymbolTable *symbol_table_new() {
+    SymbolTable *table = malloc(sizeof(SymbolTable));
+    table->table_size = INITIAL_TABLE_SIZE;
+    table->name_count = 0;
+    table->names = calloc(table->table_size, sizeof(Name));
+    table->innermost = calloc(table->table_size, sizeof(Symbol *));
+    vector_init(&table->declared, sizeof(Symbol *), NULL);
+    vector_init(&table->scopes, sizeof(size_t), NULL);
+    table->current_scope = 0;
+    table->arena = NULL;
+    table->parent = NULL;
+    return table;
+}
+
+void symbol_table_free(SymbolTable *table) {
+    for (size_t i = 0; i < vector_length(&table->declared); i++) {
+        symbol_free(*(Symbol **)vector_at(&table->declared, i));
+    }
+    vector_release(&table->declared);
+    vector_release(&table->scopes);
+    free(table->names);
+    free(table->innermost);
+    free(table);
+}
+
+/* The slot holding name, or the empty slot where it belongs. Names are
+ * interned, so the pointer itself is the key.
+ */
+static size_t find_slot(SymbolTable *table, Name name) {
+    size_t mask = table->table_size - 1;
+    size_t slot = ((uintptr_t)name * 0x9E3779B97F4A7C15ull >> 32) & mask;
+    while (table->names[slot] != NULL && table->names[slot] != name) {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+static void grow_table(SymbolTable *table) {
+    Name *names = table->names;
+    Symbol **innermost = table->innermost;
+    size_t size = table->table_size;
+
+    table->table_size *= 2;
+    table->names = calloc(table->table_size, sizeof(Name));
+    table->innermost = calloc(table->table_size, sizeof(Symbol *));
+    for (size_t i = 0; i < size; i++) {
+        if (names[i] == NULL) continue;
+        size_t slot = find_slot(table, names[i]);
+        table->names[slot] = names[i];
+        table->innermost[slot] = innermost[i];
+    }
+    free(names);
+    free(innermost);
+}
+
+Symbol *symbol_table_add(SymbolTable *table, Name name, DataType type, int is_function, int array_size) {
+    if ((table->name_count + 1) * 2 > table->table_size) {
+        grow_table(table);
+    }
+    size_t slot = find_slot(table, name);
+    if (table->names[slot] == NULL) {
+        table->names[slot] = name;
+        table->name_count++;
+    }
+
+    Symbol *symbol = symbol_new(table->arena, name, type, table->current_scope, is_function, array_size);
+    symbol->shadowed = table->innermost[slot];
+    table->innermost[slot] = symbol;
+    vector_push_back(&table->declared, &symbol);
+    return symbol;
+}
+
+/* The innermost symbol called name declared at or outside scope. */
+Symbol *symbol_table_lookup(SymbolTable *table, Name name, int scope) {
+    Symbol *symbol = table->innermost[find_slot(table, name)];
+    while (symbol != NULL && symbol->scope > scope) {
+        symbol = symbol->shadowed;
+    }
+    if (symbol == NULL && table->parent != NULL) {
+        return symbol_table_lookup(table->parent, name, scope);
+    }
+    return symbol;
+}
+
+void symbol_table_enter_scope(SymbolTable *table) {
+    size_t mark = vector_length(&table->declared);
+    vector_push_back(&table->scopes, &mark);
+    table->current_scope++;
+}
+
+/* Remove the symbols declared since the matching enter. */
+void symbol_table_exit_scope(SymbolTable *table) {
+    size_t mark;
+    vector_pop_back(&table->scopes, &mark);
+    while (vector_length(&table->declared) > mark) {
+        Symbol *symbol;
+        vector_pop_back(&table->declared, &symbol);
+        table->innermost[find_slot(table, symbol->name)] = symbol->shadowed;
+        symbol_free(symbol);
+    }
+    table->current_scope--;
+}
+
+SemanticAnalyzer *semantic_analyzer_new() {
+    SemanticAnalyzer *analyzer = malloc(sizeof(SemanticAnalyzer));
+    analyzer->table = symbol_table_new();
+    analyzer->errors = list_new();
+    analyzer->in_function = 0;
+    analyzer->current_function = NULL;
+    analyzer->function_symbol = NULL;
+    return analyzer;
+}
+
+void semantic_analyzer_free(SemanticAnalyzer *analyzer) {
+    symbol_table_free(analyzer->table);
+    for (int i = 0; i < list_length(analyzer->errors); i++) {
+        free(list_get(analyzer->errors, i));
+    }
+    list_free(analyzer->errors);
+    free(analyzer);
+}
+
+void report_error(SemanticAnalyzer *analyzer, char *message, Syntax *syntax) {
+    char *error = malloc(256);
+    snprintf(error, 256, "Semantic Error: %s at %s", message, syntax_type_name(syntax));
+    list_append(analyzer->errors, error);
+}
+
+/* The type of an analyzed expression. */
+DataType get_expression_type(Syntax *syntax) {
+    return syntax ? syntax->data_type : TYPE_VOID;
+}
+
+static int is_parameter(Symbol *function, Name name) {
+    for (int i = 0; i < list_length(function->parameters); i++) {
+        if (list_get(function->parameters, i) == name) return 1;
+    }
+    return 0;
+}
+
+/* Analysis is one walk over the tree. Names are resolved on the way down,
+ * and each expression's type is computed on the way up, from the types
+ * already stored on its operands, and stored on the node. Checks that
+ * need the type of a child are made once that child has been left.
+ */
+static int analyze_enter(Walker *walker, WalkFrame *frame, WalkFrame *parent) {
+    (void)parent;
+    SemanticAnalyzer *analyzer = walker->data;
+    Syntax *syntax = frame->node;
+
+    switch (syntax->type) {
+        case TOP_LEVEL:
+            analyzer->table->arena = syntax->top_level.arena;
+            // First pass: Register all function declarations. The
+            // declarations themselves are the children.
+            analyze_signatures(analyzer, syntax);
+            return 1;
+        case ARRAY_ASSIGNMENT: {
+            Name array_name = syntax->array_assignment.array_name;
+            Symbol *symbol = symbol_table_lookup(analyzer->table, array_name, analyzer->table->current_scope);
+            if (!symbol || symbol->type != TYPE_ARRAY) {
+                report_error(analyzer, "Assignment to non-array variable", syntax);
+                return 0;
+            }
+            // Parameters cannot be shadowed, so the name alone says whether
+            // the array was passed in.
+            if (analyzer->function_symbol && is_parameter(analyzer->function_symbol, array_name)) {
+                analyzer->function_symbol->pure = 0;
+            }
+            return 1;
+        }
+        case FUNCTION: {
+            Name name = syntax->function.name;
+            analyzer->in_function = 1;
+            analyzer->current_function = name;
+            // A function whose name was taken has no symbol of its own.
+            Symbol *function_symbol = symbol_table_lookup(analyzer->table, name, analyzer->table->current_scope);
+            analyzer->function_symbol = function_symbol && function_symbol->definition == syntax ? function_symbol : NULL;
+            symbol_table_enter_scope(analyzer->table);
+            // Analyze parameters
+            if (syntax->function.parameters && syntax->function.parameters->type == FUNCTION_ARGUMENTS) {
+                List *params = syntax->function.parameters->function_arguments.arguments;
+                for (int i = 0; i < list_length(params); i++) {
+                    Syntax *param = list_get(params, i);
+                    if (param->type == DEFINE_VAR) {
+                        Name param_name = param->define_var_statement.var_name;
+                        if (symbol_table_lookup(analyzer->table, param_name, analyzer->table->current_scope)) {
+                            report_error(analyzer, "Parameter already declared", param);
+                        } else {
+                            param->define_var_statement.symbol = symbol_table_add(analyzer->table, param_name, TYPE_INT, 0, 0);
+                        }
+                    }
+                }
+            }
+            return 1;
+        }
+        case BLOCK:
+            symbol_table_enter_scope(analyzer->table);
+            return 1;
+        case DEFINE_VAR: {
+            Name var_name = syntax->define_var_statement.var_name;
+            if (symbol_table_lookup(analyzer->table, var_name, analyzer->table->current_scope)) {
+                report_error(analyzer, "Variable already declared in this scope", syntax);
+                return 0;
+            }
+            return 1;
+        }
+        case ASSIGNMENT: {
+            Name var_name = syntax->assignment.var_name;
+            Symbol *symbol = symbol_table_lookup(analyzer->table, var_name, analyzer->table->current_scope);
+            if (!symbol || symbol->is_function) {
+                report_error(analyzer, "Assignment to undeclared variable or function", syntax);
+                return 0;
+            }
+            syntax->assignment.symbol = symbol;
+            return 1;
+        }
+        case VARIABLE: {
+            Name var_name = syntax->variable.var_name;
+            Symbol *symbol = symbol_table_lookup(analyzer->table, var_name, analyzer->table->current_scope);
+            if (!symbol) {
+                report_error(analyzer, "Use of undeclared variable", syntax);
+            }
+            syntax->variable.symbol = symbol;
+            syntax->data_type = symbol ? symbol->type : TYPE_VOID;
+            return 0;
+        }
+        case FUNCTION_CALL: {
+            Name func_name = syntax->function_call.function_name;
+            Symbol *symbol = symbol_table_lookup(analyzer->table, func_name, analyzer->table->current_scope);
+            if (!symbol || !symbol->is_function) {
+                report_error(analyzer, "Call to undeclared function", syntax);
+            } else if (analyzer->function_symbol) {
+                if (!analyzer->function_symbol->callees) {
+                    analyzer->function_symbol->callees = list_new();
+                }
+                list_append(analyzer->function_symbol->callees, symbol);
+            }
+            // A call is worth the word its callee returns.
+            syntax->data_type = symbol && symbol->is_function ? TYPE_INT : TYPE_VOID;
+            return 1;
+        }
+        case RETURN_STATEMENT:
+            if (!analyzer->in_function) {
+                report_error(analyzer, "Return statement outside function", syntax);
+                return 0;
+            }
+            return 1;
+        case ARRAY_ACCESS: {
+            Name array_name = syntax->array_access.array_name;
+            Symbol *symbol = symbol_table_lookup(analyzer->table, array_name, analyzer->table->current_scope);
+            if (!symbol || symbol->type != TYPE_ARRAY) {
+                report_error(analyzer, "Use of undeclared array", syntax);
+                return 0;
+            }
+            syntax->array_access.symbol = symbol;
+            // Array elements are integers
+            syntax->data_type = TYPE_INT;
+            return 1;
+        }
+        case IMMEDIATE:
+            syntax->data_type = TYPE_INT;
+            return 0;
+        case ARRAY_TYPE:
+            syntax->data_type = TYPE_ARRAY;
+            return 0;
+        case PRINT_STATEMENT:
+            if (analyzer->function_symbol) {
+                analyzer->function_symbol->pure = 0;
+            }
+            return 1;
+        case IF_STATEMENT:
+        case FUNCTION_ARGUMENTS:
+        case BINARY_OPERATOR:
+        case UNARY_OPERATOR:
+            return 1;
+        default:
+            warnx("Unknown syntax type in semantic analysis: %s", syntax_type_name(syntax));
+            return 0;
+    }
+}
+
+static int analyze_before_child(Walker *walker, WalkFrame *frame, int index, Syntax *child) {
+    (void)child;
+    SemanticAnalyzer *analyzer = walker->data;
+    Syntax *syntax = frame->node;
+
+    // Parameters were registered on entering the function.
+    if (syntax->type == FUNCTION && index == 0) {
+        return 0;
+    }
+    // The condition has been analyzed; check it before the branches.
+    if (syntax->type == IF_STATEMENT && index == 1) {
+        if (get_expression_type(syntax->if_statement.condition) != TYPE_BOOL) {
+            report_error(analyzer, "If condition must be boolean", syntax);
+        }
+    }
+    return 1;
+}
+
+static DataType binary_type(SemanticAnalyzer *analyzer, Syntax *syntax) {
+    BinaryExpression *bin = &syntax->binary_expression;
+    DataType left_type = get_expression_type(bin->left);
+    DataType right_type = get_expression_type(bin->right);
+    if (left_type == TYPE_VOID || right_type == TYPE_VOID) {
+        report_error(analyzer, "Invalid operand types in binary operation", syntax);
+        return TYPE_VOID;
+    }
+    if (bin->binary_type == GREATER || bin->binary_type == LESS ||
+        bin->binary_type == EQUALS || bin->binary_type == GREATER_EQUALS ||
+        bin->binary_type == LESS_EQUALS) {
+        return TYPE_BOOL;
+    }
+    if (left_type != TYPE_INT || right_type != TYPE_INT) {
+        report_error(analyzer, "Binary operation requires integer operands", syntax);
+        return TYPE_VOID;
+    }
+    return TYPE_INT;
+}
+
+static DataType unary_type(SemanticAnalyzer *analyzer, Syntax *syntax) {
+    UnaryExpression *unary = &syntax->unary_expression;
+    DataType expr_type = get_expression_type(unary->expression);
+    if (expr_type == TYPE_VOID) {
+        report_error(analyzer, "Invalid operand type in unary operation", syntax);
+        return TYPE_VOID;
+    }
+    if (unary->unary_type == LOGICAL_NEGATION) {
+        if (expr_type != TYPE_BOOL) {
+            report_error(analyzer, "Logical negation requires boolean operand", syntax);
+            return TYPE_VOID;
+        }
+        return TYPE_BOOL;
+    }
+    if (expr_type != TYPE_INT) {
+        report_error(analyzer, "Unary operation requires integer operand", syntax);
+        return TYPE_VOID;
+    }
+    return TYPE_INT;
+}
+
+static void analyze_define_var(SemanticAnalyzer *analyzer, Syntax *syntax) {
+    DefineVarStatement *define_var_statement = &syntax->define_var_statement;
+    Name var_name = define_var_statement->var_name;
+    DataType init_type = get_expression_type(define_var_statement->init_value);
+    if (init_type == TYPE_ARRAY) {
+        if (define_var_statement->init_value->type != ARRAY_TYPE) {
+            report_error(analyzer, "Invalid array declaration", syntax);
+        } else {
+            int array_size = define_var_statement->init_value->immediate.value;
+            if (array_size <= 0) {
+                report_error(analyzer, "Array size must be positive", syntax);
+            } else {
+                define_var_statement->symbol = symbol_table_add(analyzer->table, var_name, TYPE_ARRAY, 0, array_size);
+            }
+        }
+    } else if (init_type == TYPE_VOID) {
+        report_error(analyzer, "Variable initialized with void type", syntax);
+    } else {
+        define_var_statement->symbol = symbol_table_add(analyzer->table, var_name, init_type, 0, 0);
+    }
+}
+
+static void analyze_leave(Walker *walker, WalkFrame *frame) {
+    SemanticAnalyzer *analyzer = walker->data;
+    Syntax *syntax = frame->node;
+
+    switch (syntax->type) {
+        case FUNCTION:
+            // Parameters go out of scope with the function.
+            symbol_table_exit_scope(analyzer->table);
+            analyzer->in_function = 0;
+            analyzer->current_function = NULL;
+            analyzer->function_symbol = NULL;
+            break;
+        case BLOCK:
+            symbol_table_exit_scope(analyzer->table);
+            break;
+        case BINARY_OPERATOR:
+            syntax->data_type = binary_type(analyzer, syntax);
+            break;
+        case UNARY_OPERATOR:
+            syntax->data_type = unary_type(analyzer, syntax);
+            break;
+        case DEFINE_VAR:
+            // Skipped if the name was taken, and then has no symbol.
+            if (frame->child_count > 0) {
+                analyze_define_var(analyzer, syntax);
+            }
+            break;
+        case ASSIGNMENT:
+            if (syntax->assignment.symbol != NULL) {
+                Symbol *symbol = syntax->assignment.symbol;
+                DataType expr_type = get_expression_type(syntax->assignment.expression);
+                if (expr_type != symbol->type && !(symbol->type == TYPE_ARRAY && expr_type == TYPE_INT)) {
+                    report_error(analyzer, "Type mismatch in assignment", syntax);
+                }
+            }
+            break;
+        case PRINT_STATEMENT:
+            if (get_expression_type(syntax->print_statement.expression) != TYPE_INT) {
+                report_error(analyzer, "Print statement requires integer expression", syntax);
+            }
+            break;
+        case ARRAY_ACCESS:
+            if (syntax->array_access.symbol != NULL
+                && get_expression_type(syntax->array_access.index) != TYPE_INT) {
+                report_error(analyzer, "Array index must be an integer", syntax);
+            }
+            break;
+        case ARRAY_ASSIGNMENT:
+            // Skipped if the name is not an array.
+            if (frame->child_count > 0) {
+                if (get_expression_type(syntax->array_assignment.index) != TYPE_INT) {
+                    report_error(analyzer, "Array index must be an integer", syntax);
+                }
+                if (get_expression_type(syntax->array_assignment.value) != TYPE_INT) {
+                    report_error(analyzer, "Array element must be an integer", syntax);
+                }
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+void analyze_syntax(SemanticAnalyzer *analyzer, Syntax *syntax) {
+    Walker walker = { analyze_enter, analyze_before_child, analyze_leave, analyzer };
+    walk_syntax(&walker, syntax);
+}
+
+/* Register the signature of every function in a TOP_LEVEL, so that
+ * bodies may call functions declared after them.
+ */
+void analyze_signatures(SemanticAnalyzer *analyzer, Syntax *top_level) {
+    List *declarations = top_level->top_level.declarations;
+    for (int i = 0; i < list_length(declarations); i++) {
+        Syntax *decl = list_get(declarations, i);
+        if (decl->type == FUNCTION) {
+            Name name = decl->function.name;
+            if (symbol_table_lookup(analyzer->table, name, analyzer->table->current_scope)) {
+                report_error(analyzer, "Function already declared", decl);
+            } else {
+                Symbol *func_symbol = symbol_table_add(analyzer->table, name, TYPE_VOID, 1, 0);
+                func_symbol->definition = decl;
+                if (decl->function.parameters && decl->function.parameters->type == FUNCTION_ARGUMENTS) {
+                    List *params = decl->function.parameters->function_arguments.arguments;
+                    for (int j = 0; j < list_length(params); j++) {
+                        Syntax *param = list_get(params, j);
+                        if (param->type == DEFINE_VAR) {
+                            Name param_name = param->define_var_statement.var_name;
+                            list_append(func_symbol->parameters, (void *)param_name);
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+void analyze_declarations(SemanticAnalyzer *analyzer, Syntax *top_level) {
+    analyzer->table->arena = top_level->top_level.arena;
+    List *declarations = top_level->top_level.declarations;
+    for (int i = 0; i < list_length(declarations); i++) {
+        analyze_syntax(analyzer, list_get(declarations, i));
+    }
+}
+
+void analyze_semantics(SemanticAnalyzer *analyzer, Syntax *syntax) {
+    analyze_syntax(analyzer, syntax);
+}
+
+/* Finish classifying the functions of an analyzed TOP_LEVEL as pure.
+ * Analysis has already cleared pure for the functions that print or
+ * write an array they were passed; here that spreads from each such
+ * function to everything that calls it, directly or not.
+ */
+void classify_functions(SemanticAnalyzer *analyzer, Syntax *top_level) {
+    List *declarations = top_level->top_level.declarations;
+    Vector impure;
+    vector_init(&impure, sizeof(Symbol *), NULL);
+    for (int i = 0; i < list_length(declarations); i++) {
+        Syntax *decl = list_get(declarations, i);
+        Symbol *function = symbol_table_lookup(analyzer->table, decl->function.name, 0);
+        if (!function || function->definition != decl) continue;
+        if (!function->pure) {
+            vector_push_back(&impure, &function);
+        }
+        int callee_count = function->callees ? list_length(function->callees) : 0;
+        for (int j = 0; j < callee_count; j++) {
+            Symbol *callee = list_get(function->callees, j);
+            if (!callee->callers) {
+                callee->callers = list_new();
+            }
+            list_append(callee->callers, function);
+        }
+    }
+
+    while (vector_length(&impure) > 0) {
+        Symbol *function;
+        vector_pop_back(&impure, &function);
+        int caller_count = function->callers ? list_length(function->callers) : 0;
+        for (int i = 0; i < caller_count; i++) {
+            Symbol *caller = list_get(function->callers, i);
+            if (caller->pure) {
+                caller->pure = 0;
+                vector_push_back(&impure, &caller);
+            }
+        }
+    }
+    vector_release(&impure);
+}
+
+typedef struct FunctionErrors {
+    List *errors; // Of the worker that analyzed the function
+    int begin, end; // The function's errors in that list
+} FunctionErrors;
+
+typedef struct AnalysisJob {
+    SemanticAnalyzer *analyzer; // Of this worker, over the shared globals
+    List *declarations;
+    FunctionErrors *results; // One per declaration
+    int *next; // The next declaration to claim, shared by all workers
+    pthread_t thread;
+    int started;
+} AnalysisJob;
+
+static void *run_analysis_job(void *data) {
+    AnalysisJob *job = data;
+    int count = list_length(job->declarations);
+    int i;
+    while ((i = __atomic_fetch_add(job->next, 1, __ATOMIC_RELAXED)) < count) {
+        FunctionErrors *result = &job->results[i];
+        result->errors = job->analyzer->errors;
+        result->begin = list_length(job->analyzer->errors);
+        analyze_syntax(job->analyzer, list_get(job->declarations, i));
+        result->end = list_length(job->analyzer->errors);
+    }
+    return NULL;
+}
+
+/* Analyze a TOP_LEVEL with up to `jobs` threads. Once the signatures are
+ * registered, function bodies depend only on them, so each worker claims
+ * functions in turn and checks them with a scope table of its own over
+ * the shared table of functions. Workers add no symbols to that table,
+ * but do write two fields of the Symbol of the function they analyze:
+ * they clear pure, and append to callees. No two workers write the same
+ * Symbol, since each function is claimed once and a function whose name
+ * was taken has no Symbol of its own, and those fields are read only by
+ * classify_functions(), once the workers are joined. Errors are gathered
+ * in source order, so they are exactly those of analyze_semantics().
+ */
+void analyze_semantics_parallel(SemanticAnalyzer *analyzer, Syntax *syntax, int jobs) {
+    if (jobs < 2 || syntax->type != TOP_LEVEL || list_length(syntax->top_level.declarations) < 2) {
+        analyze_semantics(analyzer, syntax);
+        return;
+    }
+
+    List *declarations = syntax->top_level.declarations;
+    int count = list_length(declarations);
+    if (jobs > count) {
+        jobs = count;
+    }
+    analyze_signatures(analyzer, syntax);
+
+    // Symbols are allocated in arenas of the workers' own, which the tree
+    // adopts afterwards.
+    FunctionErrors *results = malloc(count * sizeof(FunctionErrors));
+    AnalysisJob *job = calloc(jobs, sizeof(AnalysisJob));
+    int next = 0;
+    for (int i = 0; i < jobs; i++) {
+        job[i].analyzer = semantic_analyzer_new();
+        job[i].analyzer->table->parent = analyzer->table;
+        job[i].analyzer->table->arena = arena_new();
+        job[i].declarations = declarations;
+        job[i].results = results;
+        job[i].next = &next;
+    }
+
+    // The calling thread works alongside the others.
+    for (int i = 1; i < jobs; i++) {
+        job[i].started = pthread_create(&job[i].thread, NULL, run_analysis_job, &job[i]) == 0;
+    }
+    run_analysis_job(&job[0]);
+    for (int i = 1; i < jobs; i++) {
+        if (job[i].started) {
+            pthread_join(job[i].thread, NULL);
+        }
+    }
+
+    for (int i = 0; i < count; i++) {
+        for (int j = results[i].begin; j < results[i].end; j++) {
+            list_append(analyzer->errors, list_get(results[i].errors, j));
+        }
+    }
+    for (int i = 0; i < jobs; i++) {
+        SemanticAnalyzer *worker = job[i].analyzer;
+        arena_adopt(syntax->top_level.arena, worker->table->arena);
+        symbol_table_free(worker->table);
+        list_free(worker->errors); // The messages now belong to analyzer
+        free(worker);
+    }
+    free(job);
+    free(results);
+}
+
+List *get_semantic_errors(SemanticAnalyzer *analyzer) {
+    return analyzer->errors;
 }
\ No newline at end of file
@@ -1,40 +1,59 @@
-#include "syntax.h"
-#include "list.h"
-
-#ifndef SEMANTIC_HEADER
-#define SEMANTIC_HEADER
-
-typedef enum {
-    TYPE_INT,    // For integers (e.g., NUMBER)
-    TYPE_BOOL,   // For boolean results (e.g., comparisons)
-    TYPE_VOID,   // For functions with no return value
-    TYPE_ARRAY   // For arrays
-} DataType;
-
-typedef struct Symbol {
-    char *name;
-    DataType type;
-    int scope;  // Scope level (0 for global, increments for nested blocks)
-    int is_function; // 1 if function, 0 if variable
-    List *parameters; // For functions, stores parameter names (if any)
-    int array_size;  // Size of array (for TYPE_ARRAY, otherwise 0)
-} Symbol;
-
-typedef struct SymbolTable {
-    List *symbols; // List of Symbol structs
-    int current_scope;
-} SymbolTable;
-
-typedef struct SemanticAnalyzer {
-    SymbolTable *table;
-    List *errors; // List of error messages
-    int in_function; // Track if inside a function for return statements
-    char *current_function; // Name of current function being analyzed
-} SemanticAnalyzer;
-
-SemanticAnalyzer *semantic_analyzer_new();
-void semantic_analyzer_free(SemanticAnalyzer *analyzer);
-void analyze_semantics(SemanticAnalyzer *analyzer, Syntax *syntax);
-List *get_semantic_errors(SemanticAnalyzer *analyzer);
-
+#include "syntax.h"
+#include "list.h"
+#include "vector.h"
+
+#ifndef SEMANTIC_HEADER
+#define SEMANTIC_HEADER
+
+typedef struct Symbol {
+    Name name;
+    DataType type;
+    int scope;  // Scope level (0 for global, increments for nested blocks)
+    int is_function; // 1 if function, 0 if variable
+    List *parameters; // For functions, stores parameter Names (if any)
+    int array_size;  // Size of array (for TYPE_ARRAY, otherwise 0)
+    struct Symbol *shadowed; // The symbol of the same name this one hides
+    int value; // Where lowering has reached: of a scalar, the IR register holding it; of an array, its IR array number
+    long low, high; // Of an integer variable, its possible values where range analysis has reached
+    Syntax *definition; // Of a function, its FUNCTION node, valid as long as the tree
+    int pure; // Of a function: cleared if it may print, write an array it was passed, or call a function that may
+    List *callees; // Of a function, the Symbols of the functions it calls, or NULL
+    List *callers; // Of a function, filled in by classify_functions(), or NULL
+} Symbol;
+
+/* The symbols in scope, found by hashing the name to the innermost
+ * symbol of that name. Each scope records where its declarations begin
+ * in a log, so leaving it removes just the symbols it declared.
+ */
+typedef struct SymbolTable {
+    Name *names; // Open-addressed; a name stays once added
+    Symbol **innermost; // For each name, its innermost symbol, or NULL
+    size_t table_size; // A power of two
+    size_t name_count;
+    Vector declared; // Of Symbol *, in order of declaration
+    Vector scopes; // Of size_t: the length of declared as each scope began
+    int current_scope;
+    Arena *arena; // Of the tree being analyzed, which holds its variables' symbols
+    struct SymbolTable *parent; // If set, read-only, and searched for names not found here
+} SymbolTable;
+
+typedef struct SemanticAnalyzer {
+    SymbolTable *table;
+    List *errors; // List of error messages
+    int in_function; // Track if inside a function for return statements
+    Name current_function; // Name of current function being analyzed
+    Symbol *function_symbol; // Of the function being analyzed, unless its name was taken
+} SemanticAnalyzer;
+
+Symbol *symbol_table_lookup(SymbolTable *table, Name name, int scope);
+
+SemanticAnalyzer *semantic_analyzer_new();
+void semantic_analyzer_free(SemanticAnalyzer *analyzer);
+void analyze_semantics(SemanticAnalyzer *analyzer, Syntax *syntax);
+void analyze_semantics_parallel(SemanticAnalyzer *analyzer, Syntax *syntax, int jobs);
+void analyze_signatures(SemanticAnalyzer *analyzer, Syntax *top_level);
+void analyze_declarations(SemanticAnalyzer *analyzer, Syntax *top_level);
+void classify_functions(SemanticAnalyzer *analyzer, Syntax *top_level);
+List *get_semantic_errors(SemanticAnalyzer *analyzer);
+
 #endif
\ No newline at end of file
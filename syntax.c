@@ -2,503 +2,313 @@
 #include <stdio.h>
 #include <err.h>
 #include "syntax.h"
+#include "walk.h"
 #include "list.h"
 
-Syntax *immediate_new(int value)
+/* Every node is allocated from the arena of the compilation that parses
+ * it, with its payload stored inline, so building a node is one bump of
+ * a pointer and the whole tree is released with the arena.
+ */
+static Syntax *syntax_new(Arena *arena, SyntaxType type)
 {
-    Immediate *immediate = malloc(sizeof(Immediate));
-    immediate->value = value;
-
-    Syntax *syntax = malloc(sizeof(Syntax));
-    syntax->type = IMMEDIATE;
-    syntax->immediate = immediate;
+    Syntax *syntax = arena_alloc(arena, sizeof(Syntax));
+    syntax->type = type;
+    syntax->data_type = TYPE_VOID;
 
     return syntax;
 }
 
-Syntax *variable_new(char *var_name)
+Syntax *immediate_new(Arena *arena, int value)
 {
-    Variable *variable = malloc(sizeof(Variable));
-    variable->var_name = var_name;
-
-    Syntax *syntax = malloc(sizeof(Syntax));
-    syntax->type = VARIABLE;
-    syntax->variable = variable;
+    Syntax *syntax = syntax_new(arena, IMMEDIATE);
+    syntax->immediate.value = value;
 
     return syntax;
 }
 
-Syntax *negation_new(Syntax *expression)
+Syntax *variable_new(Arena *arena, Name var_name)
 {
-    UnaryExpression *unary_syntax = malloc(sizeof(UnaryExpression));
-    unary_syntax->unary_type = NEGATION;
-    unary_syntax->expression = expression;
-
-    Syntax *syntax = malloc(sizeof(Syntax));
-    syntax->type = UNARY_OPERATOR;
-    syntax->unary_expression = unary_syntax;
+    Syntax *syntax = syntax_new(arena, VARIABLE);
+    syntax->variable.var_name = var_name;
+    syntax->variable.symbol = NULL;
 
     return syntax;
 }
 
-Syntax *bitwise_negation_new(Syntax *expression)
+static Syntax *unary_new(Arena *arena, UnaryExpressionType unary_type, Syntax *expression)
 {
-    UnaryExpression *unary_syntax = malloc(sizeof(UnaryExpression));
-    unary_syntax->unary_type = BITWISE_NEGATION;
-    unary_syntax->expression = expression;
-
-    Syntax *syntax = malloc(sizeof(Syntax));
-    syntax->type = UNARY_OPERATOR;
-    syntax->unary_expression = unary_syntax;
+    Syntax *syntax = syntax_new(arena, UNARY_OPERATOR);
+    syntax->unary_expression.unary_type = unary_type;
+    syntax->unary_expression.expression = expression;
 
     return syntax;
 }
 
-Syntax *logical_negation_new(Syntax *expression)
+Syntax *negation_new(Arena *arena, Syntax *expression)
 {
-    UnaryExpression *unary_syntax = malloc(sizeof(UnaryExpression));
-    unary_syntax->unary_type = LOGICAL_NEGATION;
-    unary_syntax->expression = expression;
-
-    Syntax *syntax = malloc(sizeof(Syntax));
-    syntax->type = UNARY_OPERATOR;
-    syntax->unary_expression = unary_syntax;
-
-    return syntax;
+    return unary_new(arena, NEGATION, expression);
 }
 
-Syntax *addition_new(Syntax *left, Syntax *right)
+Syntax *bitwise_negation_new(Arena *arena, Syntax *expression)
 {
-    BinaryExpression *binary_syntax = malloc(sizeof(BinaryExpression));
-    binary_syntax->binary_type = ADDITION;
-    binary_syntax->left = left;
-    binary_syntax->right = right;
-
-    Syntax *syntax = malloc(sizeof(Syntax));
-    syntax->type = BINARY_OPERATOR;
-    syntax->binary_expression = binary_syntax;
-
-    return syntax;
+    return unary_new(arena, BITWISE_NEGATION, expression);
 }
 
-Syntax *subtraction_new(Syntax *left, Syntax *right)
+Syntax *logical_negation_new(Arena *arena, Syntax *expression)
 {
-    BinaryExpression *binary_syntax = malloc(sizeof(BinaryExpression));
-    binary_syntax->binary_type = SUBTRACTION;
-    binary_syntax->left = left;
-    binary_syntax->right = right;
-
-    Syntax *syntax = malloc(sizeof(Syntax));
-    syntax->type = BINARY_OPERATOR;
-    syntax->binary_expression = binary_syntax;
-
-    return syntax;
+    return unary_new(arena, LOGICAL_NEGATION, expression);
 }
 
-Syntax *multiplication_new(Syntax *left, Syntax *right)
+static Syntax *binary_new(Arena *arena, BinaryExpressionType binary_type, Syntax *left, Syntax *right)
 {
-    BinaryExpression *binary_syntax = malloc(sizeof(BinaryExpression));
-    binary_syntax->binary_type = MULTIPLICATION;
-    binary_syntax->left = left;
-    binary_syntax->right = right;
-
-    Syntax *syntax = malloc(sizeof(Syntax));
-    syntax->type = BINARY_OPERATOR;
-    syntax->binary_expression = binary_syntax;
+    Syntax *syntax = syntax_new(arena, BINARY_OPERATOR);
+    syntax->binary_expression.binary_type = binary_type;
+    syntax->binary_expression.left = left;
+    syntax->binary_expression.right = right;
 
     return syntax;
 }
 
-Syntax *greater_new(Syntax *left, Syntax *right)
+Syntax *addition_new(Arena *arena, Syntax *left, Syntax *right)
 {
-    BinaryExpression *binary_syntax = malloc(sizeof(BinaryExpression));
-    binary_syntax->binary_type = GREATER;
-    binary_syntax->left = left;
-    binary_syntax->right = right;
-
-    Syntax *syntax = malloc(sizeof(Syntax));
-    syntax->type = BINARY_OPERATOR;
-    syntax->binary_expression = binary_syntax;
-
-    return syntax;
+    return binary_new(arena, ADDITION, left, right);
 }
 
-Syntax *less_new(Syntax *left, Syntax *right)
+Syntax *subtraction_new(Arena *arena, Syntax *left, Syntax *right)
 {
-    BinaryExpression *binary_syntax = malloc(sizeof(BinaryExpression));
-    binary_syntax->binary_type = LESS;
-    binary_syntax->left = left;
-    binary_syntax->right = right;
-
-    Syntax *syntax = malloc(sizeof(Syntax));
-    syntax->type = BINARY_OPERATOR;
-    syntax->binary_expression = binary_syntax;
-
-    return syntax;
+    return binary_new(arena, SUBTRACTION, left, right);
 }
 
-Syntax *and_new(Syntax *left, Syntax *right)
+Syntax *multiplication_new(Arena *arena, Syntax *left, Syntax *right)
 {
-    BinaryExpression *binary_syntax = malloc(sizeof(BinaryExpression));
-    binary_syntax->binary_type = AND;
-    binary_syntax->left = left;
-    binary_syntax->right = right;
-
-    Syntax *syntax = malloc(sizeof(Syntax));
-    syntax->type = BINARY_OPERATOR;
-    syntax->binary_expression = binary_syntax;
-
-    return syntax;
+    return binary_new(arena, MULTIPLICATION, left, right);
 }
 
-Syntax *or_new(Syntax *left, Syntax *right)
+Syntax *greater_new(Arena *arena, Syntax *left, Syntax *right)
 {
-    BinaryExpression *binary_syntax = malloc(sizeof(BinaryExpression));
-    binary_syntax->binary_type = OR;
-    binary_syntax->left = left;
-    binary_syntax->right = right;
-
-    Syntax *syntax = malloc(sizeof(Syntax));
-    syntax->type = BINARY_OPERATOR;
-    syntax->binary_expression = binary_syntax;
-
-    return syntax;
+    return binary_new(arena, GREATER, left, right);
 }
 
-Syntax *equals_new(Syntax *left, Syntax *right)
+Syntax *less_new(Arena *arena, Syntax *left, Syntax *right)
 {
-    BinaryExpression *binary_syntax = malloc(sizeof(BinaryExpression));
-    binary_syntax->binary_type = EQUALS;
-    binary_syntax->left = left;
-    binary_syntax->right = right;
-
-    Syntax *syntax = malloc(sizeof(Syntax));
-    syntax->type = BINARY_OPERATOR;
-    syntax->binary_expression = binary_syntax;
+    return binary_new(arena, LESS, left, right);
+}
 
-    return syntax;
+Syntax *and_new(Arena *arena, Syntax *left, Syntax *right)
+{
+    return binary_new(arena, AND, left, right);
 }
 
-Syntax *greater_equals_new(Syntax *left, Syntax *right)
+Syntax *or_new(Arena *arena, Syntax *left, Syntax *right)
 {
-    BinaryExpression *binary_syntax = malloc(sizeof(BinaryExpression));
-    binary_syntax->binary_type = GREATER_EQUALS;
-    binary_syntax->left = left;
-    binary_syntax->right = right;
+    return binary_new(arena, OR, left, right);
+}
 
-    Syntax *syntax = malloc(sizeof(Syntax));
-    syntax->type = BINARY_OPERATOR;
-    syntax->binary_expression = binary_syntax;
+Syntax *equals_new(Arena *arena, Syntax *left, Syntax *right)
+{
+    return binary_new(arena, EQUALS, left, right);
+}
 
-    return syntax;
+Syntax *greater_equals_new(Arena *arena, Syntax *left, Syntax *right)
+{
+    return binary_new(arena, GREATER_EQUALS, left, right);
 }
 
-Syntax *less_equals_new(Syntax *left, Syntax *right)
+Syntax *less_equals_new(Arena *arena, Syntax *left, Syntax *right)
 {
-    BinaryExpression *binary_syntax = malloc(sizeof(BinaryExpression));
-    binary_syntax->binary_type = LESS_EQUALS;
-    binary_syntax->left = left;
-    binary_syntax->right = right;
+    return binary_new(arena, LESS_EQUALS, left, right);
+}
 
-    Syntax *syntax = malloc(sizeof(Syntax));
-    syntax->type = BINARY_OPERATOR;
-    syntax->binary_expression = binary_syntax;
+Syntax *if_new(Arena *arena, Syntax *condition, Syntax *then_stmts, Syntax *else_stmts)
+{
+    Syntax *syntax = syntax_new(arena, IF_STATEMENT);
+    syntax->if_statement.condition = condition;
+    syntax->if_statement.then_stmts = then_stmts;
+    syntax->if_statement.else_stmts = else_stmts;
 
     return syntax;
 }
 
-Syntax *if_new(Syntax *condition, Syntax *then_stmts, Syntax *else_stmts)
+Syntax *function_call_new(Arena *arena, Name function_name, Syntax *func_args)
 {
-    IfStatement *if_statement = malloc(sizeof(IfStatement));
-    if_statement->condition = condition;
-    if_statement->then_stmts = then_stmts;
-    if_statement->else_stmts = else_stmts ? else_stmts : NULL;
-
-    Syntax *syntax = malloc(sizeof(Syntax));
-    syntax->type = IF_STATEMENT;
-    syntax->if_statement = if_statement;
+    Syntax *syntax = syntax_new(arena, FUNCTION_CALL);
+    syntax->function_call.function_name = function_name;
+    syntax->function_call.function_arguments = func_args;
 
     return syntax;
 }
 
-Syntax *function_call_new(char *function_name, Syntax *func_args)
+Syntax *function_arguments_new(Arena *arena)
 {
-    FunctionCall *function_call = malloc(sizeof(FunctionCall));
-    function_call->function_name = function_name;
-    function_call->function_arguments = func_args;
-
-    Syntax *syntax = malloc(sizeof(Syntax));
-    syntax->type = FUNCTION_CALL;
-    syntax->function_call = function_call;
+    Syntax *syntax = syntax_new(arena, FUNCTION_ARGUMENTS);
+    syntax->function_arguments.arguments = list_new_in(arena);
 
     return syntax;
 }
 
-Syntax *function_arguments_new()
+Syntax *assignment_new(Arena *arena, Name var_name, Syntax *expression)
 {
-    FunctionArguments *func_args = malloc(sizeof(FunctionArguments));
-    func_args->arguments = list_new();
-
-    Syntax *syntax = malloc(sizeof(Syntax));
-    syntax->type = FUNCTION_ARGUMENTS;
-    syntax->function_arguments = func_args;
+    Syntax *syntax = syntax_new(arena, ASSIGNMENT);
+    syntax->assignment.var_name = var_name;
+    syntax->assignment.expression = expression;
+    syntax->assignment.symbol = NULL;
 
     return syntax;
 }
 
-Syntax *assignment_new(char *var_name, Syntax *expression)
+Syntax *return_statement_new(Arena *arena, Syntax *expression)
 {
-    Assignment *assignment = malloc(sizeof(Assignment));
-    assignment->var_name = var_name;
-    assignment->expression = expression;
-
-    Syntax *syntax = malloc(sizeof(Syntax));
-    syntax->type = ASSIGNMENT;
-    syntax->assignment = assignment;
+    Syntax *syntax = syntax_new(arena, RETURN_STATEMENT);
+    syntax->return_statement.expression = expression;
 
     return syntax;
 }
 
-Syntax *return_statement_new(Syntax *expression)
+Syntax *print_statement_new(Arena *arena, Syntax *expression)
 {
-    ReturnStatement *return_statement = malloc(sizeof(ReturnStatement));
-    return_statement->expression = expression;
-
-    Syntax *syntax = malloc(sizeof(Syntax));
-    syntax->type = RETURN_STATEMENT;
-    syntax->return_statement = return_statement;
+    Syntax *syntax = syntax_new(arena, PRINT_STATEMENT);
+    syntax->print_statement.expression = expression;
 
     return syntax;
 }
 
-Syntax *print_statement_new(Syntax *expression)
+Syntax *define_var_new(Arena *arena, Name var_name, Syntax *init_value)
 {
-    PrintStatement *print_statement = malloc(sizeof(PrintStatement));
-    print_statement->expression = expression;
-
-    Syntax *syntax = malloc(sizeof(Syntax));
-    syntax->type = PRINT_STATEMENT;
-    syntax->print_statement = print_statement;
+    Syntax *syntax = syntax_new(arena, DEFINE_VAR);
+    syntax->define_var_statement.var_name = var_name;
+    syntax->define_var_statement.init_value = init_value;
+    syntax->define_var_statement.symbol = NULL;
 
     return syntax;
 }
 
-Syntax *define_var_new(char *var_name, Syntax *init_value) {
-    DefineVarStatement *define_var_statement = malloc(sizeof(DefineVarStatement));
-    define_var_statement->var_name = strdup(var_name);
-    define_var_statement->init_value = init_value;
-    Syntax *syntax = malloc(sizeof(Syntax));
-    syntax->type = DEFINE_VAR;
-    syntax->define_var_statement = define_var_statement;
-    return syntax;
-}
-Syntax *block_new(List *statements)
+Syntax *block_new(Arena *arena)
 {
-    Block *block = malloc(sizeof(Block));
-    block->statements = statements;
-
-    Syntax *syntax = malloc(sizeof(Syntax));
-    syntax->type = BLOCK;
-    syntax->block = block;
+    Syntax *syntax = syntax_new(arena, BLOCK);
+    syntax->block.statements = list_new_in(arena);
 
     return syntax;
 }
 
-Syntax *function_new(char *name, Syntax *parameters, Syntax *root_block)
+Syntax *function_new(Arena *arena, Name name, Syntax *parameters, Syntax *root_block)
 {
-    Function *function = malloc(sizeof(Function));
-    function->name = name;
-    function->parameters = parameters;
-    function->root_block = root_block;
-
-    Syntax *syntax = malloc(sizeof(Syntax));
-    syntax->type = FUNCTION;
-    syntax->function = function;
+    Syntax *syntax = syntax_new(arena, FUNCTION);
+    syntax->function.name = name;
+    syntax->function.parameters = parameters;
+    syntax->function.root_block = root_block;
 
     return syntax;
 }
 
-Syntax *top_level_new()
+Syntax *top_level_new(Arena *arena)
 {
-    TopLevel *top_level = malloc(sizeof(TopLevel));
-    top_level->declarations = list_new();
-
-    Syntax *syntax = malloc(sizeof(Syntax));
-    syntax->type = TOP_LEVEL;
-    syntax->top_level = top_level;
+    Syntax *syntax = syntax_new(arena, TOP_LEVEL);
+    syntax->top_level.declarations = list_new_in(arena);
+    syntax->top_level.arena = arena;
 
     return syntax;
 }
 
-Syntax *array_type_new(int size)
+Syntax *array_type_new(Arena *arena, int size)
 {
-    Immediate *immediate = malloc(sizeof(Immediate));
-    immediate->value = size;
-
-    Syntax *syntax = malloc(sizeof(Syntax));
-    syntax->type = ARRAY_TYPE;
-    syntax->immediate = immediate;
+    Syntax *syntax = syntax_new(arena, ARRAY_TYPE);
+    syntax->immediate.value = size;
 
     return syntax;
 }
 
-Syntax *array_expression_new(char *array_name, Syntax *index) {
-    ArrayAccess *array_access = malloc(sizeof(ArrayAccess));
-    array_access->array_name = strdup(array_name);
-    array_access->index = index;
-    Syntax *syntax = malloc(sizeof(Syntax));
-    syntax->type = ARRAY_TYPE; // Fix type below
-    syntax->array_access = array_access;
-    return syntax;
-}
+Syntax *array_expression_new(Arena *arena, Name array_name, Syntax *index)
+{
+    Syntax *syntax = syntax_new(arena, ARRAY_ACCESS);
+    syntax->array_access.array_name = array_name;
+    syntax->array_access.index = index;
+    syntax->array_access.symbol = NULL;
 
-Syntax *array_assignment_new(char *array_name, Syntax *index, Syntax *value) {
-    ArrayAssignment *array_assignment = malloc(sizeof(ArrayAssignment));
-    array_assignment->array_name = strdup(array_name);
-    array_assignment->index = index;
-    array_assignment->value = value;
-    Syntax *syntax = malloc(sizeof(Syntax));
-    syntax->type = ARRAY_ASSIGNMENT;
-    syntax->array_assignment = array_assignment;
     return syntax;
 }
 
-void syntax_list_free(List *syntaxes)
+Syntax *array_assignment_new(Arena *arena, Name array_name, Syntax *index, Syntax *value)
 {
-    if (syntaxes == NULL) return;
-    for (int i = 0; i < list_length(syntaxes); i++) {
-        syntax_free(list_get(syntaxes, i));
-    }
-    list_free(syntaxes);
+    Syntax *syntax = syntax_new(arena, ARRAY_ASSIGNMENT);
+    syntax->array_assignment.array_name = array_name;
+    syntax->array_assignment.index = index;
+    syntax->array_assignment.value = value;
+
+    return syntax;
 }
 
-void syntax_free(Syntax *syntax)
+/* The number of child slots of a node: fixed for most kinds, the list
+ * length for blocks, argument lists and the top level. Slots are in the
+ * order documented in flat.h, and optional ones may be NULL.
+ */
+int syntax_child_count(Syntax *syntax)
 {
-    if (!syntax) return;
-
     switch (syntax->type) {
-        case IMMEDIATE:
-            free(syntax->immediate);
-            break;
-
-        case VARIABLE:
-            free(syntax->variable->var_name);
-            free(syntax->variable);
-            break;
-
         case UNARY_OPERATOR:
-            syntax_free(syntax->unary_expression->expression);
-            free(syntax->unary_expression);
-            break;
-
-        case BINARY_OPERATOR:
-            syntax_free(syntax->binary_expression->left);
-            syntax_free(syntax->binary_expression->right);
-            free(syntax->binary_expression);
-            break;
-
         case FUNCTION_CALL:
-            syntax_free(syntax->function_call->function_arguments);
-            free(syntax->function_call->function_name);
-            free(syntax->function_call);
-            break;
-
-        case FUNCTION_ARGUMENTS:
-            syntax_list_free(syntax->function_arguments->arguments);
-            free(syntax->function_arguments);
-            break;
-
-        case IF_STATEMENT:
-            syntax_free(syntax->if_statement->condition);
-            syntax_free(syntax->if_statement->then_stmts);
-            if (syntax->if_statement->else_stmts) {
-                syntax_free(syntax->if_statement->else_stmts);
-            }
-            free(syntax->if_statement); // Fixed: syntax_if_statement -> syntax->if_statement
-            break;
-
         case RETURN_STATEMENT:
-            if (syntax->return_statement->expression) {
-                syntax_free(syntax->return_statement->expression);
-            }
-            free(syntax->return_statement);
-            break;
-
         case PRINT_STATEMENT:
-            syntax_free(syntax->print_statement->expression);
-            free(syntax->print_statement);
-            break;
-
         case DEFINE_VAR:
-            free(syntax->define_var_statement->var_name);
-            syntax_free(syntax->define_var_statement->init_value); // Fixed: define_var->expression->init_value -> define_var_statement->init_value
-            free(syntax->define_var_statement);
-            break;
-
-        case BLOCK:
-            syntax_list_free(syntax->block->statements);
-            free(syntax->block);
-            break;
-
-        case FUNCTION:
-            free(syntax->function->name);
-            if (syntax->function->parameters) {
-                syntax_free(syntax->function->parameters);
-            }
-            syntax_free(syntax->function->root_block);
-            free(syntax->function);
-            break;
-
         case ASSIGNMENT:
-            free(syntax->assignment->var_name);
-            syntax_free(syntax->assignment->expression);
-            free(syntax->assignment);
-            break;
-
-        case TOP_LEVEL:
-            syntax_list_free(syntax->top_level->declarations);
-            free(syntax->top_level);
-            break;
-
-        case ARRAY_TYPE:
-            if (syntax->immediate) {
-                free(syntax->immediate);
-            } else if (syntax->array_access) {
-                free(syntax->array_access->array_name);
-                syntax_free(syntax->array_access->index);
-                free(syntax->array_access);
-            }
-            break;
-
+        case ARRAY_ACCESS:
+            return 1;
+        case BINARY_OPERATOR:
+        case FUNCTION:
         case ARRAY_ASSIGNMENT:
-            free(syntax->array_assignment->array_name);
-            syntax_free(syntax->array_assignment->index);
-            syntax_free(syntax->array_assignment->value);
-            free(syntax->array_assignment);
-            break;
-
+            return 2;
+        case IF_STATEMENT:
+            return 3;
+        case FUNCTION_ARGUMENTS:
+            return list_length(syntax->function_arguments.arguments);
+        case BLOCK:
+            return list_length(syntax->block.statements);
+        case TOP_LEVEL:
+            return list_length(syntax->top_level.declarations);
         default:
-            warnx("Could not free syntax tree with type: %s", syntax_type_name(syntax));
-            break;
+            return 0;
     }
-
-    free(syntax);
 }
 
-char *syntax_type_name(Syntax *syntax)
+Syntax *syntax_child(Syntax *syntax, int index)
 {
     switch (syntax->type) {
+        case UNARY_OPERATOR: return syntax->unary_expression.expression;
+        case BINARY_OPERATOR: return index == 0 ? syntax->binary_expression.left : syntax->binary_expression.right;
+        case FUNCTION_CALL: return syntax->function_call.function_arguments;
+        case FUNCTION_ARGUMENTS: return list_get(syntax->function_arguments.arguments, index);
+        case IF_STATEMENT:
+            return index == 0 ? syntax->if_statement.condition
+                : index == 1 ? syntax->if_statement.then_stmts : syntax->if_statement.else_stmts;
+        case RETURN_STATEMENT: return syntax->return_statement.expression;
+        case PRINT_STATEMENT: return syntax->print_statement.expression;
+        case DEFINE_VAR: return syntax->define_var_statement.init_value;
+        case BLOCK: return list_get(syntax->block.statements, index);
+        case FUNCTION: return index == 0 ? syntax->function.parameters : syntax->function.root_block;
+        case ASSIGNMENT: return syntax->assignment.expression;
+        case TOP_LEVEL: return list_get(syntax->top_level.declarations, index);
+        case ARRAY_ACCESS: return syntax->array_access.index;
+        case ARRAY_ASSIGNMENT: return index == 0 ? syntax->array_assignment.index : syntax->array_assignment.value;
+        default: return NULL;
+    }
+}
+
+/* The name of a node kind; operator_type is the node's unary or binary
+ * operator, and is ignored for other kinds.
+ */
+char *syntax_kind_name(SyntaxType type, int operator_type)
+{
+    switch (type) {
         case IMMEDIATE: return "IMMEDIATE";
         case VARIABLE: return "VARIABLE";
         case UNARY_OPERATOR:
-            switch (syntax->unary_expression->unary_type) {
+            switch ((UnaryExpressionType)operator_type) {
                 case NEGATION: return "UNARY NEGATION";
                 case BITWISE_NEGATION: return "UNARY BITWISE_NEGATION";
                 case LOGICAL_NEGATION: return "UNARY LOGICAL_NEGATION";
             }
             break;
         case BINARY_OPERATOR:
-            switch (syntax->binary_expression->binary_type) {
+            switch ((BinaryExpressionType)operator_type) {
                 case ADDITION: return "ADDITION";
                 case SUBTRACTION: return "SUBTRACTION";
                 case MULTIPLICATION: return "MULTIPLICATION";
@@ -521,139 +331,127 @@ char *syntax_type_name(Syntax *syntax)
         case FUNCTION: return "FUNCTION";
         case ASSIGNMENT: return "ASSIGNMENT";
         case TOP_LEVEL: return "TOP LEVEL";
-        case ARRAY_TYPE:
-            return syntax->immediate ? "ARRAY DECLARATION" : "ARRAY ACCESS";
+        case ARRAY_TYPE: return "ARRAY DECLARATION";
+        case ARRAY_ACCESS: return "ARRAY ACCESS";
         case ARRAY_ASSIGNMENT: return "ARRAY ASSIGNMENT";
     }
     return "??? UNKNOWN SYNTAX";
 }
 
-void print_syntax_indented(Syntax *syntax, int indent)
+char *syntax_type_name(Syntax *syntax)
+{
+    int operator_type = 0;
+    if (syntax->type == UNARY_OPERATOR) {
+        operator_type = syntax->unary_expression.unary_type;
+    } else if (syntax->type == BINARY_OPERATOR) {
+        operator_type = syntax->binary_expression.binary_type;
+    }
+    return syntax_kind_name(syntax->type, operator_type);
+}
+
+static void print_indent(int indent)
 {
     for (int i = 0; i < indent; i++) {
         printf(" ");
     }
+}
+
+/* Each frame's value is the indentation of its node. */
+static int print_enter(Walker *walker, WalkFrame *frame, WalkFrame *parent)
+{
+    (void)walker;
+    Syntax *syntax = frame->node;
+    if (parent != NULL) {
+        // A call's arguments line up with the call itself.
+        frame->value = parent->value + (parent->node->type == FUNCTION_CALL ? 0 : 4);
+    }
+    int indent = frame->value;
+    print_indent(indent);
 
     char *syntax_type_string = syntax_type_name(syntax);
 
     switch (syntax->type) {
         case IMMEDIATE:
-            printf("%s %d\n", syntax_type_string, syntax->immediate->value);
+            printf("%s %d\n", syntax_type_string, syntax->immediate.value);
             break;
         case VARIABLE:
-            printf("%s '%s'\n", syntax_type_string, syntax->variable->var_name);
-            break;
-        case UNARY_OPERATOR:
-            printf("%s\n", syntax_type_string);
-            print_syntax_indented(syntax->unary_expression->expression, indent + 4);
+            printf("%s '%s'\n", syntax_type_string, syntax->variable.var_name);
             break;
         case BINARY_OPERATOR:
             printf("%s LEFT\n", syntax_type_string);
-            print_syntax_indented(syntax->binary_expression->left, indent + 4);
-            for (int i = 0; i < indent; i++) {
-                printf(" ");
-            }
-            printf("%s RIGHT\n", syntax_type_string);
-            print_syntax_indented(syntax->binary_expression->right, indent + 4);
             break;
         case FUNCTION_CALL:
-            printf("%s '%s'\n", syntax_type_string, syntax->function_call->function_name);
-            print_syntax_indented(syntax->function_call->function_arguments, indent);
+            printf("%s '%s'\n", syntax_type_string, syntax->function_call.function_name);
             break;
+        case UNARY_OPERATOR:
         case FUNCTION_ARGUMENTS:
+        case RETURN_STATEMENT:
+        case PRINT_STATEMENT:
+        case BLOCK:
+        case TOP_LEVEL:
             printf("%s\n", syntax_type_string);
-            for (int i = 0; i < list_length(syntax->function_arguments->arguments); i++) {
-                print_syntax_indented(list_get(syntax->function_arguments->arguments, i), indent + 4);
-            }
             break;
         case IF_STATEMENT:
             printf("%s CONDITION\n", syntax_type_string);
-            print_syntax_indented(syntax->if_statement->condition, indent + 4);
-            for (int i = 0; i < indent; i++) {
-                printf(" ");
-            }
-            printf("%s THEN\n", syntax_type_string);
-            print_syntax_indented(syntax->if_statement->then_stmts, indent + 4);
-            if (syntax->if_statement->else_stmts) {
-                for (int i = 0; i < indent; i++) {
-                    printf(" ");
-                }
-                printf("%s ELSE\n", syntax_type_string);
-                print_syntax_indented(syntax->if_statement->else_stmts, indent + 4);
-            }
-            break;
-        case RETURN_STATEMENT:
-            printf("%s\n", syntax_type_string);
-            print_syntax_indented(syntax->return_statement->expression, indent + 4);
-            break;
-        case PRINT_STATEMENT:
-            printf("%s\n", syntax_type_string);
-            print_syntax_indented(syntax->print_statement->expression, indent + 4);
             break;
         case DEFINE_VAR:
-            printf("%s '%s'\n", syntax_type_string, syntax->define_var_statement->var_name);
-            for (int i = 0; i < indent; i++) {
-                printf(" ");
-            }
-            printf("'%s' INITIAL VALUE\n", syntax->define_var_statement->var_name);
-            print_syntax_indented(syntax->define_var_statement->init_value, indent + 4);
-            break;
-        case BLOCK:
-            printf("%s\n", syntax_type_string);
-            for (int i = 0; i < list_length(syntax->block->statements); i++) {
-                print_syntax_indented(list_get(syntax->block->statements, i), indent + 4);
-            }
+            printf("%s '%s'\n", syntax_type_string, syntax->define_var_statement.var_name);
+            print_indent(indent);
+            printf("'%s' INITIAL VALUE\n", syntax->define_var_statement.var_name);
             break;
         case FUNCTION:
-            printf("%s '%s'\n", syntax_type_string, syntax->function->name);
-            if (syntax->function->parameters) {
-                for (int i = 0; i < indent; i++) {
-                    printf(" ");
-                }
-                printf("PARAMETERS\n");
-                print_syntax_indented(syntax->function->parameters, indent + 4);
-            }
-            print_syntax_indented(syntax->function->root_block, indent + 4);
+            printf("%s '%s'\n", syntax_type_string, syntax->function.name);
             break;
         case ASSIGNMENT:
-            printf("%s '%s'\n", syntax_type_string, syntax->assignment->var_name);
-            print_syntax_indented(syntax->assignment->expression, indent + 4);
-            break;
-        case TOP_LEVEL:
-            printf("%s\n", syntax_type_string);
-            for (int i = 0; i < list_length(syntax->top_level->declarations); i++) {
-                print_syntax_indented(list_get(syntax->top_level->declarations, i), indent + 4);
-            }
+            printf("%s '%s'\n", syntax_type_string, syntax->assignment.var_name);
             break;
         case ARRAY_TYPE:
-            if (syntax->immediate) {
-                printf("%s SIZE %d\n", syntax_type_string, syntax->immediate->value);
-            } else {
-                printf("%s '%s'\n", syntax_type_string, syntax->array_access->array_name);
-                print_syntax_indented(syntax->array_access->index, indent + 4);
-            }
+            printf("%s SIZE %d\n", syntax_type_string, syntax->immediate.value);
+            break;
+        case ARRAY_ACCESS:
+            printf("%s '%s'\n", syntax_type_string, syntax->array_access.array_name);
             break;
         case ARRAY_ASSIGNMENT:
-            printf("%s '%s'\n", syntax_type_string, syntax->array_assignment->array_name);
-            for (int i = 0; i < indent; i++) {
-                printf(" ");
-            }
-            printf("INDEX\n");
-            print_syntax_indented(syntax->array_assignment->index, indent + 4);
-            for (int i = 0; i < indent; i++) {
-                printf(" ");
-            }
-            printf("VALUE\n");
-            print_syntax_indented(syntax->array_assignment->value, indent + 4);
+            printf("%s '%s'\n", syntax_type_string, syntax->array_assignment.array_name);
             break;
         default:
             printf("??? UNKNOWN SYNTAX TYPE\n");
             break;
     }
+    return 1;
+}
+
+/* Print the labels that separate a node's children. */
+static int print_before_child(Walker *walker, WalkFrame *frame, int index, Syntax *child)
+{
+    (void)walker;
+    Syntax *syntax = frame->node;
+    char *label = NULL;
+
+    if (syntax->type == BINARY_OPERATOR && index == 1) {
+        label = "RIGHT";
+    } else if (syntax->type == IF_STATEMENT && index == 1) {
+        label = "THEN";
+    } else if (syntax->type == IF_STATEMENT && index == 2 && child != NULL) {
+        label = "ELSE";
+    } else if (syntax->type == FUNCTION && index == 0 && child != NULL) {
+        print_indent(frame->value);
+        printf("PARAMETERS\n");
+    } else if (syntax->type == ARRAY_ASSIGNMENT) {
+        print_indent(frame->value);
+        printf(index == 0 ? "INDEX\n" : "VALUE\n");
+    }
+
+    if (label != NULL) {
+        print_indent(frame->value);
+        printf("%s %s\n", syntax_type_name(syntax), label);
+    }
+    return 1;
 }
 
 void print_syntax(Syntax *syntax)
 {
-    print_syntax_indented(syntax, 0);
+    Walker walker = { print_enter, print_before_child, NULL, NULL };
+    walk_syntax(&walker, syntax);
 }
 
@@ -1,4 +1,6 @@
 #include "list.h"
+#include "arena.h"
+#include "intern.h"
 
 #ifndef SYNTAX_HEADER
 #define SYNTAX_HEADER
@@ -20,7 +22,7 @@ typedef enum
     TOP_LEVEL,
     PRINT_STATEMENT,
     ARRAY_TYPE,
-    ARRAY_ACCESS, // New type
+    ARRAY_ACCESS,
     ARRAY_ASSIGNMENT
 } SyntaxType;
 
@@ -45,9 +47,19 @@ typedef enum
     LESS_EQUALS
 } BinaryExpressionType;
 
+/* The type of a value, as inferred by semantic analysis. */
+typedef enum {
+    TYPE_INT,    // For integers (e.g., NUMBER)
+    TYPE_BOOL,   // For boolean results (e.g., comparisons)
+    TYPE_VOID,   // For functions with no return value
+    TYPE_ARRAY   // For arrays
+} DataType;
+
 struct Syntax;
 typedef struct Syntax Syntax;
 
+struct Symbol; // Defined by semantic analysis
+
 typedef struct Immediate
 {
     int value;
@@ -55,7 +67,8 @@ typedef struct Immediate
 
 typedef struct Variable
 {
-    char *var_name;
+    Name var_name;
+    struct Symbol *symbol; // Set by semantic analysis
 } Variable;
 
 typedef struct UnaryExpression
@@ -78,20 +91,22 @@ typedef struct FunctionArguments
 
 typedef struct FunctionCall
 {
-    char *function_name;
+    Name function_name;
     Syntax *function_arguments;
 } FunctionCall;
 
 typedef struct Assignment
 {
-    char *var_name;
+    Name var_name;
     Syntax *expression;
+    struct Symbol *symbol; // Set by semantic analysis
 } Assignment;
 
 typedef struct DefineVarStatement
 {
-    char *var_name;
+    Name var_name;
     Syntax *init_value;
+    struct Symbol *symbol; // Set by semantic analysis
 } DefineVarStatement;
 
 typedef struct PrintStatement
@@ -101,13 +116,14 @@ typedef struct PrintStatement
 
 typedef struct ArrayAccess // Renamed from ArrayExpression
 {
-    char *array_name;
+    Name array_name;
     Syntax *index;
+    struct Symbol *symbol; // Set by semantic analysis
 } ArrayAccess;
 
 typedef struct ArrayAssignment // Added
 {
-    char *array_name;
+    Name array_name;
     Syntax *index;
     Syntax *value;
 } ArrayAssignment;
@@ -130,7 +146,7 @@ typedef struct Block
 
 typedef struct Function
 {
-    char *name;
+    Name name;
     Syntax *parameters; // Changed to Syntax*
     Syntax *root_block;
 } Function;
@@ -138,62 +154,66 @@ typedef struct Function
 typedef struct TopLevel
 {
     List *declarations;
+    Arena *arena; // Holds every node of the tree; freeing it frees the tree
 } TopLevel;
 
 struct Syntax
 {
     SyntaxType type;
+    DataType data_type; // Of an expression, once analyzed
     union
     {
-        Immediate *immediate;
-        Variable *variable;
-        UnaryExpression *unary_expression;
-        BinaryExpression *binary_expression;
-        Assignment *assignment;
-        IfStatement *if_statement;
-        ReturnStatement *return_statement;
-        DefineVarStatement *define_var_statement;
-        FunctionArguments *function_arguments;
-        FunctionCall *function_call;
-        Block *block;
-        Function *function;
-        TopLevel *top_level;
-        PrintStatement *print_statement;
-        ArrayAccess *array_access; // Updated
-        ArrayAssignment *array_assignment; // Added
+        Immediate immediate;
+        Variable variable;
+        UnaryExpression unary_expression;
+        BinaryExpression binary_expression;
+        Assignment assignment;
+        IfStatement if_statement;
+        ReturnStatement return_statement;
+        DefineVarStatement define_var_statement;
+        FunctionArguments function_arguments;
+        FunctionCall function_call;
+        Block block;
+        Function function;
+        TopLevel top_level;
+        PrintStatement print_statement;
+        ArrayAccess array_access; // Updated
+        ArrayAssignment array_assignment; // Added
     };
 };
 
-Syntax *immediate_new(int value);
-Syntax *variable_new(char *var_name);
-Syntax *negation_new(Syntax *expression);
-Syntax *bitwise_negation_new(Syntax *expression);
-Syntax *logical_negation_new(Syntax *expression);
-Syntax *addition_new(Syntax *left, Syntax *right);
-Syntax *subtraction_new(Syntax *left, Syntax *right);
-Syntax *multiplication_new(Syntax *left, Syntax *right);
-Syntax *greater_new(Syntax *left, Syntax *right);
-Syntax *less_new(Syntax *left, Syntax *right);
-Syntax *and_new(Syntax *left, Syntax *right);
-Syntax *or_new(Syntax *left, Syntax *right);
-Syntax *equals_new(Syntax *left, Syntax *right);
-Syntax *greater_equals_new(Syntax *left, Syntax *right);
-Syntax *less_equals_new(Syntax *left, Syntax *right);
-Syntax *function_call_new(char *function_name, Syntax *func_args);
-Syntax *function_arguments_new();
-Syntax *assignment_new(char *var_name, Syntax *expression);
-Syntax *if_new(Syntax *condition, Syntax *then_stmts, Syntax *else_stmts);
-Syntax *return_statement_new(Syntax *expression);
-Syntax *print_statement_new(Syntax *expression);
-Syntax *block_new(List *statements);
-Syntax *define_var_new(char *var_name, Syntax *init_value);
-Syntax *function_new(char *name, Syntax *parameters, Syntax *root_block);
-Syntax *top_level_new();
-Syntax *array_type_new(int size);
-Syntax *array_expression_new(char *array_name, Syntax *index);
-Syntax *array_assignment_new(char *array_name, Syntax *index, Syntax *value); // Added
-
-void syntax_free(Syntax *syntax);
+Syntax *immediate_new(Arena *arena, int value);
+Syntax *variable_new(Arena *arena, Name var_name);
+Syntax *negation_new(Arena *arena, Syntax *expression);
+Syntax *bitwise_negation_new(Arena *arena, Syntax *expression);
+Syntax *logical_negation_new(Arena *arena, Syntax *expression);
+Syntax *addition_new(Arena *arena, Syntax *left, Syntax *right);
+Syntax *subtraction_new(Arena *arena, Syntax *left, Syntax *right);
+Syntax *multiplication_new(Arena *arena, Syntax *left, Syntax *right);
+Syntax *greater_new(Arena *arena, Syntax *left, Syntax *right);
+Syntax *less_new(Arena *arena, Syntax *left, Syntax *right);
+Syntax *and_new(Arena *arena, Syntax *left, Syntax *right);
+Syntax *or_new(Arena *arena, Syntax *left, Syntax *right);
+Syntax *equals_new(Arena *arena, Syntax *left, Syntax *right);
+Syntax *greater_equals_new(Arena *arena, Syntax *left, Syntax *right);
+Syntax *less_equals_new(Arena *arena, Syntax *left, Syntax *right);
+Syntax *function_call_new(Arena *arena, Name function_name, Syntax *func_args);
+Syntax *function_arguments_new(Arena *arena);
+Syntax *assignment_new(Arena *arena, Name var_name, Syntax *expression);
+Syntax *if_new(Arena *arena, Syntax *condition, Syntax *then_stmts, Syntax *else_stmts);
+Syntax *return_statement_new(Arena *arena, Syntax *expression);
+Syntax *print_statement_new(Arena *arena, Syntax *expression);
+Syntax *block_new(Arena *arena);
+Syntax *define_var_new(Arena *arena, Name var_name, Syntax *init_value);
+Syntax *function_new(Arena *arena, Name name, Syntax *parameters, Syntax *root_block);
+Syntax *top_level_new(Arena *arena);
+Syntax *array_type_new(Arena *arena, int size);
+Syntax *array_expression_new(Arena *arena, Name array_name, Syntax *index);
+Syntax *array_assignment_new(Arena *arena, Name array_name, Syntax *index, Syntax *value); // Added
+
+int syntax_child_count(Syntax *syntax);
+Syntax *syntax_child(Syntax *syntax, int index);
+char *syntax_kind_name(SyntaxType type, int operator_type);
 char *syntax_type_name(Syntax *syntax);
 void print_syntax(Syntax *syntax);
 
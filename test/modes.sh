@@ -0,0 +1,55 @@
+#!/bin/bash
+# Compiles the sample programs serially, with --stream and with --pipeline,
+# and checks that the three agree, on the assembly of the valid samples
+# and on the errors reported for the others. Run through make check.
+#
+# --stream and --pipeline never hold the whole tree, so they do not fold
+# calls to pure functions; fold_call.dd is the sample where that shows,
+# and is checked to fold serially only.
+
+BUILD=build
+DD=$BUILD/dd
+OUT=$BUILD/test
+failures=0
+
+fail() {
+    echo "FAIL: $*"
+    failures=$((failures + 1))
+}
+
+# Compile a sample with the given flags, copying its assembly to $OUT.
+compile() {
+    local sample=$1 name=$2
+    shift 2
+    $DD "$@" $sample.dd > /dev/null || fail "$sample.dd $*: exit status $?"
+    cp $BUILD/$(basename $sample).asm $OUT/$name.asm
+}
+
+mkdir -p $OUT
+for sample in input main recursion fold_call; do
+    compile $sample serial
+    compile $sample stream --stream
+    compile $sample pipeline --pipeline
+    cmp -s $OUT/stream.asm $OUT/pipeline.asm || fail "$sample.dd: --stream and --pipeline differ"
+    if [ $sample = fold_call ]; then
+        grep -q 'bl *_g$' $OUT/serial.asm && fail "$sample.dd: g(2) not folded serially"
+        grep -q 'bl *_g$' $OUT/stream.asm || fail "$sample.dd: g(2) folded by --stream"
+    else
+        cmp -s $OUT/serial.asm $OUT/stream.asm || fail "$sample.dd: serial and --stream differ"
+    fi
+done
+
+# Every mode must report every error, in the same order.
+for sample in input_error input_errors; do
+    $DD $sample.dd > $OUT/serial.txt && fail "$sample.dd: compiled without errors"
+    for mode in --stream --pipeline "-j 2"; do
+        $DD $mode $sample.dd > $OUT/mode.txt
+        cmp -s $OUT/serial.txt $OUT/mode.txt || fail "$sample.dd $mode: errors differ from serial"
+    done
+done
+
+if [ $failures -gt 0 ]; then
+    echo "$failures failed"
+    exit 1
+fi
+echo "All passed"
@@ -0,0 +1,112 @@
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "vector.h"
+
+/* The largest power of two number of items that fit inline. */
+static size_t inline_capacity(size_t item_size) {
+    size_t capacity = 1;
+    while (capacity * 2 * item_size <= VECTOR_INLINE_BYTES) {
+        capacity *= 2;
+    }
+    return capacity;
+}
+
+void vector_init(Vector *vector, size_t item_size, Arena *arena) {
+    assert(item_size > 0 && item_size <= VECTOR_INLINE_BYTES);
+    vector->items = NULL;
+    vector->item_size = item_size;
+    vector->head = 0;
+    vector->size = 0;
+    vector->capacity = inline_capacity(item_size);
+    vector->arena = arena;
+}
+
+static void release_items(Vector *vector) {
+    if (vector->items != NULL && vector->arena == NULL) {
+        free(vector->items);
+    }
+}
+
+void vector_release(Vector *vector) {
+    release_items(vector);
+    vector->items = NULL;
+    vector->head = 0;
+    vector->size = 0;
+    vector->capacity = inline_capacity(vector->item_size);
+}
+
+/* Move the items to storage for capacity items, in order from its start. */
+static void resize(Vector *vector, size_t capacity) {
+    char *items;
+    if (capacity <= inline_capacity(vector->item_size) && vector->items != NULL) {
+        // Copy through a temporary, as the destination is inside the vector.
+        char buffer[VECTOR_INLINE_BYTES];
+        items = buffer;
+        for (size_t i = 0; i < vector->size; i++) {
+            memcpy(items + i * vector->item_size, vector_at(vector, i), vector->item_size);
+        }
+        release_items(vector);
+        memcpy(vector->inline_items, buffer, vector->size * vector->item_size);
+        vector->items = NULL;
+        vector->head = 0;
+        vector->capacity = inline_capacity(vector->item_size);
+        return;
+    }
+
+    if (vector->arena != NULL) {
+        items = arena_alloc(vector->arena, capacity * vector->item_size);
+    } else {
+        items = malloc(capacity * vector->item_size);
+    }
+
+    // The items are in at most two runs: head to the end of the ring,
+    // then the start of the ring.
+    char *old = vector->items != NULL ? vector->items : vector->inline_items;
+    size_t first = vector->capacity - vector->head;
+    if (first > vector->size) first = vector->size;
+    memcpy(items, old + vector->head * vector->item_size, first * vector->item_size);
+    memcpy(items + first * vector->item_size, old, (vector->size - first) * vector->item_size);
+
+    release_items(vector);
+    vector->items = items;
+    vector->head = 0;
+    vector->capacity = capacity;
+}
+
+/* Double the capacity, for vector_push_back() when the vector is full. */
+void vector_grow(Vector *vector) {
+    resize(vector, vector->capacity * 2);
+}
+
+void vector_push_front(Vector *vector, const void *item) {
+    if (vector->size == vector->capacity) {
+        resize(vector, vector->capacity * 2);
+    }
+    vector->head = (vector->head - 1) & (vector->capacity - 1);
+    vector->size++;
+    vector_copy_item(vector, vector_at(vector, 0), item);
+}
+
+/* Remove the first item, copying it to item unless that is NULL. */
+void vector_pop_front(Vector *vector, void *item) {
+    assert(vector->size > 0);
+    if (item != NULL) {
+        vector_copy_item(vector, item, vector_at(vector, 0));
+    }
+    vector->head = (vector->head + 1) & (vector->capacity - 1);
+    vector->size--;
+}
+
+/* Give back spare capacity, down to the smallest power of two that holds
+ * the items, or to the inline storage if they fit there.
+ */
+void vector_shrink(Vector *vector) {
+    size_t capacity = inline_capacity(vector->item_size);
+    while (capacity < vector->size) {
+        capacity *= 2;
+    }
+    if (capacity < vector->capacity) {
+        resize(vector, capacity);
+    }
+}
@@ -0,0 +1,78 @@
+#include <stddef.h>
+#include <string.h>
+#include <assert.h>
+#include "arena.h"
+
+#ifndef VECTOR_HEADER
+#define VECTOR_HEADER
+
+/* Room for a few items inside the vector itself, so that short vectors,
+ * which are most of them, never allocate.
+ */
+#define VECTOR_INLINE_BYTES 64
+
+/* A growable array of fixed-size items, stored as a ring so that items
+ * can be added and removed in amortized O(1) at either end. Capacity
+ * doubles when full and only shrinks when vector_shrink() is called.
+ */
+typedef struct Vector {
+    char *items; // NULL while the items are in inline_items
+    size_t item_size;
+    size_t head; // Position of the first item
+    size_t size;
+    size_t capacity; // Always a power of two
+    Arena *arena; // If set, storage comes from this arena
+    char inline_items[VECTOR_INLINE_BYTES];
+} Vector;
+
+void vector_init(Vector *vector, size_t item_size, Arena *arena);
+void vector_release(Vector *vector);
+void vector_grow(Vector *vector);
+void vector_push_front(Vector *vector, const void *item);
+void vector_pop_front(Vector *vector, void *item);
+void vector_shrink(Vector *vector);
+
+/* The accessors, and the ends of pushing and popping at the back that
+ * need no new storage, are forced inline even in the unoptimized build
+ * the makefile ships, where each call would otherwise cost more than
+ * the access itself.
+ */
+#define VECTOR_INLINE static inline __attribute__((always_inline))
+
+VECTOR_INLINE size_t vector_length(const Vector *vector) {
+    return vector->size;
+}
+
+/* The address of item i, counting from the front. */
+VECTOR_INLINE void *vector_at(Vector *vector, size_t i) {
+    char *items = vector->items != NULL ? vector->items : vector->inline_items;
+    return items + ((vector->head + i) & (vector->capacity - 1)) * vector->item_size;
+}
+
+/* Copy one item; most vectors hold pointers, which need no memcpy call. */
+VECTOR_INLINE void vector_copy_item(const Vector *vector, void *to, const void *from) {
+    if (vector->item_size == sizeof(void *)) {
+        *(void **)to = *(void *const *)from;
+    } else {
+        memcpy(to, from, vector->item_size);
+    }
+}
+
+VECTOR_INLINE void vector_push_back(Vector *vector, const void *item) {
+    if (vector->size == vector->capacity) {
+        vector_grow(vector);
+    }
+    vector->size++;
+    vector_copy_item(vector, vector_at(vector, vector->size - 1), item);
+}
+
+/* Remove the last item, copying it to item unless that is NULL. */
+VECTOR_INLINE void vector_pop_back(Vector *vector, void *item) {
+    assert(vector->size > 0);
+    if (item != NULL) {
+        vector_copy_item(vector, item, vector_at(vector, vector->size - 1));
+    }
+    vector->size--;
+}
+
+#endif
@@ -0,0 +1,65 @@
+#include <stdlib.h>
+#include <string.h>
+#include "walk.h"
+
+// Most walks are of a single statement or expression and fit here.
+#define WALK_INLINE_DEPTH 64
+
+void walk_syntax(Walker *walker, Syntax *root) {
+    if (root == NULL) return;
+
+    WalkFrame inline_frames[WALK_INLINE_DEPTH];
+    WalkFrame *frames = inline_frames;
+    int capacity = WALK_INLINE_DEPTH;
+    int depth = 0;
+
+    Syntax *next = root;
+    while (1) {
+        if (next != NULL) {
+            if (depth == capacity) {
+                capacity *= 2;
+                if (frames == inline_frames) {
+                    frames = malloc(capacity * sizeof(WalkFrame));
+                    memcpy(frames, inline_frames, sizeof(inline_frames));
+                } else {
+                    frames = realloc(frames, capacity * sizeof(WalkFrame));
+                }
+            }
+            WalkFrame *frame = &frames[depth++];
+            frame->node = next;
+            frame->child = 0;
+            frame->value = 0;
+            WalkFrame *parent = depth > 1 ? frame - 1 : NULL;
+            if (walker->enter == NULL || walker->enter(walker, frame, parent)) {
+                frame->child_count = syntax_child_count(next);
+            } else {
+                frame->child_count = 0;
+            }
+            next = NULL;
+        }
+
+        WalkFrame *top = &frames[depth - 1];
+        if (top->child < top->child_count) {
+            Syntax *child = syntax_child(top->node, top->child);
+            if (walker->before_child != NULL && !walker->before_child(walker, top, top->child, child)) {
+                child = NULL;
+            }
+            if (child == NULL) {
+                top->child++;
+            } else {
+                next = child;
+            }
+            continue;
+        }
+
+        if (walker->leave != NULL) {
+            walker->leave(walker, top);
+        }
+        if (--depth == 0) break;
+        frames[depth - 1].child++;
+    }
+
+    if (frames != inline_frames) {
+        free(frames);
+    }
+}
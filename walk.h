@@ -0,0 +1,37 @@
+#include "syntax.h"
+
+#ifndef WALK_HEADER
+#define WALK_HEADER
+
+/* Depth-first traversal of a syntax tree on an explicit stack, so that
+ * the depth of a tree is limited only by memory. Children are visited in
+ * the order of syntax_child(); any callback may be NULL.
+ *
+ *   enter         before a node's children; return 0 to skip them all
+ *   before_child  before each child slot, including empty (NULL) ones;
+ *                 return 0 to skip that child
+ *   leave         after a node's children
+ *
+ * While a child is being visited, its parent's frame has child set to
+ * that child's index. value is free for the callbacks to use.
+ */
+
+typedef struct WalkFrame {
+    Syntax *node;
+    int child;
+    int child_count;
+    long value;
+} WalkFrame;
+
+typedef struct Walker Walker;
+
+struct Walker {
+    int (*enter)(Walker *walker, WalkFrame *frame, WalkFrame *parent);
+    int (*before_child)(Walker *walker, WalkFrame *frame, int index, Syntax *child);
+    void (*leave)(Walker *walker, WalkFrame *frame);
+    void *data;
+};
+
+void walk_syntax(Walker *walker, Syntax *root);
+
+#endif